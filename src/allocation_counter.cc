@@ -0,0 +1,74 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "allocation_counter.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+namespace {
+
+std::atomic<int64_t> g_allocation_count;
+
+void* CountedAllocateNoThrow(size_t size) {
+  g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  return malloc(size ? size : 1);
+}
+
+void* CountedAllocate(size_t size) {
+  void* ptr = CountedAllocateNoThrow(size);
+  CHECK(ptr, "Out of memory allocating %d bytes", static_cast<int>(size));
+  return ptr;
+}
+
+}  // namespace
+
+int64_t GetAllocationCount() {
+  return g_allocation_count.load(std::memory_order_relaxed);
+}
+
+// The whole replaceable set, so that nothing allocated here is freed by the
+// library's versions, or the other way around.
+void* operator new(size_t size) {
+  return CountedAllocate(size);
+}
+
+void* operator new[](size_t size) {
+  return CountedAllocate(size);
+}
+
+// These return NULL on failure, as callers of the nothrow forms check.
+void* operator new(size_t size, const std::nothrow_t&) NO_EXCEPT {
+  return CountedAllocateNoThrow(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) NO_EXCEPT {
+  return CountedAllocateNoThrow(size);
+}
+
+void operator delete(void* ptr) NO_EXCEPT {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) NO_EXCEPT {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*size*/) NO_EXCEPT {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t /*size*/) NO_EXCEPT {
+  free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) NO_EXCEPT {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) NO_EXCEPT {
+  free(ptr);
+}
@@ -0,0 +1,15 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ALLOCATION_COUNTER_H_
+#define ALLOCATION_COUNTER_H_
+
+#include "core.h"
+
+// allocation_counter.cc replaces the global operator new so that benchmarks
+// can report how many allocations an operation makes. Only binaries that link
+// it have this.
+int64_t GetAllocationCount();
+
+#endif  // ALLOCATION_COUNTER_H_
@@ -0,0 +1,27 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "atlas_packer.h"
+
+#include <algorithm>
+
+AtlasPacker::AtlasPacker(int width, int padding)
+    : width_(width), padding_(padding), x_(0), shelf_y_(0), shelf_height_(0) {
+}
+
+bool AtlasPacker::Place(int width, int height, int* x, int* y) {
+  if (width > width_)
+    return false;
+  if (x_ + width > width_) {
+    // Start a new shelf below the current one.
+    shelf_y_ += shelf_height_ + padding_;
+    shelf_height_ = 0;
+    x_ = 0;
+  }
+  *x = x_;
+  *y = shelf_y_;
+  x_ += width + padding_;
+  shelf_height_ = std::max(shelf_height_, height);
+  return true;
+}
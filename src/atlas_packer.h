@@ -0,0 +1,37 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ATLAS_PACKER_H_
+#define ATLAS_PACKER_H_
+
+#include "core.h"
+
+// Packs rectangles left-to-right into rows ("shelves") of a fixed-width
+// atlas. Simple, and tight enough when rectangles are placed in order of
+// decreasing height, as the sets being packed (icons) are small and known up
+// front.
+class AtlasPacker {
+ public:
+  // |padding| is left between rectangles so that filtering at their edges
+  // doesn't sample neighbours.
+  AtlasPacker(int width, int padding);
+
+  // Returns the position of a |width| x |height| rectangle in |*x|, |*y|, or
+  // false if it's wider than the atlas.
+  bool Place(int width, int height, int* x, int* y);
+
+  // The height the atlas needs to be to hold everything placed so far.
+  int height() const { return shelf_y_ + shelf_height_; }
+
+ private:
+  int width_;
+  int padding_;
+  int x_;
+  int shelf_y_;
+  int shelf_height_;
+
+  DISALLOW_COPY_AND_ASSIGN(AtlasPacker);
+};
+
+#endif  // ATLAS_PACKER_H_
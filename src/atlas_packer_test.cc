@@ -0,0 +1,29 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "atlas_packer.h"
+
+#include <gtest/gtest.h>
+
+TEST(AtlasPackerTest, Shelves) {
+  AtlasPacker packer(64, 1);
+  int x, y;
+  EXPECT_EQ(0, packer.height());
+
+  ASSERT_TRUE(packer.Place(32, 20, &x, &y));
+  EXPECT_EQ(0, x);
+  EXPECT_EQ(0, y);
+  ASSERT_TRUE(packer.Place(16, 16, &x, &y));
+  EXPECT_EQ(33, x);
+  EXPECT_EQ(0, y);
+  EXPECT_EQ(20, packer.height());
+
+  // Doesn't fit in what's left of the first shelf.
+  ASSERT_TRUE(packer.Place(16, 10, &x, &y));
+  EXPECT_EQ(0, x);
+  EXPECT_EQ(21, y);
+  EXPECT_EQ(31, packer.height());
+
+  EXPECT_FALSE(packer.Place(65, 1, &x, &y));
+}
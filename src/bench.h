@@ -0,0 +1,36 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "core.h"
+
+// A minimal benchmark runner for sg_bench. A benchmark is a function that
+// performs |iterations| repetitions of the operation being measured; the
+// runner picks the count so that each run takes a useful amount of time, and
+// reports the time per iteration.
+//
+//   BENCHMARK(SomethingFast) {
+//     for (int i = 0; i < iterations; ++i)
+//       DoSomethingFast();
+//   }
+
+typedef void (*BenchmarkFn)(int iterations);
+
+struct BenchmarkRegistration {
+  BenchmarkRegistration(const char* name, BenchmarkFn fn);
+
+  const char* name;
+  BenchmarkFn fn;
+  BenchmarkRegistration* next;
+};
+
+#define BENCHMARK(name)                                             \
+  static void Benchmark_##name(int iterations);                     \
+  static BenchmarkRegistration g_benchmark_registration_##name(     \
+      #name, Benchmark_##name);                                     \
+  static void Benchmark_##name(int iterations)
+
+#endif  // BENCH_H_
@@ -0,0 +1,67 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+// Benchmarks are run with increasing iteration counts until a run takes at
+// least this long.
+const double kMinRunSeconds = 0.2;
+
+// In registration order. These are constant-initialized, so they're ready
+// before any BENCHMARK()'s registration runs.
+BenchmarkRegistration* g_benchmarks;
+BenchmarkRegistration** g_benchmarks_tail = &g_benchmarks;
+
+double Now() {
+  return static_cast<double>(GetHPCounter()) /
+         static_cast<double>(GetHPFrequency());
+}
+
+bool Matches(const char* name, int argc, char** argv) {
+  if (argc < 2)
+    return true;
+  for (int i = 1; i < argc; ++i) {
+    if (strstr(name, argv[i]))
+      return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+BenchmarkRegistration::BenchmarkRegistration(const char* name, BenchmarkFn fn)
+    : name(name), fn(fn), next(NULL) {
+  *g_benchmarks_tail = this;
+  g_benchmarks_tail = &next;
+}
+
+// Usage: sg_bench [filter...]. Runs benchmarks whose name contains any of the
+// filters, or all of them if none are given.
+int main(int argc, char** argv) {
+  for (BenchmarkRegistration* bench = g_benchmarks; bench;
+       bench = bench->next) {
+    if (!Matches(bench->name, argc, argv))
+      continue;
+    int iterations = 1;
+    double elapsed;
+    for (;;) {
+      double start = Now();
+      bench->fn(iterations);
+      elapsed = Now() - start;
+      if (elapsed >= kMinRunSeconds || iterations >= (1 << 30))
+        break;
+      iterations *= elapsed > 0.0 && elapsed * 10 > kMinRunSeconds ? 2 : 10;
+    }
+    printf("%-40s %12d %12.1f ns/iter\n",
+           bench->name,
+           iterations,
+           elapsed * 1e9 / iterations);
+  }
+  return 0;
+}
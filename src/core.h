@@ -78,6 +78,10 @@
 #define CACHE_LINE_SIZE 64
 #endif
 
+#if !defined(CACHE_LINE_SIZE)
+#define CACHE_LINE_SIZE 64
+#endif
+
 #if defined(__x86_64__) || defined(_M_X64) || defined(__64BIT__)
 #undef ARCH_64BIT
 #define ARCH_64BIT 64
@@ -166,6 +170,8 @@ char(&COUNTOF_REQUIRES_ARRAY_ARGUMENT(const T(&)[N]))[N];  // NOLINT
 #define NO_INLINE __attribute__((noinline))
 #define NO_RETURN __attribute__((noreturn))
 #define NO_VTABLE
+#define NO_EXCEPT noexcept
+#define THREAD __thread
 #elif COMPILER_MSVC
 #define ALIGN_STRUCT(_align, struct) __declspec(align(_align)) struct
 #define ALLOW_UNUSED
@@ -174,6 +180,8 @@ char(&COUNTOF_REQUIRES_ARRAY_ARGUMENT(const T(&)[N]))[N];  // NOLINT
 #define NO_INLINE __declspec(noinline)
 #define NO_RETURN
 #define NO_VTABLE __declspec(novtable)
+// VS2013 doesn't have noexcept.
+#define NO_EXCEPT throw()
 #define THREAD __declspec(thread)
 #else
 #error "Unknown COMPILER_"
@@ -342,9 +350,11 @@ inline int64_t GetHPCounter() {
   QueryPerformanceCounter(&li);
   int64_t i64 = li.QuadPart;
 #else
-  struct timeval now;
-  gettimeofday(&now, 0);
-  int64_t i64 = now.tv_sec * INT64_C(1000000) + now.tv_usec;
+  // Monotonic, so that deadlines computed from it aren't affected by the
+  // wall clock being adjusted.
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t i64 = now.tv_sec * INT64_C(1000000) + now.tv_nsec / 1000;
 #endif
   return i64;
 }
@@ -0,0 +1,293 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "display_list.h"
+
+namespace {
+
+THREAD DisplayList* g_current_display_list;
+
+}  // namespace
+
+DisplayList::DisplayList() : push_depth_(0) {
+}
+
+DisplayList::~DisplayList() {
+}
+
+void DisplayList::Reset() {
+  commands_.clear();
+  strings_.clear();
+  ranges_.clear();
+  push_depth_ = 0;
+}
+
+DisplayList::Command* DisplayList::Append(Command::Type type) {
+  commands_.push_back(Command());
+  Command* command = &commands_.back();
+  command->type = type;
+  command->param0 = 0.f;
+  command->param1 = 0.f;
+  command->font = Font::kUI;
+  command->flag = false;
+  command->string_start = 0;
+  command->string_length = 0;
+  command->ranges_start = 0;
+  command->ranges_count = 0;
+  return command;
+}
+
+void DisplayList::AppendString(Command* command, StringPiece str) {
+  command->string_start = static_cast<uint32_t>(strings_.size());
+  command->string_length = static_cast<uint32_t>(str.size());
+  strings_.insert(strings_.end(), str.data(), str.data() + str.size());
+  strings_.push_back(0);
+}
+
+StringPiece DisplayList::StringFor(const Command& command) const {
+  if (command.string_length == 0)
+    return StringPiece("");
+  return StringPiece(&strings_[command.string_start], command.string_length);
+}
+
+void DisplayList::AddSolidRect(const Rect& rect, const Color& color) {
+  Command* command = Append(Command::kSolidRect);
+  command->rect = rect;
+  command->color = color;
+}
+
+void DisplayList::AddSolidRoundedRect(const Rect& rect,
+                                      const Color& color,
+                                      float radius) {
+  Command* command = Append(Command::kSolidRoundedRect);
+  command->rect = rect;
+  command->color = color;
+  command->param0 = radius;
+}
+
+void DisplayList::AddOutlineRoundedRect(const Rect& rect,
+                                        const Color& color,
+                                        float radius,
+                                        float width) {
+  Command* command = Append(Command::kOutlineRoundedRect);
+  command->rect = rect;
+  command->color = color;
+  command->param0 = radius;
+  command->param1 = width;
+}
+
+void DisplayList::AddVerticalLine(const Color& color,
+                                  float x,
+                                  float y0,
+                                  float y1) {
+  Command* command = Append(Command::kVerticalLine);
+  command->color = color;
+  command->rect = Rect(x, 0.f, 0.f, 0.f);
+  command->param0 = y0;
+  command->param1 = y1;
+}
+
+void DisplayList::AddHorizontalLine(const Color& color,
+                                    float x0,
+                                    float x1,
+                                    float y) {
+  Command* command = Append(Command::kHorizontalLine);
+  command->color = color;
+  command->rect = Rect(0.f, y, 0.f, 0.f);
+  command->param0 = x0;
+  command->param1 = x1;
+}
+
+void DisplayList::AddText(Font font,
+                          const Color& color,
+                          float x,
+                          float y,
+                          StringPiece str) {
+  Command* command = Append(Command::kText);
+  command->font = font;
+  command->color = color;
+  command->rect = Rect(x, y, 0.f, 0.f);
+  AppendString(command, str);
+}
+
+void DisplayList::AddTextInRect(Font font,
+                                const Color& color,
+                                const Rect& rect,
+                                StringPiece str) {
+  Command* command = Append(Command::kTextInRect);
+  command->font = font;
+  command->color = color;
+  command->rect = rect;
+  AppendString(command, str);
+}
+
+void DisplayList::AddColoredText(Font font,
+                                 const Color& default_color,
+                                 float x,
+                                 float y,
+                                 StringPiece str,
+                                 const std::vector<RangeAndColor>& colors) {
+  Command* command = Append(Command::kColoredText);
+  command->font = font;
+  command->color = default_color;
+  command->rect = Rect(x, y, 0.f, 0.f);
+  AppendString(command, str);
+  command->ranges_start = static_cast<uint32_t>(ranges_.size());
+  command->ranges_count = static_cast<uint32_t>(colors.size());
+  ranges_.insert(ranges_.end(), colors.begin(), colors.end());
+}
+
+void DisplayList::AddIcon(Icon icon, const Rect& rect, float alpha) {
+  Command* command = Append(Command::kIcon);
+  command->icon = icon;
+  command->rect = rect;
+  command->param0 = alpha;
+}
+
+void DisplayList::AddWindow(StringPiece title, bool active, const Rect& rect) {
+  Command* command = Append(Command::kWindow);
+  command->rect = rect;
+  command->flag = active;
+  AppendString(command, title);
+}
+
+void DisplayList::PushOffset(const Rect& rect, bool scissor) {
+  Command* command = Append(Command::kPushOffset);
+  command->rect = rect;
+  command->flag = scissor;
+  ++push_depth_;
+}
+
+void DisplayList::PopOffset() {
+  DCHECK(push_depth_ > 0, "unbalanced PopOffset");
+  Append(Command::kPopOffset);
+  --push_depth_;
+}
+
+void DisplayList::BeginLayer(GfxLayer* layer, float width, float height) {
+  Command* command = Append(Command::kBeginLayer);
+  command->layer = layer;
+  command->rect = Rect(0.f, 0.f, width, height);
+  ++push_depth_;
+}
+
+void DisplayList::EndLayer() {
+  DCHECK(push_depth_ > 0, "unbalanced EndLayer");
+  Append(Command::kEndLayer);
+  --push_depth_;
+}
+
+void DisplayList::AddLayer(GfxLayer* layer, const Rect& rect, float alpha) {
+  Command* command = Append(Command::kLayer);
+  command->layer = layer;
+  command->rect = rect;
+  command->param0 = alpha;
+}
+
+void DisplayList::Replay() const {
+  DCHECK(!Current(), "replaying while recording");
+  DCHECK(push_depth_ == 0, "replaying with unbalanced offsets");
+  size_t index = 0;
+  while (index < commands_.size())
+    index = ReplayFrom(index);
+}
+
+// Replays from |index| until the matching kPopOffset or kEndLayer (or the end
+// of the list) and returns the index following it. Offsets and layers recurse
+// so that the ScopedRenderOffset or ScopedRenderIntoLayer restoring state
+// lives on the stack, the same as it would have during immediate drawing.
+size_t DisplayList::ReplayFrom(size_t index) const {
+  while (index < commands_.size()) {
+    const Command& command = commands_[index++];
+    switch (command.type) {
+      case Command::kSolidRect:
+        DrawSolidRect(command.rect, command.color);
+        break;
+      case Command::kSolidRoundedRect:
+        DrawSolidRoundedRect(command.rect, command.color, command.param0);
+        break;
+      case Command::kOutlineRoundedRect:
+        DrawOutlineRoundedRect(
+            command.rect, command.color, command.param0, command.param1);
+        break;
+      case Command::kVerticalLine:
+        DrawVerticalLine(
+            command.color, command.rect.x, command.param0, command.param1);
+        break;
+      case Command::kHorizontalLine:
+        DrawHorizontalLine(
+            command.color, command.param0, command.param1, command.rect.y);
+        break;
+      case Command::kText:
+        GfxText(command.font,
+                command.color,
+                command.rect.x,
+                command.rect.y,
+                StringFor(command));
+        break;
+      case Command::kTextInRect:
+        GfxText(command.font,
+                command.color,
+                command.rect,
+                StringFor(command).data());
+        break;
+      case Command::kColoredText: {
+        std::vector<RangeAndColor> colors(
+            ranges_.begin() + command.ranges_start,
+            ranges_.begin() + command.ranges_start + command.ranges_count);
+        GfxColoredText(command.font,
+                       command.color,
+                       command.rect.x,
+                       command.rect.y,
+                       StringFor(command),
+                       colors);
+        break;
+      }
+      case Command::kIcon:
+        GfxDrawIcon(command.icon, command.rect, command.param0);
+        break;
+      case Command::kWindow:
+        DrawWindow(StringFor(command).data(),
+                   command.flag,
+                   command.rect.x,
+                   command.rect.y,
+                   command.rect.w,
+                   command.rect.h);
+        break;
+      case Command::kPushOffset: {
+        ScopedRenderOffset offset(command.rect, command.flag);
+        index = ReplayFrom(index);
+        break;
+      }
+      case Command::kPopOffset:
+        return index;
+      case Command::kBeginLayer: {
+        ScopedRenderIntoLayer into_layer(
+            command.layer, command.rect.w, command.rect.h);
+        index = ReplayFrom(index);
+        break;
+      }
+      case Command::kEndLayer:
+        return index;
+      case Command::kLayer:
+        GfxDrawLayer(command.layer, command.rect, command.param0);
+        break;
+    }
+  }
+  return index;
+}
+
+// static
+DisplayList* DisplayList::Current() {
+  return g_current_display_list;
+}
+
+ScopedDisplayListRecorder::ScopedDisplayListRecorder(DisplayList* list)
+    : previous_(g_current_display_list) {
+  g_current_display_list = list;
+}
+
+ScopedDisplayListRecorder::~ScopedDisplayListRecorder() {
+  g_current_display_list = previous_;
+}
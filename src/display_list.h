@@ -0,0 +1,142 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DISPLAY_LIST_H_
+#define DISPLAY_LIST_H_
+
+#include <vector>
+
+#include "core.h"
+#include "gfx.h"
+
+// A recorded sequence of drawing calls. While a DisplayList is bound to the
+// current thread with ScopedDisplayListRecorder, the drawing helpers in gfx.h
+// append to it rather than talking to the backend, so that recording doesn't
+// need access to the device and can happen on any thread. Replay() must be
+// called on the rendering thread with no list bound.
+class DisplayList {
+ public:
+  DisplayList();
+  ~DisplayList();
+
+  // Drops all recorded commands, but keeps allocations for reuse.
+  void Reset();
+  bool IsEmpty() const { return commands_.empty(); }
+
+  void AddSolidRect(const Rect& rect, const Color& color);
+  void AddSolidRoundedRect(const Rect& rect, const Color& color, float radius);
+  void AddOutlineRoundedRect(const Rect& rect,
+                             const Color& color,
+                             float radius,
+                             float width);
+  void AddVerticalLine(const Color& color, float x, float y0, float y1);
+  void AddHorizontalLine(const Color& color, float x0, float x1, float y);
+  void AddText(Font font,
+               const Color& color,
+               float x,
+               float y,
+               StringPiece str);
+  void AddTextInRect(Font font,
+                     const Color& color,
+                     const Rect& rect,
+                     StringPiece str);
+  void AddColoredText(Font font,
+                      const Color& default_color,
+                      float x,
+                      float y,
+                      StringPiece str,
+                      const std::vector<RangeAndColor>& colors);
+  void AddIcon(Icon icon, const Rect& rect, float alpha);
+  void AddWindow(StringPiece title, bool active, const Rect& rect);
+
+  // Pushes are matched by PopOffset, and are replayed as a ScopedRenderOffset.
+  void PushOffset(const Rect& rect, bool scissor);
+  void PopOffset();
+
+  // Begins are matched by EndLayer, and are replayed as a
+  // ScopedRenderIntoLayer.
+  void BeginLayer(GfxLayer* layer, float width, float height);
+  void EndLayer();
+  void AddLayer(GfxLayer* layer, const Rect& rect, float alpha);
+
+  // Replays all recorded commands through the current backend.
+  void Replay() const;
+
+  // The list that drawing on this thread is currently being recorded into, or
+  // null if drawing is immediate.
+  static DisplayList* Current();
+
+ private:
+  friend class ScopedDisplayListRecorder;
+
+  struct Command {
+    enum Type {
+      kSolidRect,
+      kSolidRoundedRect,
+      kOutlineRoundedRect,
+      kVerticalLine,
+      kHorizontalLine,
+      kText,
+      kTextInRect,
+      kColoredText,
+      kIcon,
+      kWindow,
+      kPushOffset,
+      kPopOffset,
+      kBeginLayer,
+      kEndLayer,
+      kLayer,
+    };
+
+    Type type;
+    Rect rect;
+    Color color;
+    // Meaning depends on |type|: radius/width for rounded rects, endpoints for
+    // lines, alpha for icons and layers.
+    float param0;
+    float param1;
+    union {
+      Font font;
+      Icon icon;
+      GfxLayer* layer;
+    };
+    // |scissor| for offsets, |active| for windows.
+    bool flag;
+    // Range into |strings_| for text commands.
+    uint32_t string_start;
+    uint32_t string_length;
+    // Range into |ranges_| for kColoredText.
+    uint32_t ranges_start;
+    uint32_t ranges_count;
+  };
+
+  Command* Append(Command::Type type);
+  void AppendString(Command* command, StringPiece str);
+  StringPiece StringFor(const Command& command) const;
+  size_t ReplayFrom(size_t index) const;
+
+  std::vector<Command> commands_;
+  // Text is copied as the caller's buffers don't live until replay. Strings
+  // are stored nul-terminated for the const char* entry points.
+  std::vector<char> strings_;
+  std::vector<RangeAndColor> ranges_;
+  int push_depth_;
+
+  DISALLOW_COPY_AND_ASSIGN(DisplayList);
+};
+
+// Binds |list| as the recording target for drawing on this thread for the
+// lifetime of the object.
+class ScopedDisplayListRecorder {
+ public:
+  explicit ScopedDisplayListRecorder(DisplayList* list);
+  ~ScopedDisplayListRecorder();
+
+ private:
+  DisplayList* previous_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedDisplayListRecorder);
+};
+
+#endif  // DISPLAY_LIST_H_
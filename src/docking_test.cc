@@ -7,6 +7,7 @@
 #include "docking_resizer.h"
 #include "docking_split_container.h"
 #include "docking_workspace.h"
+#include "focus.h"
 #include "leak_check_test.h"
 
 namespace {
@@ -15,6 +16,21 @@ class MainDocument : public Widget {};
 
 class ContentPane : public Widget {};
 
+// Takes the mouse, but nothing it does changes how it looks.
+class MousePane : public Widget {
+ public:
+  bool NotifyMouseMoved(int /*x*/, int /*y*/, uint8_t /*modifiers*/) override {
+    return true;
+  }
+  bool NotifyMouseWheel(int /*x*/,
+                        int /*y*/,
+                        float /*delta*/,
+                        uint8_t /*modifiers*/) override {
+    return true;
+  }
+  bool WantMouseEvents() override { return true; }
+};
+
 std::string RectAsString(const Rect& r) {
   char buf[256];
   snprintf(buf, sizeof(buf), "%.0f,%.0f %.0fx%.0f", r.x, r.y, r.w, r.h);
@@ -318,3 +334,19 @@ TEST_F(DockingTest, SiblingRetrieval) {
   EXPECT_EQ(pane2,
             pane1->parent()->AsDockingSplitContainer()->GetSiblingOf(pane1));
 }
+
+TEST_F(DockingTest, MouseOverContentsDoesNotRepaint) {
+  DockingWorkspace workspace;
+  workspace.SetScreenRect(Rect(0, 0, 1000, 1000));
+  MousePane* pane = new MousePane;
+  workspace.SetRoot(pane);
+  SetFocusedContents(pane);
+  pane->parent()->ClearNeedsPaint();
+  pane->ClearNeedsPaint();
+
+  EXPECT_TRUE(workspace.NotifyMouseMoved(100, 100, 0));
+  EXPECT_TRUE(workspace.NotifyMouseWheel(100, 100, 1.f, 0));
+  EXPECT_FALSE(pane->NeedsPaint());
+  EXPECT_FALSE(workspace.NeedsPaint());
+  SetFocusedContents(NULL);
+}
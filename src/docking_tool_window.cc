@@ -6,6 +6,7 @@
 
 #include "draggable.h"
 #include "focus.h"
+#include "gfx.h"
 #include "skin.h"
 #include "tool_window_dragger.h"
 
@@ -18,11 +19,12 @@ const int kTitleOffset = 3;
 }  // namespace
 
 DockingToolWindow::DockingToolWindow(Widget* contents, const std::string& title)
-    : contents_(contents), title_(title) {
+    : contents_(contents), title_(title), layer_(GfxCreateLayer()) {
   contents->set_parent(this);
 }
 
 DockingToolWindow::~DockingToolWindow() {
+  GfxDestroyLayer(layer_);
 }
 
 Rect DockingToolWindow::RectForTitleBar() {
@@ -30,12 +32,23 @@ Rect DockingToolWindow::RectForTitleBar() {
 }
 
 void DockingToolWindow::Render() {
-  bool focused = GetFocusedContents() == contents_;
-  DrawWindow(title_.c_str(), focused, 0, 0, Width(), Height());
+  RenderToRect(GetClientRect(), 1.f);
+}
+
+void DockingToolWindow::RenderToRect(const Rect& rect, float alpha) {
+  if (NeedsPaint() || GfxLayerNeedsRepaint(layer_, Width(), Height())) {
+    // Cleared first so that contents that are animating can invalidate again
+    // during their Render() to get another frame.
+    ClearNeedsPaint();
+    ScopedRenderIntoLayer into_layer(layer_, Width(), Height());
+    bool focused = GetFocusedContents() == contents_;
+    DrawWindow(title_.c_str(), focused, 0, 0, Width(), Height());
 
-  ScopedRenderOffset offset(
-      contents_->GetScreenRect().RelativeTo(GetScreenRect()), true);
-  contents_->Render();
+    ScopedRenderOffset offset(
+        contents_->GetScreenRect().RelativeTo(GetScreenRect()), true);
+    contents_->Render();
+  }
+  GfxDrawLayer(layer_, rect, alpha);
 }
 
 void DockingToolWindow::SetScreenRect(const Rect& rect) {
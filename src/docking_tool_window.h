@@ -10,6 +10,8 @@
 #include "core.h"
 #include "widget.h"
 
+struct GfxLayer;
+
 // Renders window decoration, handles drag/re-dock interaction.
 class DockingToolWindow : public Widget {
  public:
@@ -17,6 +19,11 @@ class DockingToolWindow : public Widget {
   virtual ~DockingToolWindow();
 
   void Render() override;
+  // Composites the window into |rect|, which needn't be the window's size.
+  // The window and its contents are only re-drawn if they've been invalidated
+  // since the last time, and otherwise this is just a copy of the cached
+  // layer.
+  void RenderToRect(const Rect& rect, float alpha);
   void SetScreenRect(const Rect& rect) override;
   bool CouldStartDrag(DragSetup* drag_setup) override;
   Widget* FindTopMostUnderPoint(const Point& point) override;
@@ -26,6 +33,7 @@ class DockingToolWindow : public Widget {
 
   Widget* contents_;
   std::string title_;
+  GfxLayer* layer_;
 };
 
 #endif  // DOCKING_TOOL_WINDOW_H_
@@ -6,13 +6,32 @@
 
 #include <algorithm>
 
+#include "display_list.h"
 #include "docking_split_container.h"
 #include "focus.h"
 #include "gfx.h"
+#include "task_scheduler.h"
 
 // TODO(scottmg):
 // This whole file sucks. Maybe it should just be a Widget/Container too.
 
+namespace {
+
+struct RecordLeavesData {
+  std::vector<Widget*>* leaves;
+  std::vector<std::unique_ptr<DisplayList>>* display_lists;
+};
+
+void RecordLeaf(void* user_data, int index) {
+  RecordLeavesData* data = reinterpret_cast<RecordLeavesData*>(user_data);
+  DisplayList* list = (*data->display_lists)[index].get();
+  list->Reset();
+  ScopedDisplayListRecorder recorder(list);
+  (*data->leaves)[index]->Render();
+}
+
+}  // namespace
+
 DockingWorkspace::DockingWorkspace() {
   root_.reset(new DockingSplitContainer(kSplitNoneRoot, NULL, NULL));
 }
@@ -21,15 +40,43 @@ DockingWorkspace::~DockingWorkspace() {
 }
 
 void DockingWorkspace::Render() {
+  // Cleared before rendering so that widgets that are animating can
+  // invalidate again during it.
+  root_->ClearNeedsPaint();
   if (root_->left()) {
-    const Rect& rect = GetScreenRect();
-    ScopedRenderOffset offset(rect.x, rect.y);
-    root_->left()->Render();
+    // Leaves of the tree never draw outside their own rect, so they can be
+    // recorded independently as tasks. They're then replayed here in tree
+    // order with the same offset and clip that DockingSplitContainer would
+    // have applied (the containers themselves draw nothing).
+    render_leaves_.clear();
+    GetDockTargets(root_->left(), &render_leaves_);
+    while (leaf_display_lists_.size() < render_leaves_.size())
+      leaf_display_lists_.push_back(
+          std::unique_ptr<DisplayList>(new DisplayList));
+
+    RecordLeavesData data = {&render_leaves_, &leaf_display_lists_};
+    TaskScheduler::Get()->ParallelFor(TaskPriority::Interactive,
+                                      static_cast<int>(render_leaves_.size()),
+                                      RecordLeaf,
+                                      &data);
+
+    for (size_t i = 0; i < render_leaves_.size(); ++i) {
+      ScopedRenderOffset offset(render_leaves_[i]->GetScreenRect(), true);
+      leaf_display_lists_[i]->Replay();
+    }
   }
   if (draggable_.get())
     draggable_->Render();
 }
 
+bool DockingWorkspace::NeedsPaint() const {
+  return root_->NeedsPaint();
+}
+
+void DockingWorkspace::Invalidate() {
+  root_->Invalidate();
+}
+
 void DockingWorkspace::SetRoot(Widget* root) {
   root_->ReplaceLeft(root);
   root->set_parent(root_.get());
@@ -68,13 +115,16 @@ bool DockingWorkspace::NotifyMouseMoved(int x, int y, uint8_t modifiers) {
   mouse_position_.y = static_cast<float>(y);
   if (draggable_.get()) {
     draggable_->Drag(mouse_position_);
-    // TODO(scottmg): InvalidateImpl();
+    // Drags rearrange or resize windows, rather than changing them.
+    Invalidate();
     return true;
   }
   UpdateCursorForLocation();
   Widget* focused = GetFocusedContents();
   if (!focused || !focused->WantMouseEvents())
     return false;
+  // Widgets invalidate themselves if moving or scrolling changes them, so that
+  // the mouse passing over a window doesn't redraw it.
   return focused->NotifyMouseMoved(x, y, modifiers);
 }
 
@@ -102,11 +152,11 @@ bool DockingWorkspace::NotifyMouseButton(int x,
   if (draggable_.get() && button == MouseButton::Left && !down) {
     draggable_.reset();
     UpdateCursorForLocation();
-    // TODO(scottmg): Invalidate();
+    Invalidate();
     return true;
   } else if (button == MouseButton::Left && down &&
              root_->left()->CouldStartDrag(&drag_setup)) {
-    // TODO(scottmg): Invalidate();
+    Invalidate();
     return true;
   } else if (button == MouseButton::Left) {
     Widget* target = root_->left()->FindTopMostUnderPoint(mouse_position_);
@@ -123,7 +173,7 @@ bool DockingWorkspace::NotifyMouseButton(int x,
                                   down,
                                   modifiers);
       }
-      // TODO(scottmg): Invalidate();
+      target->Invalidate();
     }
   }
   return false;
@@ -133,8 +183,11 @@ bool DockingWorkspace::NotifyKey(Key::Enum key, bool down, uint8_t modifiers) {
   Widget* focused = GetFocusedContents();
   if (!focused)
     return false;
-  if (focused->WantKeyEvents() && focused->NotifyKey(key, down, modifiers))
-    return true;
+  if (focused->WantKeyEvents()) {
+    focused->Invalidate();
+    if (focused->NotifyKey(key, down, modifiers))
+      return true;
+  }
   // TODO(scottmg): Global keys.
   // return debug_presenter_notify_->NotifyKey(key, down, modifiers);
   return false;
@@ -144,8 +197,11 @@ bool DockingWorkspace::NotifyChar(int character) {
   Widget* focused = GetFocusedContents();
   if (!focused)
     return false;
-  if (focused->WantKeyEvents() && focused->NotifyChar(character))
-    return true;
+  if (focused->WantKeyEvents()) {
+    focused->Invalidate();
+    if (focused->NotifyChar(character))
+      return true;
+  }
   // TODO(scottmg): Global keys.
   // return debug_presenter_notify_->NotifyChar(character);
   return false;
@@ -13,6 +13,7 @@
 #include "entry.h"
 #include "widget.h"
 
+class DisplayList;
 class DockingSplitContainer;
 
 // Top level container holding a tree of |Widget|s.
@@ -22,6 +23,11 @@ class DockingWorkspace : public InputHandler {
   virtual ~DockingWorkspace();
 
   void Render();
+
+  // Whether anything in the workspace has been invalidated since the last
+  // Render(), i.e. whether there's any reason to draw a frame.
+  bool NeedsPaint() const;
+  void Invalidate();
   bool CouldStartDrag(DragSetup* drag_setup);
 
   // Takes ownership.
@@ -60,6 +66,11 @@ class DockingWorkspace : public InputHandler {
   Point mouse_position_;
 
   std::unique_ptr<Draggable> draggable_;
+
+  // Per-frame state for recording the leaves of the tree in parallel. Kept
+  // across frames so the display list buffers are reused.
+  std::vector<Widget*> render_leaves_;
+  std::vector<std::unique_ptr<DisplayList>> leaf_display_lists_;
 };
 
 #endif  // DOCKING_WORKSPACE_H_
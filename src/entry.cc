@@ -8,141 +8,19 @@
 
 #include "entry.h"
 
+#include <atomic>
+#include <limits>
+
+#include "event_queue.h"
+#include "input_latency.h"
+#include "input_recording.h"
 #include "resource.h"
-#include "spscqueue.h"
 #include "threading.h"
 
 extern int Main(int argc, char** argv);
 
-struct Event {
-  enum Enum {
-    Exit,
-    Key,
-    Char,
-    Mouse,
-    Size,
-  };
-  Event::Enum type;
-};
-
-struct KeyEvent : public Event {
-  Key::Enum key;
-  uint8_t modifiers;
-  bool down;
-};
-
-struct CharEvent : public Event {
-  int character;
-};
-
-struct MouseEvent : public Event {
-  int32_t mx;
-  int32_t my;
-  float delta;
-  MouseButton::Enum button;
-  uint8_t modifiers;
-  bool down;
-  bool move;
-  bool wheel;
-};
-
-struct SizeEvent : public Event {
-  uint32_t width;
-  uint32_t height;
-};
-
-class EventQueue {
- public:
-  EventQueue() {}
-
-  void PostExitEvent() {
-    Event* ev = new Event;
-    ev->type = Event::Exit;
-    queue_.push(ev);
-  }
-
-  void PostKeyEvent(Key::Enum key, uint8_t modifiers, bool down) {
-    KeyEvent* ev = new KeyEvent;
-    ev->type = Event::Key;
-    ev->key = key;
-    ev->modifiers = modifiers;
-    ev->down = down;
-    queue_.push(ev);
-  }
-
-  void PostCharEvent(int character) {
-    CharEvent* ev = new CharEvent;
-    ev->type = Event::Char;
-    ev->character = character;
-    queue_.push(ev);
-  }
-
-  void PostMouseMoveEvent(int32_t mx, int32_t my) {
-    MouseEvent* ev = new MouseEvent;
-    ev->type = Event::Mouse;
-    ev->mx = mx;
-    ev->my = my;
-    ev->delta = 0;
-    ev->button = MouseButton::None;
-    ev->modifiers = 0;
-    ev->down = false;
-    ev->move = true;
-    ev->wheel = false;
-    queue_.push(ev);
-  }
-
-  void PostMouseWheelEvent(int32_t mx,
-                           int32_t my,
-                           float delta,
-                           uint8_t modifiers) {
-    MouseEvent* ev = new MouseEvent;
-    ev->type = Event::Mouse;
-    ev->mx = mx;
-    ev->my = my;
-    ev->delta = delta;
-    ev->modifiers = modifiers;
-    ev->button = MouseButton::None;
-    ev->down = false;
-    ev->move = false;
-    ev->wheel = true;
-    queue_.push(ev);
-  }
-
-  void PostMouseButtonEvent(int32_t mx,
-                            int32_t my,
-                            MouseButton::Enum button,
-                            bool down,
-                            uint8_t modifiers) {
-    MouseEvent* ev = new MouseEvent;
-    ev->type = Event::Mouse;
-    ev->mx = mx;
-    ev->my = my;
-    ev->delta = 0;
-    ev->button = button;
-    ev->modifiers = modifiers;
-    ev->down = down;
-    ev->move = false;
-    ev->wheel = false;
-    queue_.push(ev);
-  }
-
-  void PostSizeEvent(uint32_t width, uint32_t height) {
-    SizeEvent* ev = new SizeEvent;
-    ev->type = Event::Size;
-    ev->width = width;
-    ev->height = height;
-    queue_.push(ev);
-  }
-
-  const Event* Poll() { return queue_.Pop(); }
-
-  void Release(const Event* event) const { delete event; }
-
- private:
-  SpScQueue<Event> queue_;
-
-  DISALLOW_COPY_AND_ASSIGN(EventQueue);
-};
+// Main thread only.
+static InputRecorder s_input_recorder;
 
 struct MainThreadEntry {
   int argc_;
@@ -200,7 +78,7 @@ extern void WinGfxCreateDeviceIndependentResources();
 extern float GetDpiScale();
 
 struct Context {
-  Context() : init_(false), exit_(false) {
+  Context() : repaint_requested_(false), init_(false), exit_(false) {
     memset(s_translateKey, 0, sizeof(s_translateKey));
     s_translateKey[VK_ESCAPE] = Key::Esc;
     s_translateKey[VK_RETURN] = Key::Return;
@@ -461,11 +339,14 @@ struct Context {
             // is set to 1.
             //
             // http://msdn.microsoft.com/en-us/library/windows/desktop/ms646280%28v=vs.85%29.aspx
-            event_queue_.PostKeyEvent(key, modifiers, true);
+            event_queue_.PostKeyEvent(key, modifiers, true, false);
           }
 
-          event_queue_.PostKeyEvent(
-              key, modifiers, id == WM_KEYDOWN || id == WM_SYSKEYDOWN);
+          bool down = id == WM_KEYDOWN || id == WM_SYSKEYDOWN;
+          // Bit 30 is the previous key state, so a key-down with it set is
+          // an auto-repeat.
+          bool repeat = down && (lparam & (1 << 30)) != 0;
+          event_queue_.PostKeyEvent(key, modifiers, down, repeat);
         } break;
 
         case WM_CHAR: {
@@ -477,7 +358,11 @@ struct Context {
           return TRUE;
 
         case WM_PAINT: {
+          // Frames are only drawn when something changed, so have the main
+          // thread redraw whatever Windows thinks is stale.
           ::ValidateRect(hwnd, NULL);
+          repaint_requested_.store(true);
+          event_queue_.Wake();
           return TRUE;
         }
 
@@ -515,6 +400,7 @@ struct Context {
   WndProc(HWND hwnd, UINT id, WPARAM wparam, LPARAM lparam);
 
   EventQueue event_queue_;
+  std::atomic<bool> repaint_requested_;
 
   HWND hwnd_;
   bool init_;
@@ -528,12 +414,26 @@ Context::WndProc(HWND hwnd, UINT id, WPARAM wparam, LPARAM lparam) {
   return s_ctx.Process(hwnd, id, wparam, lparam);
 }
 
-const Event* Poll() {
-  return s_ctx.event_queue_.Poll();
+bool Poll(Event* event) {
+  return s_ctx.event_queue_.Poll(event);
+}
+
+void WaitForEventOrDeadline(double deadline) {
+  double now = static_cast<double>(GetHPCounter()) /
+               static_cast<double>(GetHPFrequency());
+  if (deadline <= now)
+    return;
+  s_ctx.event_queue_.Wait(
+      deadline == std::numeric_limits<double>::infinity() ? -1.0
+                                                          : deadline - now);
 }
 
-void Release(const Event* event) {
-  s_ctx.event_queue_.Release(event);
+void PostWakeup() {
+  s_ctx.event_queue_.Wake();
+}
+
+bool TakeRepaintRequest() {
+  return s_ctx.repaint_requested_.exchange(false);
 }
 
 void SetWindowSize(uint32_t width, uint32_t height) {
@@ -557,77 +457,21 @@ int32_t MainThreadEntry::ThreadFunc(void* user_data) {
 #endif  // PLATFORM_WINDOWS
 
 bool ProcessEvents(uint32_t* width, uint32_t* height, InputHandler* handler) {
-  const Event* ev;
-  do {
-    struct SE {
-      const Event* ev_;
-      SE() : ev_(Poll()) {}
-      ~SE() {
-        if (NULL != ev_) {
-          Release(ev_);
-        }
-      }
-    } scoped_event;
-    ev = scoped_event.ev_;
-
-    if (ev) {
-      switch (ev->type) {
-        case Event::Exit:
-          return true;
-
-        case Event::Mouse:
-          if (handler->WantMouseEvents()) {
-            const MouseEvent& mouse_event = *static_cast<const MouseEvent*>(ev);
-            if (mouse_event.move) {
-              handler->NotifyMouseMoved(
-                  mouse_event.mx, mouse_event.my, mouse_event.modifiers);
-            } else if (mouse_event.wheel) {
-              handler->NotifyMouseWheel(mouse_event.mx,
-                                        mouse_event.my,
-                                        mouse_event.delta,
-                                        mouse_event.modifiers);
-            } else {
-              // Button press.
-              handler->NotifyMouseButton(mouse_event.mx,
-                                         mouse_event.my,
-                                         mouse_event.button,
-                                         mouse_event.down,
-                                         mouse_event.modifiers);
-            }
-          }
-          break;
-
-        case Event::Key:
-          if (handler->WantKeyEvents()) {
-            const KeyEvent& key_event = *static_cast<const KeyEvent*>(ev);
-            handler->NotifyKey(
-                key_event.key, key_event.down, key_event.modifiers);
-          }
-          break;
-
-        case Event::Char:
-          if (handler->WantKeyEvents()) {
-            const CharEvent& char_event = *static_cast<const CharEvent*>(ev);
-            handler->NotifyChar(char_event.character);
-          }
-          break;
-
-        case Event::Size: {
-          const SizeEvent& size_event = *static_cast<const SizeEvent*>(ev);
-          *width = size_event.width;
-          *height = size_event.height;
-          break;
-        }
-
-        default:
-          break;
-      }
-    }
-  } while (ev);
-
+  Event ev;
+  while (Poll(&ev)) {
+    NoteInputDispatched(ev.time, GetHPCounter());
+    if (s_input_recorder.IsOpen())
+      s_input_recorder.Record(ev);
+    if (DispatchEvent(ev, width, height, handler))
+      return true;
+  }
   return false;
 }
 
+bool StartInputRecording(const char* path) {
+  return s_input_recorder.Open(path);
+}
+
 int main(int argc, char** argv) {
   return s_ctx.Run(argc, argv);
 }
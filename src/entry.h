@@ -139,6 +139,23 @@ bool ProcessEvents(uint32_t* width,
                    uint32_t* height,
                    InputHandler* input_handler);
 
+// Saves everything ProcessEvents() dispatches from now on to |path|, for
+// replaying with ReplayInput(). Returns false if |path| can't be written.
+bool StartInputRecording(const char* path);
+
+// Blocks the main thread until there's input for ProcessEvents(),
+// PostWakeup() is called, or |deadline| is reached. |deadline| is in seconds
+// on the GetHPCounter() clock; infinity waits indefinitely. May return early.
+void WaitForEventOrDeadline(double deadline);
+
+// Makes WaitForEventOrDeadline() return. May be called from any thread, e.g.
+// once background work has something to show.
+void PostWakeup();
+
+// True once after the window system asked for the window to be redrawn,
+// e.g. after it was uncovered.
+bool TakeRepaintRequest();
+
 void SetWindowSize(uint32_t width, uint32_t height);
 
 struct MouseCursor {
@@ -0,0 +1,290 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "event_queue.h"
+
+#include "threading.h"
+
+namespace {
+
+// How long the producer waits for space before checking again, in case the
+// consumer's wakeup was missed.
+const double kSpaceWaitSeconds = 0.005;
+
+bool IsMouseMove(const Event& event) {
+  return event.type == Event::Mouse && event.mouse.move;
+}
+
+bool IsMouseWheel(const Event& event) {
+  return event.type == Event::Mouse && event.mouse.wheel;
+}
+
+bool IsRepeatedNavigationKey(const Event& event) {
+  if (event.type != Event::Key || !event.key.down || !event.key.repeat)
+    return false;
+  switch (event.key.key) {
+    case Key::Up:
+    case Key::Down:
+    case Key::Left:
+    case Key::Right:
+    case Key::PageUp:
+    case Key::PageDown:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Folds |next| into |event| and returns true if dispatching them separately
+// would be redundant.
+bool Coalesce(Event* event, const Event& next) {
+  if (IsMouseMove(*event) && IsMouseMove(next)) {
+    int64_t time = event->time;
+    *event = next;
+    event->time = time;
+    return true;
+  }
+  if (IsMouseWheel(*event) && IsMouseWheel(next) &&
+      event->mouse.modifiers == next.mouse.modifiers) {
+    event->mouse.mx = next.mouse.mx;
+    event->mouse.my = next.mouse.my;
+    event->mouse.delta += next.mouse.delta;
+    return true;
+  }
+  if (IsRepeatedNavigationKey(*event) && IsRepeatedNavigationKey(next) &&
+      event->key.key == next.key.key &&
+      event->key.modifiers == next.key.modifiers) {
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+EventQueue::EventQueue() : producer_waiting_(false), has_held_move_(false) {
+}
+
+EventQueue::~EventQueue() {
+}
+
+void EventQueue::Post(Event* event) {
+  event->time = GetHPCounter();
+  Enqueue(*event);
+  wake_.Signal();
+}
+
+void EventQueue::Enqueue(const Event& event) {
+  if (IsMouseMove(event)) {
+    // Only the latest position matters, and one's held until there's room.
+    if (ReplaceHeldMove(event))
+      return;
+    if (!queue_.TryPush(event))
+      HoldMove(event);
+    return;
+  }
+
+  Event move;
+  if (TakeHeldMove(&move))
+    PushWhenSpace(move);
+  // Nothing else can be dropped or merged.
+  PushWhenSpace(event);
+}
+
+void EventQueue::PushWhenSpace(const Event& event) {
+  if (queue_.TryPush(event))
+    return;
+  producer_waiting_.store(true);
+  while (!queue_.TryPush(event))
+    space_.Wait(kSpaceWaitSeconds);
+  producer_waiting_.store(false);
+}
+
+void EventQueue::HoldMove(const Event& event) {
+  ScopedFutex lock(&held_move_lock_);
+  held_move_ = event;
+  has_held_move_.store(true, std::memory_order_release);
+}
+
+bool EventQueue::ReplaceHeldMove(const Event& event) {
+  if (!has_held_move_.load(std::memory_order_acquire))
+    return false;
+  ScopedFutex lock(&held_move_lock_);
+  if (!has_held_move_.load(std::memory_order_relaxed))
+    return false;
+  held_move_ = event;
+  return true;
+}
+
+bool EventQueue::TakeHeldMove(Event* event) {
+  if (!has_held_move_.load(std::memory_order_acquire))
+    return false;
+  ScopedFutex lock(&held_move_lock_);
+  if (!has_held_move_.load(std::memory_order_relaxed))
+    return false;
+  *event = held_move_;
+  has_held_move_.store(false, std::memory_order_relaxed);
+  return true;
+}
+
+void EventQueue::PostExitEvent() {
+  Event ev;
+  ev.type = Event::Exit;
+  Post(&ev);
+}
+
+void EventQueue::PostKeyEvent(Key::Enum key,
+                              uint8_t modifiers,
+                              bool down,
+                              bool repeat) {
+  Event ev;
+  ev.type = Event::Key;
+  ev.key.key = key;
+  ev.key.modifiers = modifiers;
+  ev.key.down = down;
+  ev.key.repeat = repeat;
+  Post(&ev);
+}
+
+void EventQueue::PostCharEvent(int character) {
+  Event ev;
+  ev.type = Event::Char;
+  ev.text.character = character;
+  Post(&ev);
+}
+
+void EventQueue::PostMouseMoveEvent(int32_t mx, int32_t my) {
+  Event ev;
+  ev.type = Event::Mouse;
+  ev.mouse.mx = mx;
+  ev.mouse.my = my;
+  ev.mouse.delta = 0;
+  ev.mouse.button = MouseButton::None;
+  ev.mouse.modifiers = 0;
+  ev.mouse.down = false;
+  ev.mouse.move = true;
+  ev.mouse.wheel = false;
+  Post(&ev);
+}
+
+void EventQueue::PostMouseWheelEvent(int32_t mx,
+                                     int32_t my,
+                                     float delta,
+                                     uint8_t modifiers) {
+  Event ev;
+  ev.type = Event::Mouse;
+  ev.mouse.mx = mx;
+  ev.mouse.my = my;
+  ev.mouse.delta = delta;
+  ev.mouse.modifiers = modifiers;
+  ev.mouse.button = MouseButton::None;
+  ev.mouse.down = false;
+  ev.mouse.move = false;
+  ev.mouse.wheel = true;
+  Post(&ev);
+}
+
+void EventQueue::PostMouseButtonEvent(int32_t mx,
+                                      int32_t my,
+                                      MouseButton::Enum button,
+                                      bool down,
+                                      uint8_t modifiers) {
+  Event ev;
+  ev.type = Event::Mouse;
+  ev.mouse.mx = mx;
+  ev.mouse.my = my;
+  ev.mouse.delta = 0;
+  ev.mouse.button = button;
+  ev.mouse.modifiers = modifiers;
+  ev.mouse.down = down;
+  ev.mouse.move = false;
+  ev.mouse.wheel = false;
+  Post(&ev);
+}
+
+void EventQueue::PostSizeEvent(uint32_t width, uint32_t height) {
+  Event ev;
+  ev.type = Event::Size;
+  ev.size.width = width;
+  ev.size.height = height;
+  Post(&ev);
+}
+
+bool EventQueue::Poll(Event* event) {
+  // A held move is newer than everything in the queue, so it's only taken
+  // once the queue is empty.
+  if (!queue_.TryPop(event))
+    return TakeHeldMove(event);
+  Event merged;
+  while (const Event* next = queue_.Peek()) {
+    if (!Coalesce(event, *next))
+      break;
+    queue_.TryPop(&merged);
+  }
+  if (producer_waiting_.load())
+    space_.Signal();
+  return true;
+}
+
+void EventQueue::Wait(double seconds) {
+  if (!queue_.Peek() && !has_held_move_.load(std::memory_order_acquire))
+    wake_.Wait(seconds);
+}
+
+void EventQueue::Wake() {
+  wake_.Signal();
+}
+
+bool DispatchEvent(const Event& ev,
+                   uint32_t* width,
+                   uint32_t* height,
+                   InputHandler* handler) {
+  switch (ev.type) {
+    case Event::Exit:
+      return true;
+
+    case Event::Mouse:
+      if (handler->WantMouseEvents()) {
+        const MouseEvent& mouse_event = ev.mouse;
+        if (mouse_event.move) {
+          handler->NotifyMouseMoved(
+              mouse_event.mx, mouse_event.my, mouse_event.modifiers);
+        } else if (mouse_event.wheel) {
+          handler->NotifyMouseWheel(mouse_event.mx,
+                                    mouse_event.my,
+                                    mouse_event.delta,
+                                    mouse_event.modifiers);
+        } else {
+          // Button press.
+          handler->NotifyMouseButton(mouse_event.mx,
+                                     mouse_event.my,
+                                     mouse_event.button,
+                                     mouse_event.down,
+                                     mouse_event.modifiers);
+        }
+      }
+      break;
+
+    case Event::Key:
+      if (handler->WantKeyEvents()) {
+        const KeyEvent& key_event = ev.key;
+        handler->NotifyKey(key_event.key, key_event.down, key_event.modifiers);
+      }
+      break;
+
+    case Event::Char:
+      if (handler->WantKeyEvents())
+        handler->NotifyChar(ev.text.character);
+      break;
+
+    case Event::Size:
+      *width = ev.size.width;
+      *height = ev.size.height;
+      break;
+
+    default:
+      break;
+  }
+
+  return false;
+}
@@ -0,0 +1,148 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef EVENT_QUEUE_H_
+#define EVENT_QUEUE_H_
+
+#include <atomic>
+
+#include "core.h"
+#include "entry.h"
+#include "spscqueue.h"
+#include "threading.h"
+
+struct KeyEvent {
+  Key::Enum key;
+  uint8_t modifiers;
+  bool down;
+  // A key-down generated by auto-repeat while the key is held.
+  bool repeat;
+};
+
+struct CharEvent {
+  int character;
+};
+
+struct MouseEvent {
+  int32_t mx;
+  int32_t my;
+  float delta;
+  MouseButton::Enum button;
+  uint8_t modifiers;
+  bool down;
+  bool move;
+  bool wheel;
+};
+
+struct SizeEvent {
+  uint32_t width;
+  uint32_t height;
+};
+
+// Events are passed by value so that queueing doesn't allocate.
+struct Event {
+  enum Enum {
+    Exit,
+    Key,
+    Char,
+    Mouse,
+    Size,
+  };
+  Event::Enum type;
+  // GetHPCounter() when posted. When events are coalesced, the oldest.
+  int64_t time;
+  union {
+    KeyEvent key;
+    CharEvent text;
+    MouseEvent mouse;
+    SizeEvent size;
+  };
+};
+
+// Carries input from the window thread (the producer) to the main thread (the
+// consumer) through a fixed-size ring buffer. If the main thread falls far
+// enough behind that the buffer fills, a mouse move is held back and
+// replaced by any newer move. The consumer takes it once it has handled
+// everything before it, even if nothing else is posted. Other events wait
+// for space.
+//
+// Poll() merges runs of events that would only repeat work if dispatched one
+// at a time, so the amount of input handled per frame is bounded by the
+// number of distinct actions rather than by how fast events arrive.
+class EventQueue {
+ public:
+  EventQueue();
+  ~EventQueue();
+
+  // Producer only.
+  void PostExitEvent();
+  void PostKeyEvent(Key::Enum key, uint8_t modifiers, bool down, bool repeat);
+  void PostCharEvent(int character);
+  void PostMouseMoveEvent(int32_t mx, int32_t my);
+  void PostMouseWheelEvent(int32_t mx,
+                           int32_t my,
+                           float delta,
+                           uint8_t modifiers);
+  void PostMouseButtonEvent(int32_t mx,
+                            int32_t my,
+                            MouseButton::Enum button,
+                            bool down,
+                            uint8_t modifiers);
+  void PostSizeEvent(uint32_t width, uint32_t height);
+
+  // Consumer only. Returns false if there are no events. Consecutive mouse
+  // moves are merged into the last one, consecutive wheel events with the
+  // same modifiers into one with the summed delta, and consecutive
+  // auto-repeats of a navigation key (arrows, page up/down) into one.
+  bool Poll(Event* event);
+
+  // Consumer only. Returns when there's an event to Poll(), Wake() is called,
+  // or |seconds| have passed, if not negative. Like WakeEvent::Wait(), it can
+  // return early.
+  void Wait(double seconds);
+
+  // Any thread. Makes Wait() return.
+  void Wake();
+
+  static const uint32_t kCapacity = 1024;
+
+ private:
+  void Post(Event* event);
+  void Enqueue(const Event& event);
+  // Producer only. Waits for the consumer to make room for |event|.
+  void PushWhenSpace(const Event& event);
+
+  // Any thread. Hold |event| as the pending move, replacing any that's there,
+  // or only if there's one already. Returns whether it was held.
+  void HoldMove(const Event& event);
+  bool ReplaceHeldMove(const Event& event);
+  // Any thread. Takes the pending move, if there is one.
+  bool TakeHeldMove(Event* event);
+
+  SpScRingBuffer<Event, kCapacity> queue_;
+  WakeEvent wake_;
+
+  // Signaled by the consumer when it makes room while the producer is
+  // waiting for it.
+  WakeEvent space_;
+  std::atomic<bool> producer_waiting_;
+
+  // A mouse move that didn't fit. It's newer than everything in |queue_|, so
+  // the producer pushes it ahead of any other event, and the consumer takes
+  // it once |queue_| is empty.
+  Futex held_move_lock_;
+  Event held_move_;
+  std::atomic<bool> has_held_move_;
+
+  DISALLOW_COPY_AND_ASSIGN(EventQueue);
+};
+
+// Sends |ev| to |handler|, or for a Size event, updates |width| and |height|.
+// Returns true for an Exit event.
+bool DispatchEvent(const Event& ev,
+                   uint32_t* width,
+                   uint32_t* height,
+                   InputHandler* handler);
+
+#endif  // EVENT_QUEUE_H_
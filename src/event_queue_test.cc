@@ -0,0 +1,189 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "event_queue.h"
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+class EventQueueTest : public ::testing::Test {
+ public:
+  EventQueueTest() : queue_(new EventQueue) {}
+
+ protected:
+  // The ring buffer is too big to be comfortable on the stack.
+  std::unique_ptr<EventQueue> queue_;
+};
+
+TEST_F(EventQueueTest, MovesCoalesce) {
+  queue_->PostMouseMoveEvent(1, 2);
+  queue_->PostMouseMoveEvent(3, 4);
+  queue_->PostMouseMoveEvent(5, 6);
+  queue_->PostMouseButtonEvent(5, 6, MouseButton::Left, true, 0);
+  queue_->PostMouseMoveEvent(7, 8);
+
+  Event ev;
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_EQ(Event::Mouse, ev.type);
+  EXPECT_TRUE(ev.mouse.move);
+  EXPECT_EQ(5, ev.mouse.mx);
+  EXPECT_EQ(6, ev.mouse.my);
+
+  // The button press keeps its place between the moves.
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_FALSE(ev.mouse.move);
+  EXPECT_EQ(MouseButton::Left, ev.mouse.button);
+
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_TRUE(ev.mouse.move);
+  EXPECT_EQ(7, ev.mouse.mx);
+
+  EXPECT_FALSE(queue_->Poll(&ev));
+}
+
+TEST_F(EventQueueTest, WheelDeltasSum) {
+  queue_->PostMouseWheelEvent(1, 1, 1.f, 0);
+  queue_->PostMouseWheelEvent(2, 2, 1.f, 0);
+  queue_->PostMouseWheelEvent(3, 3, -0.5f, 0);
+  queue_->PostMouseWheelEvent(4, 4, 1.f, Modifier::LeftCtrl);
+
+  Event ev;
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_TRUE(ev.mouse.wheel);
+  EXPECT_EQ(1.5f, ev.mouse.delta);
+  EXPECT_EQ(3, ev.mouse.mx);
+
+  // Different modifiers mean a different action, e.g. zoom.
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_EQ(1.f, ev.mouse.delta);
+  EXPECT_EQ(Modifier::LeftCtrl, ev.mouse.modifiers);
+
+  EXPECT_FALSE(queue_->Poll(&ev));
+}
+
+TEST_F(EventQueueTest, NavigationRepeatsCollapse) {
+  queue_->PostKeyEvent(Key::Down, 0, true, false);
+  queue_->PostKeyEvent(Key::Down, 0, true, true);
+  queue_->PostKeyEvent(Key::Down, 0, true, true);
+  queue_->PostKeyEvent(Key::Down, 0, true, true);
+  queue_->PostKeyEvent(Key::Down, 0, false, false);
+  queue_->PostKeyEvent(Key::KeyA, 0, true, true);
+  queue_->PostKeyEvent(Key::KeyA, 0, true, true);
+
+  Event ev;
+  // The initial press is never merged with its repeats.
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_EQ(Event::Key, ev.type);
+  EXPECT_FALSE(ev.key.repeat);
+
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_EQ(Key::Down, ev.key.key);
+  EXPECT_TRUE(ev.key.repeat);
+
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_FALSE(ev.key.down);
+
+  // Typing isn't navigation, so every repeat is delivered.
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_EQ(Key::KeyA, ev.key.key);
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_EQ(Key::KeyA, ev.key.key);
+
+  EXPECT_FALSE(queue_->Poll(&ev));
+}
+
+TEST_F(EventQueueTest, FullQueueKeepsLatestMove) {
+  for (uint32_t i = 0; i < EventQueue::kCapacity; ++i)
+    queue_->PostCharEvent('a');
+  queue_->PostMouseMoveEvent(1, 1);
+  queue_->PostMouseMoveEvent(2, 2);
+
+  Event ev;
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(queue_->Poll(&ev));
+    EXPECT_EQ(Event::Char, ev.type);
+  }
+  // A newer move replaces the held one, even though there's room now.
+  queue_->PostMouseMoveEvent(3, 3);
+
+  for (uint32_t i = 2; i < EventQueue::kCapacity; ++i) {
+    ASSERT_TRUE(queue_->Poll(&ev));
+    EXPECT_EQ(Event::Char, ev.type);
+  }
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_TRUE(ev.mouse.move);
+  EXPECT_EQ(3, ev.mouse.mx);
+  EXPECT_FALSE(queue_->Poll(&ev));
+}
+
+TEST_F(EventQueueTest, HeldMoveArrivesWithoutMoreInput) {
+  for (uint32_t i = 0; i < EventQueue::kCapacity; ++i)
+    queue_->PostCharEvent('a');
+  queue_->PostMouseMoveEvent(1, 1);
+  queue_->PostMouseMoveEvent(2, 2);
+
+  Event ev;
+  for (uint32_t i = 0; i < EventQueue::kCapacity; ++i) {
+    ASSERT_TRUE(queue_->Poll(&ev));
+    EXPECT_EQ(Event::Char, ev.type);
+  }
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_TRUE(ev.mouse.move);
+  EXPECT_EQ(2, ev.mouse.mx);
+  EXPECT_FALSE(queue_->Poll(&ev));
+}
+
+TEST_F(EventQueueTest, HeldMoveGoesAheadOfOtherEvents) {
+  for (uint32_t i = 0; i < EventQueue::kCapacity; ++i)
+    queue_->PostCharEvent('a');
+  queue_->PostMouseMoveEvent(1, 1);
+
+  Event ev;
+  ASSERT_TRUE(queue_->Poll(&ev));
+  ASSERT_TRUE(queue_->Poll(&ev));
+  queue_->PostCharEvent('b');
+
+  for (uint32_t i = 2; i < EventQueue::kCapacity; ++i) {
+    ASSERT_TRUE(queue_->Poll(&ev));
+    EXPECT_EQ('a', ev.text.character);
+  }
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_TRUE(ev.mouse.move);
+  ASSERT_TRUE(queue_->Poll(&ev));
+  EXPECT_EQ('b', ev.text.character);
+  EXPECT_FALSE(queue_->Poll(&ev));
+}
+
+namespace {
+
+const int kOverflowEvents = 3 * EventQueue::kCapacity;
+
+int32_t PostManyChars(void* user_data) {
+  EventQueue* queue = reinterpret_cast<EventQueue*>(user_data);
+  for (int i = 0; i < kOverflowEvents; ++i)
+    queue->PostCharEvent(i);
+  return 0;
+}
+
+}  // namespace
+
+TEST_F(EventQueueTest, ProducerWaitsForSpace) {
+  Thread producer;
+  producer.Init(PostManyChars, queue_.get());
+
+  // Everything arrives in order, however far behind the consumer is.
+  Event ev;
+  for (int i = 0; i < kOverflowEvents;) {
+    if (!queue_->Poll(&ev)) {
+      queue_->Wait(0.01);
+      continue;
+    }
+    ASSERT_EQ(Event::Char, ev.type);
+    ASSERT_EQ(i, ev.text.character);
+    ++i;
+  }
+  producer.Shutdown();
+  EXPECT_FALSE(queue_->Poll(&ev));
+}
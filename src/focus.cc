@@ -4,6 +4,8 @@
 
 #include "focus.h"
 
+#include "widget.h"
+
 namespace {
 
 Widget* g_focused;
@@ -17,5 +19,16 @@ Widget* GetFocusedContents() {
 }
 
 void SetFocusedContents(Widget* contents) {
+  if (contents == g_focused)
+    return;
+  if (g_focused)
+    g_focused->Invalidate();
   g_focused = contents;
+  if (g_focused)
+    g_focused->Invalidate();
+}
+
+void ReleaseFocus(Widget* contents) {
+  if (g_focused == contents)
+    g_focused = NULL;
 }
@@ -8,6 +8,13 @@
 class Widget;
 
 Widget* GetFocusedContents();
+
+// Both the previously and newly focused widgets are invalidated, as focus
+// changes how they draw (title bars, carets).
 void SetFocusedContents(Widget* contents);
 
+// Clears focus without invalidating if |contents| has it. Used when
+// |contents| is being destroyed.
+void ReleaseFocus(Widget* contents);
+
 #endif  // FOCUS_H_
@@ -0,0 +1,115 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "frame_scheduler.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "core.h"
+#include "entry.h"
+#include "threading.h"
+#include "widget.h"
+
+namespace {
+
+struct ScheduledInvalidate {
+  Widget* widget;
+  double time;
+};
+
+double g_frame_time;
+double g_virtual_clock = -1.0;
+
+// Only a handful of widgets are animating at once, so this is a plain list.
+Futex g_scheduled_lock;
+std::vector<ScheduledInvalidate> g_scheduled;
+// The earliest time the main loop might be sleeping until, so that only
+// earlier invalidations need to wake it. While a frame is being rendered it's
+// -infinity, as the loop looks at the schedule again before sleeping.
+double g_wake_deadline = std::numeric_limits<double>::infinity();
+
+}  // namespace
+
+double GetAnimationClock() {
+  if (g_virtual_clock >= 0.0)
+    return g_virtual_clock;
+  return static_cast<double>(GetHPCounter()) /
+         static_cast<double>(GetHPFrequency());
+}
+
+void SetVirtualAnimationClock(double time) {
+  g_virtual_clock = time;
+}
+
+double GetFrameTime() {
+  return g_frame_time;
+}
+
+void SetFrameTime(double time) {
+  g_frame_time = time;
+  ScopedFutex lock(&g_scheduled_lock);
+  g_wake_deadline = -std::numeric_limits<double>::infinity();
+}
+
+void ScheduleInvalidate(Widget* widget, double time) {
+  bool wake = false;
+  {
+    ScopedFutex lock(&g_scheduled_lock);
+    auto it = std::find_if(g_scheduled.begin(),
+                           g_scheduled.end(),
+                           [widget](const ScheduledInvalidate& scheduled) {
+                             return scheduled.widget == widget;
+                           });
+    if (it != g_scheduled.end()) {
+      it->time = std::min(it->time, time);
+    } else {
+      ScheduledInvalidate scheduled = {widget, time};
+      g_scheduled.push_back(scheduled);
+    }
+    // Animating widgets reschedule from every Render(), which mustn't cost a
+    // wakeup each.
+    if (time < g_wake_deadline) {
+      g_wake_deadline = time;
+      wake = true;
+    }
+  }
+  if (wake)
+    PostWakeup();
+}
+
+void CancelScheduledInvalidate(Widget* widget) {
+  ScopedFutex lock(&g_scheduled_lock);
+  g_scheduled.erase(
+      std::remove_if(g_scheduled.begin(),
+                     g_scheduled.end(),
+                     [widget](const ScheduledInvalidate& scheduled) {
+                       return scheduled.widget == widget;
+                     }),
+      g_scheduled.end());
+}
+
+double RunScheduledInvalidates(double now) {
+  double next = std::numeric_limits<double>::infinity();
+  // Collected first so that Invalidate() isn't called with the lock held.
+  std::vector<Widget*> due;
+  {
+    ScopedFutex lock(&g_scheduled_lock);
+    for (size_t i = 0; i < g_scheduled.size();) {
+      if (g_scheduled[i].time <= now) {
+        due.push_back(g_scheduled[i].widget);
+        g_scheduled[i] = g_scheduled.back();
+        g_scheduled.pop_back();
+      } else {
+        next = std::min(next, g_scheduled[i].time);
+        ++i;
+      }
+    }
+    g_wake_deadline = next;
+  }
+  for (auto* widget : due)
+    widget->Invalidate();
+  return next;
+}
@@ -0,0 +1,44 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FRAME_SCHEDULER_H_
+#define FRAME_SCHEDULER_H_
+
+class Widget;
+
+// The main loop only renders a frame when something has been invalidated,
+// rather than continuously. Animations are driven by time (GetFrameTime()),
+// not by counting frames, so they run at the same speed at any frame rate. A
+// widget that's animating asks to be invalidated again at the time it'll
+// next change with Widget::InvalidateAt(), and between frames the main loop
+// sleeps until the earliest of those, or until input arrives.
+
+// Seconds on the high-resolution timer.
+double GetAnimationClock();
+
+// Makes GetAnimationClock() return |time| until it's called again with a
+// negative value. Used when replaying input, so that animations follow the
+// recorded timeline rather than how fast the replay runs.
+void SetVirtualAnimationClock(double time);
+
+// The time of the frame being rendered. Widgets should use this rather than
+// the clock in Render() so that everything in a frame agrees. Setting it
+// starts a frame, until the next RunScheduledInvalidates().
+double GetFrameTime();
+void SetFrameTime(double time);
+
+// Invalidates |widget| once |time| is reached. If |widget| already has one
+// pending, the earlier time is kept. May be called from any thread; if |time|
+// is before the deadline the main loop is waiting for, it wakes the loop so
+// that it picks up the new one.
+void ScheduleInvalidate(Widget* widget, double time);
+
+// Drops a pending invalidation for |widget|, e.g. as it's being destroyed.
+void CancelScheduledInvalidate(Widget* widget);
+
+// Invalidates widgets whose time is at or before |now|, and returns the time
+// of the earliest one still pending, or infinity if there are none.
+double RunScheduledInvalidates(double now);
+
+#endif  // FRAME_SCHEDULER_H_
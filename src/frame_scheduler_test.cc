@@ -0,0 +1,73 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "frame_scheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+
+#include "widget.h"
+
+// In test_stubs.cc.
+extern int g_post_wakeup_count;
+
+TEST(FrameSchedulerTest, InvalidatesWhenDue) {
+  Widget parent;
+  Widget child;
+  child.set_parent(&parent);
+  parent.ClearNeedsPaint();
+  child.ClearNeedsPaint();
+
+  child.InvalidateAt(10.0);
+  // The earlier of two requests wins.
+  child.InvalidateAt(5.0);
+  child.InvalidateAt(7.0);
+
+  EXPECT_EQ(5.0, RunScheduledInvalidates(1.0));
+  EXPECT_FALSE(child.NeedsPaint());
+  EXPECT_FALSE(parent.NeedsPaint());
+
+  EXPECT_EQ(std::numeric_limits<double>::infinity(),
+            RunScheduledInvalidates(5.0));
+  EXPECT_TRUE(child.NeedsPaint());
+  EXPECT_TRUE(parent.NeedsPaint());
+}
+
+TEST(FrameSchedulerTest, DestroyedWidgetIsForgotten) {
+  {
+    Widget widget;
+    widget.InvalidateAt(1.0);
+  }
+  EXPECT_EQ(std::numeric_limits<double>::infinity(),
+            RunScheduledInvalidates(2.0));
+}
+
+TEST(FrameSchedulerTest, WakesOnlyForEarlierDeadlines) {
+  Widget animating;
+  Widget other;
+  // The main loop would now sleep until something is scheduled.
+  RunScheduledInvalidates(0.0);
+  int wakeups = g_post_wakeup_count;
+
+  animating.InvalidateAt(5.0);
+  EXPECT_EQ(wakeups + 1, g_post_wakeup_count);
+  // Later than what the loop will wake for anyway.
+  other.InvalidateAt(6.0);
+  EXPECT_EQ(wakeups + 1, g_post_wakeup_count);
+
+  // Rescheduling while rendering a frame doesn't wake, as the loop looks
+  // again before sleeping.
+  EXPECT_EQ(6.0, RunScheduledInvalidates(5.0));
+  SetFrameTime(5.0);
+  animating.InvalidateAt(5.5);
+  EXPECT_EQ(wakeups + 1, g_post_wakeup_count);
+  EXPECT_EQ(5.5, RunScheduledInvalidates(5.0));
+  SetFrameTime(0.0);
+
+  // Back to sleeping until 5.5, so an earlier time wakes it again.
+  RunScheduledInvalidates(5.0);
+  other.InvalidateAt(5.2);
+  EXPECT_EQ(wakeups + 2, g_post_wakeup_count);
+}
@@ -17,7 +17,9 @@ class Widget;
 
 void GfxInit();
 void GfxResize(uint32_t width, uint32_t height);
-void GfxFrame();
+// Presents the frame and starts the next one. Returns true if the device was
+// lost, in which case everything has to be redrawn.
+bool GfxFrame();
 void GfxShutdown();
 
 // Perhaps a bit anemic.
@@ -134,9 +136,35 @@ struct ScopedRenderOffset {
 
   ~ScopedRenderOffset();
 
-  class Data;
-  std::unique_ptr<Data> data_;
   bool scissor_;
+  // Set when the offset was recorded into a DisplayList rather than applied.
+  bool recorded_;
+};
+
+// An offscreen surface that can be drawn into with ScopedRenderIntoLayer and
+// then composited (possibly scaled and faded) with GfxDrawLayer. Contents are
+// kept across frames, so something expensive to draw can be re-drawn only
+// when it changes. Layers must be created and destroyed on the main thread.
+struct GfxLayer;
+GfxLayer* GfxCreateLayer();
+void GfxDestroyLayer(GfxLayer* layer);
+
+// Whether the layer's contents are missing (never drawn, or lost with the
+// device) or are at a size other than |width| x |height|, i.e. whether it
+// needs to be drawn into before being composited.
+bool GfxLayerNeedsRepaint(GfxLayer* layer, float width, float height);
+
+void GfxDrawLayer(GfxLayer* layer, const Rect& rect, float alpha);
+
+// Redirects drawing into |layer|, which is cleared to transparent and resized
+// to |width| x |height| if necessary. Drawing is in layer coordinates, with
+// no offset or clip inherited from the enclosing target.
+struct ScopedRenderIntoLayer {
+  ScopedRenderIntoLayer(GfxLayer* layer, float width, float height);
+  ~ScopedRenderIntoLayer();
+
+  GfxLayer* layer_;
+  bool recorded_;
 };
 
 void DrawWindow(const char* title,
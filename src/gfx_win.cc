@@ -8,16 +8,23 @@
 #include <d2d1.h>
 #include <d2d1helper.h>
 #include <dwrite.h>
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include <wincodec.h>
 
 #include <algorithm>
 #include <limits>
-#include <unordered_map>
 
+#include "atlas_packer.h"
+#include "display_list.h"
 #include "entry.h"
+#include "input_latency.h"
+#include "render_stack.h"
 #include "resource.h"
 #include "skin.h"
+#include "threading.h"
+#include "utf8.h"
 
 #pragma comment(lib, "d2d1.lib")
 #pragma comment(lib, "dwrite.lib")
@@ -34,6 +41,10 @@ static float g_dpi_scale = 1.0;
 static IWICImagingFactory* g_wic_factory;
 static ID2D1Factory* g_direct2d_factory;
 static ID2D1HwndRenderTarget* g_render_target;
+// Either |g_render_target|, or the layer being drawn into by a
+// ScopedRenderIntoLayer. All drawing goes here; device resources are created
+// from |g_render_target| and are shared with layers.
+static ID2D1RenderTarget* g_current_target;
 static IDWriteFactory* g_dwrite_factory;
 static IDWriteTextFormat* g_text_format_mono;
 static IDWriteTextFormat* g_text_format_ui;
@@ -43,27 +54,204 @@ static ID2D1LinearGradientBrush* g_title_bar_inactive_gradient_brush;
 int operator+(Icon val) {
   return static_cast<int>(val);
 }
-static ID2D1Bitmap* g_icons[static_cast<int>(Icon::Count)];
-struct ColorHash {
-  size_t operator()(const Color& c) const {
-    return (static_cast<size_t>(c.a * 255.f) << 24) +
-           (static_cast<size_t>(c.r * 255.f) << 16) +
-           (static_cast<size_t>(c.g * 255.f) << 8) +
-           static_cast<size_t>(c.b * 255.f);
+struct IconPixels {
+  UINT width;
+  UINT height;
+  std::vector<uint8_t> pixels;
+};
+// Icons are decoded once at startup and packed into a single atlas that's
+// kept in memory, so that the device bitmap can be recreated without going
+// through WIC again. All icons being in one bitmap also lets D2D batch
+// consecutive icon draws (e.g. the expander for every row of a TreeGrid)
+// rather than switching textures for each.
+static IconPixels g_icon_atlas_pixels;
+static D2D1_RECT_F g_icon_source_rects[static_cast<int>(Icon::Count)];
+static ID2D1Bitmap* g_icon_atlas;
+// Solid brushes are cached by color quantized to 8 bits per channel. Animated
+// colors (e.g. the TextEdit cursor blink, or the scrollbar fade) would
+// otherwise create a new brush for every distinct float value drawn. The cache
+// is also capped, evicting the least recently used brush, so that memory stays
+// flat no matter how many colors are drawn over a session. Entries and the
+// open-addressed index over them are fixed arrays, so a miss only allocates
+// the brush itself. Evicted brushes may still be referenced by D2D or by text
+// layouts, which hold their own references.
+class SolidBrushCache {
+ public:
+  SolidBrushCache() : size_(0) { Clear(); }
+  ~SolidBrushCache() { Clear(); }
+
+  ID2D1SolidColorBrush* Get(const Color& color) {
+    uint32_t key = QuantizeColor(color);
+    int slot = FindSlot(key);
+    if (slots_[slot] != kEmpty) {
+      int entry = slots_[slot];
+      Unlink(entry);
+      PushFront(entry);
+      return entries_[entry].brush;
+    }
+
+    ID2D1SolidColorBrush* brush;
+    CHECK(SUCCEEDED(g_render_target->CreateSolidColorBrush(
+        D2D1::ColorF(((key >> 24) & 0xff) / 255.f,
+                     ((key >> 16) & 0xff) / 255.f,
+                     ((key >> 8) & 0xff) / 255.f,
+                     (key & 0xff) / 255.f),
+        &brush)));
+
+    int entry;
+    if (size_ < kCapacity) {
+      entry = size_++;
+    } else {
+      // Reuse the least recently used entry.
+      entry = tail_;
+      Unlink(entry);
+      RemoveSlot(FindSlot(entries_[entry].key));
+      entries_[entry].brush->Release();
+      // Removing may have moved other keys, including into |slot|.
+      slot = FindSlot(key);
+    }
+    entries_[entry].key = key;
+    entries_[entry].brush = brush;
+    PushFront(entry);
+    slots_[slot] = static_cast<int16_t>(entry);
+    return brush;
+  }
+
+  void Clear() {
+    for (int i = 0; i < size_; ++i)
+      entries_[i].brush->Release();
+    size_ = 0;
+    head_ = kEmpty;
+    tail_ = kEmpty;
+    for (int i = 0; i < kNumSlots; ++i)
+      slots_[i] = kEmpty;
+  }
+
+ private:
+  static const int kCapacity = 256;
+  // Twice the capacity, so that probe sequences stay short.
+  static const int kNumSlots = 512;
+  static const int kEmpty = -1;
+  static_assert(kNumSlots == 1 << 9, "HomeSlot() takes 9 bits");
+
+  // A node in the recency list, which is kept as indices into |entries_|.
+  struct Entry {
+    uint32_t key;
+    ID2D1SolidColorBrush* brush;
+    int prev;
+    int next;
+  };
+
+  static uint32_t QuantizeChannel(float value) {
+    value = std::max(0.f, std::min(value, 1.f));
+    return static_cast<uint32_t>(value * 255.f + 0.5f);
+  }
+
+  static uint32_t QuantizeColor(const Color& color) {
+    return (QuantizeChannel(color.r) << 24) | (QuantizeChannel(color.g) << 16) |
+           (QuantizeChannel(color.b) << 8) | QuantizeChannel(color.a);
+  }
+
+  static int HomeSlot(uint32_t key) {
+    // Fibonacci hashing, taking the top 9 bits.
+    return static_cast<int>((key * 2654435769u) >> (32 - 9));
+  }
+
+  // Returns the slot holding |key|, or the empty slot where it would go.
+  int FindSlot(uint32_t key) const {
+    int slot = HomeSlot(key);
+    while (slots_[slot] != kEmpty && entries_[slots_[slot]].key != key)
+      slot = (slot + 1) & (kNumSlots - 1);
+    return slot;
+  }
+
+  // Empties |slot|, moving later keys in its probe run back so that they can
+  // still be found without tombstones.
+  void RemoveSlot(int slot) {
+    int hole = slot;
+    slots_[hole] = kEmpty;
+    for (int i = (hole + 1) & (kNumSlots - 1); slots_[i] != kEmpty;
+         i = (i + 1) & (kNumSlots - 1)) {
+      int home = HomeSlot(entries_[slots_[i]].key);
+      // The key at |i| can move to |hole| unless its home is cyclically in
+      // (hole, i].
+      bool home_after_hole = hole <= i ? (home > hole && home <= i)
+                                       : (home > hole || home <= i);
+      if (!home_after_hole) {
+        slots_[hole] = slots_[i];
+        slots_[i] = kEmpty;
+        hole = i;
+      }
+    }
+  }
+
+  void Unlink(int entry) {
+    Entry& e = entries_[entry];
+    if (e.prev != kEmpty)
+      entries_[e.prev].next = e.next;
+    else
+      head_ = e.next;
+    if (e.next != kEmpty)
+      entries_[e.next].prev = e.prev;
+    else
+      tail_ = e.prev;
+  }
+
+  void PushFront(int entry) {
+    entries_[entry].prev = kEmpty;
+    entries_[entry].next = head_;
+    if (head_ != kEmpty)
+      entries_[head_].prev = entry;
+    else
+      tail_ = entry;
+    head_ = entry;
   }
+
+  Entry entries_[kCapacity];
+  int size_;
+  // Most and least recently used entries.
+  int head_;
+  int tail_;
+  // Indices into |entries_|, or kEmpty.
+  int16_t slots_[kNumSlots];
+
+  DISALLOW_COPY_AND_ASSIGN(SolidBrushCache);
+};
+
+static SolidBrushCache g_brush_cache;
+
+struct GfxLayer {
+  GfxLayer()
+      : target(nullptr),
+        previous_target(nullptr),
+        width(0.f),
+        height(0.f),
+        contents_valid(false) {}
+
+  // Created lazily at the size the layer is first drawn into.
+  ID2D1BitmapRenderTarget* target;
+  // The target to restore when a ScopedRenderIntoLayer ends.
+  ID2D1RenderTarget* previous_target;
+  float width;
+  float height;
+  // Cleared when the target is (re)created or lost, until it's next drawn.
+  bool contents_valid;
 };
-static std::unordered_map<Color, ID2D1SolidColorBrush*, ColorHash>
-    g_brush_for_color;
+
+// All live layers, so that their targets can be dropped with the device.
+static std::vector<GfxLayer*> g_layers;
+
+// Offsets and clips for |g_current_target|. The device transform is always a
+// translation by the top offset.
+static RenderStack g_render_stack;
+
+void ApplyRenderOffset() {
+  g_current_target->SetTransform(D2D1::Matrix3x2F::Translation(
+      g_render_stack.offset_x(), g_render_stack.offset_y()));
+}
 
 ID2D1SolidColorBrush* SolidBrushForColor(const Color& color) {
-  auto it = g_brush_for_color.find(color);
-  if (it != g_brush_for_color.end())
-    return it->second;
-  ID2D1SolidColorBrush* brush;
-  CHECK(SUCCEEDED(g_render_target->CreateSolidColorBrush(
-      D2D1::ColorF(color.r, color.g, color.b, color.a), &brush)));
-  g_brush_for_color[color] = brush;
-  return brush;
+  return g_brush_cache.Get(color);
 }
 
 D2D1_COLOR_F ColorToD2DColorF(const Color& color) {
@@ -91,7 +279,8 @@ static void SafeRelease(T** ppT) {
   }
 }
 
-ID2D1Bitmap* LoadBitmapFromResource(int res) {
+// Decodes the PNG resource |res| to premultiplied BGRA in |into|.
+void DecodeIconFromResource(int res, IconPixels* into) {
   HINSTANCE self_hinst = reinterpret_cast<HINSTANCE>(&__ImageBase);
   HRSRC image_res_handle =
       FindResource(self_hinst, MAKEINTRESOURCE(res), "IMAGE");
@@ -124,15 +313,87 @@ ID2D1Bitmap* LoadBitmapFromResource(int res) {
                                         0.f,
                                         WICBitmapPaletteTypeMedianCut)));
 
-  ID2D1Bitmap* bitmap;
-  CHECK(SUCCEEDED(
-      g_render_target->CreateBitmapFromWicBitmap(converter, nullptr, &bitmap)));
+  CHECK(SUCCEEDED(converter->GetSize(&into->width, &into->height)));
+  UINT stride = into->width * 4;
+  into->pixels.resize(stride * into->height);
+  CHECK(SUCCEEDED(converter->CopyPixels(nullptr,
+                                        stride,
+                                        static_cast<UINT>(into->pixels.size()),
+                                        into->pixels.data())));
 
   SafeRelease(&decoder);
   SafeRelease(&source);
   SafeRelease(&stream);
   SafeRelease(&converter);
+}
+
+void DecodeIcons() {
+  const int kIconResources[] = {
+      RES_DOCK_LEFT,
+      RES_DOCK_RIGHT,
+      RES_DOCK_TOP,
+      RES_DOCK_BOTTOM,
+      RES_TREE_COLLAPSED,
+      RES_TREE_EXPANDED,
+      RES_INDICATOR_PC,
+      RES_INDICATOR_BREAKPOINT,
+  };
+  const int kNumIcons = static_cast<int>(Icon::Count);
+  static_assert(ARRAYSIZE(kIconResources) == kNumIcons,
+                "resource for each Icon");
+  IconPixels icons[kNumIcons];
+  int order[kNumIcons];
+  for (int i = 0; i < kNumIcons; ++i) {
+    DecodeIconFromResource(kIconResources[i], &icons[i]);
+    order[i] = i;
+  }
+
+  // Tallest first packs shelves more tightly.
+  std::sort(order, order + kNumIcons, [&icons](int a, int b) {
+    return icons[a].height > icons[b].height;
+  });
+  const int kAtlasWidth = 256;
+  AtlasPacker packer(kAtlasWidth, 1);
+  int x[kNumIcons];
+  int y[kNumIcons];
+  for (int i : order) {
+    CHECK(packer.Place(static_cast<int>(icons[i].width),
+                       static_cast<int>(icons[i].height),
+                       &x[i],
+                       &y[i]),
+          "icon too wide for atlas");
+  }
+
+  IconPixels& atlas = g_icon_atlas_pixels;
+  atlas.width = kAtlasWidth;
+  atlas.height = packer.height();
+  atlas.pixels.assign(atlas.width * atlas.height * 4, 0);
+  for (int i = 0; i < kNumIcons; ++i) {
+    for (UINT row = 0; row < icons[i].height; ++row) {
+      memcpy(&atlas.pixels[((y[i] + row) * atlas.width + x[i]) * 4],
+             &icons[i].pixels[row * icons[i].width * 4],
+             icons[i].width * 4);
+    }
+    g_icon_source_rects[i] =
+        D2D1::RectF(static_cast<float>(x[i]),
+                    static_cast<float>(y[i]),
+                    static_cast<float>(x[i] + icons[i].width),
+                    static_cast<float>(y[i] + icons[i].height));
+  }
+}
 
+// Creating a bitmap from already decoded pixels is just an upload, so this
+// is cheap enough to do whenever the device is recreated.
+ID2D1Bitmap* CreateBitmapFromPixels(const IconPixels& image) {
+  ID2D1Bitmap* bitmap;
+  CHECK(SUCCEEDED(g_render_target->CreateBitmap(
+            D2D1::SizeU(image.width, image.height),
+            image.pixels.data(),
+            image.width * 4,
+            D2D1::BitmapProperties(D2D1::PixelFormat(
+                DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)),
+            &bitmap)),
+        "CreateBitmap");
   return bitmap;
 }
 
@@ -182,13 +443,6 @@ void WinGfxCreateDeviceIndependentResources() {
                                          &g_text_format_title)));
   g_text_format_title->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
   g_text_format_title->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
-}
-
-void CreateDeviceResources() {
-  RECT rc;
-  GetClientRect(g_hwnd, &rc);
-
-  D2D1_SIZE_U size = D2D1::SizeU(rc.right - rc.left, rc.bottom - rc.top);
 
   CHECK(SUCCEEDED(CoInitialize(nullptr)));
   CHECK(SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory,
@@ -196,6 +450,14 @@ void CreateDeviceResources() {
                                    CLSCTX_INPROC_SERVER,
                                    IID_IWICImagingFactory,
                                    reinterpret_cast<void**>(&g_wic_factory))));
+  DecodeIcons();
+}
+
+void CreateDeviceResources() {
+  RECT rc;
+  GetClientRect(g_hwnd, &rc);
+
+  D2D1_SIZE_U size = D2D1::SizeU(rc.right - rc.left, rc.bottom - rc.top);
 
   if (FAILED(g_direct2d_factory->CreateHwndRenderTarget(
           D2D1::RenderTargetProperties(),
@@ -203,6 +465,7 @@ void CreateDeviceResources() {
               g_hwnd, size, D2D1_PRESENT_OPTIONS_NONE),
           &g_render_target)))
     return;
+  g_current_target = g_render_target;
 
   const Skin& sk = Skin::current();
   const ColorScheme& cs = sk.GetColorScheme();
@@ -247,31 +510,27 @@ void CreateDeviceResources() {
       "CreateLinearGradientBrush inactive");
   SafeRelease(&gradient_stop_collection);
 
-  g_icons[+Icon::kDockLeft] = LoadBitmapFromResource(RES_DOCK_LEFT);
-  g_icons[+Icon::kDockRight] = LoadBitmapFromResource(RES_DOCK_RIGHT);
-  g_icons[+Icon::kDockTop] = LoadBitmapFromResource(RES_DOCK_TOP);
-  g_icons[+Icon::kDockBottom] = LoadBitmapFromResource(RES_DOCK_BOTTOM);
-  g_icons[+Icon::kTreeCollapsed] = LoadBitmapFromResource(RES_TREE_COLLAPSED);
-  g_icons[+Icon::kTreeExpanded] = LoadBitmapFromResource(RES_TREE_EXPANDED);
-  g_icons[+Icon::kIndicatorPC] = LoadBitmapFromResource(RES_INDICATOR_PC);
-  g_icons[+Icon::kIndicatorBreakpoint] =
-      LoadBitmapFromResource(RES_INDICATOR_BREAKPOINT);
+  g_icon_atlas = CreateBitmapFromPixels(g_icon_atlas_pixels);
 }
 
 void DiscardDeviceResources() {
+  for (auto* layer : g_layers) {
+    SafeRelease(&layer->target);
+    layer->contents_valid = false;
+  }
+  g_current_target = nullptr;
   SafeRelease(&g_render_target);
   SafeRelease(&g_title_bar_active_gradient_brush);
   SafeRelease(&g_title_bar_inactive_gradient_brush);
 
-  for (auto& brush : g_brush_for_color)
-    SafeRelease(&brush.second);
-  g_brush_for_color.clear();
+  g_brush_cache.Clear();
 
-  for (auto& icon : g_icons)
-    SafeRelease(&icon);
+  SafeRelease(&g_icon_atlas);
 }
 
 void BeginFrame() {
+  D2D1_SIZE_F size = g_render_target->GetSize();
+  g_render_stack.PushRoot(size.width, size.height);
   g_render_target->BeginDraw();
   g_render_target->SetTransform(D2D1::Matrix3x2F::Identity());
   g_render_target->Clear(D2D1::ColorF(D2D1::ColorF::DarkSlateGray));
@@ -285,30 +544,48 @@ void GfxInit() {
 void GfxResize(uint32_t width, uint32_t height) {
   g_width = width;
   g_height = height;
-  if (g_render_target) {
-    DiscardDeviceResources();
-    CreateDeviceResources();
-  }
+  if (!g_render_target)
+    return;
+  // Resizing the target keeps the device, so brushes, icons and layers all
+  // survive a live resize. If the device was lost, Resize() fails and it's
+  // handled when the frame ends.
+  g_render_target->Resize(D2D1::SizeU(width, height));
+  // Re-root the frame in progress at the new size.
+  DCHECK(g_render_stack.depth() == 1, "resize during drawing");
+  g_render_stack.Pop();
+  D2D1_SIZE_F size = g_render_target->GetSize();
+  g_render_stack.PushRoot(size.width, size.height);
 }
 
-void GfxFrame() {
-  HRESULT hr = g_render_target->EndDraw();
-  if (hr == D2DERR_RECREATE_TARGET)
-    DiscardDeviceResources();
+bool GfxFrame() {
+  bool recreated = false;
+  if (g_render_target) {
+    DCHECK(g_render_stack.depth() == 1, "unbalanced ScopedRenderOffset");
+    g_render_stack.Pop();
+    // Device resources are only ever recreated here, when the device has
+    // actually been lost.
+    HRESULT hr = g_render_target->EndDraw();
+    if (hr == D2DERR_RECREATE_TARGET) {
+      DiscardDeviceResources();
+      recreated = true;
+    }
+  }
 
   if (!g_render_target)
     CreateDeviceResources();
 
   if (!g_render_target) {
     // If still failed, can't continue.
-    return;
+    return recreated;
   }
 
   BeginFrame();
+  return recreated;
 }
 
 void GfxShutdown() {
   DiscardDeviceResources();
+  SafeRelease(&g_wic_factory);
   SafeRelease(&g_direct2d_factory);
   SafeRelease(&g_dwrite_factory);
   SafeRelease(&g_text_format_mono);
@@ -330,16 +607,31 @@ IDWriteTextFormat* TextFormatForFont(Font font) {
   }
 }
 
-std::wstring UTF8ToUTF16(StringPiece utf8) {
-  int wide_len =
-      MultiByteToWideChar(CP_UTF8, 0, utf8.data(), utf8.size(), nullptr, 0);
-  wchar_t* wide =
-      reinterpret_cast<wchar_t*>(_alloca(sizeof(wchar_t) * wide_len));
-  if (MultiByteToWideChar(
-          CP_UTF8, 0, utf8.data(), utf8.size(), wide, wide_len) != wide_len) {
-    return std::wstring();
-  }
-  return std::wstring(wide, wide_len);
+// Text isn't measured before drawing, so it's treated as extending from its
+// origin to the right and down without bound.
+Rect TextExtentFrom(float x, float y) {
+  return Rect(x,
+              y,
+              std::numeric_limits<float>::max(),
+              std::numeric_limits<float>::max());
+}
+
+// Lines are one unit wide and centered on their endpoints.
+Rect LineBounds(float x0, float y0, float x1, float y1) {
+  return Rect(std::min(x0, x1) - 0.5f,
+              std::min(y0, y1) - 0.5f,
+              fabsf(x1 - x0) + 1.f,
+              fabsf(y1 - y0) + 1.f);
+}
+
+// The result is in a per-thread scratch buffer (see UTF8ToUTF16Scratch) that's
+// only valid until the next conversion on this thread.
+const wchar_t* UTF8ToUTF16(StringPiece utf8, UINT32* length) {
+  static_assert(sizeof(wchar_t) == sizeof(uint16_t), "expecting UTF-16");
+  size_t wide_length;
+  const uint16_t* wide = UTF8ToUTF16Scratch(utf8, &wide_length);
+  *length = static_cast<UINT32>(wide_length);
+  return reinterpret_cast<const wchar_t*>(wide);
 }
 
 void GfxText(Font font,
@@ -347,28 +639,42 @@ void GfxText(Font font,
              float x,
              float y,
              StringPiece string) {
-  std::wstring wide = UTF8ToUTF16(string);
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddText(font, color, x, y, string);
+    return;
+  }
+  if (!g_render_stack.IsVisible(TextExtentFrom(x, y)))
+    return;
+  UINT32 wide_length;
+  const wchar_t* wide = UTF8ToUTF16(string, &wide_length);
   D2D1_RECT_F layout_rect = D2D1::RectF(
       x, y, static_cast<float>(g_width), static_cast<float>(g_height));
-  g_render_target->DrawTextA(&wide[0],
-                             wide.size(),
-                             TextFormatForFont(font),
-                             layout_rect,
-                             SolidBrushForColor(color));
+  g_current_target->DrawTextA(wide,
+                              wide_length,
+                              TextFormatForFont(font),
+                              layout_rect,
+                              SolidBrushForColor(color));
 }
 
 void GfxText(Font font,
              const Color& color,
              const Rect& rect,
              const char* string) {
-  std::wstring wide = UTF8ToUTF16(string);
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddTextInRect(font, color, rect, string);
+    return;
+  }
+  if (!g_render_stack.IsVisible(rect))
+    return;
+  UINT32 wide_length;
+  const wchar_t* wide = UTF8ToUTF16(string, &wide_length);
   D2D1_RECT_F layout_rect =
       D2D1::RectF(rect.x, rect.y, rect.x + rect.w, rect.x + rect.h);
-  g_render_target->DrawTextA(&wide[0],
-                             wide.size(),
-                             TextFormatForFont(font),
-                             layout_rect,
-                             SolidBrushForColor(color));
+  g_current_target->DrawTextA(wide,
+                              wide_length,
+                              TextFormatForFont(font),
+                              layout_rect,
+                              SolidBrushForColor(color));
 }
 
 void GfxColoredText(Font font,
@@ -377,11 +683,18 @@ void GfxColoredText(Font font,
                     float y,
                     StringPiece str,
                     const std::vector<RangeAndColor> colors) {
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddColoredText(font, default_color, x, y, str, colors);
+    return;
+  }
+  if (!g_render_stack.IsVisible(TextExtentFrom(x, y)))
+    return;
   IDWriteTextLayout* layout;
-  std::wstring wide = UTF8ToUTF16(str);
+  UINT32 wide_length;
+  const wchar_t* wide = UTF8ToUTF16(str, &wide_length);
   CHECK(SUCCEEDED(
-      g_dwrite_factory->CreateTextLayout(&wide[0],
-                                         wide.size(),
+      g_dwrite_factory->CreateTextLayout(wide,
+                                         wide_length,
                                          TextFormatForFont(font),
                                          std::numeric_limits<float>::max(),
                                          std::numeric_limits<float>::max(),
@@ -391,31 +704,42 @@ void GfxColoredText(Font font,
     layout->SetDrawingEffect(SolidBrushForColor(rac.color), range);
   }
 
-  g_render_target->DrawTextLayout(
+  g_current_target->DrawTextLayout(
       D2D1::Point2F(x, y), layout, SolidBrushForColor(default_color));
 
   layout->Release();
 }
 
 void GfxDrawIcon(Icon icon, const Rect& rect, float alpha) {
-  g_render_target->DrawBitmap(
-      g_icons[+icon],
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddIcon(icon, rect, alpha);
+    return;
+  }
+  if (!g_render_stack.IsVisible(rect))
+    return;
+  g_current_target->DrawBitmap(
+      g_icon_atlas,
       D2D1::RectF(rect.x, rect.y, rect.x + rect.w, rect.y + rect.h),
-      alpha);
+      alpha,
+      D2D1_BITMAP_INTERPOLATION_MODE_LINEAR,
+      &g_icon_source_rects[+icon]);
 }
 
 void GfxIconSize(Icon icon, float* width, float* height) {
-  D2D1_SIZE_F size = g_icons[+icon]->GetSize();
-  *width = size.width;
-  *height = size.height;
+  // The atlas is 96 DPI, so pixels are DIPs. This doesn't need the device, so
+  // it's safe while recording.
+  const D2D1_RECT_F& source = g_icon_source_rects[+icon];
+  *width = source.right - source.left;
+  *height = source.bottom - source.top;
 }
 
 TextMeasurements GfxMeasureText(Font font, StringPiece str) {
   IDWriteTextLayout* layout;
-  std::wstring wide = UTF8ToUTF16(str);
+  UINT32 wide_length;
+  const wchar_t* wide = UTF8ToUTF16(str, &wide_length);
   CHECK(SUCCEEDED(
-      g_dwrite_factory->CreateTextLayout(&wide[0],
-                                         wide.size(),
+      g_dwrite_factory->CreateTextLayout(wide,
+                                         wide_length,
                                          TextFormatForFont(font),
                                          std::numeric_limits<float>::max(),
                                          std::numeric_limits<float>::max(),
@@ -480,6 +804,36 @@ void GfxDrawFps() {
            static_cast<double>(max) * to_ms,
            freq / frame_time);
   GfxText(Font::kMono, Color(0.f, 0.65f, 0.f, 0.375f), 10, 16 * pos++, buf);
+
+  const LockContention* contention = GetLockContention();
+  snprintf(buf,
+           sizeof(buf),
+           "Locks: %lld contended, %lld parked",
+           static_cast<long long>(  // NOLINT(runtime/int)
+               contention->contended.load(std::memory_order_relaxed)),
+           static_cast<long long>(  // NOLINT(runtime/int)
+               contention->parked.load(std::memory_order_relaxed)));
+  GfxText(Font::kMono, Color(0.f, 0.65f, 0.f, 0.375f), 10, 16 * pos++, buf);
+
+  const LatencySamples& queue = GetInputLatency(LatencyStage::Queue);
+  if (queue.count() == 0)
+    return;
+  const LatencySamples& render = GetInputLatency(LatencyStage::Render);
+  const LatencySamples& present = GetInputLatency(LatencyStage::Present);
+  const LatencySamples& total = GetInputLatency(LatencyStage::Total);
+  snprintf(buf,
+           sizeof(buf),
+           "Input p50/p95: queue %.1f/%.1f, render %.1f/%.1f, "
+           "present %.1f/%.1f, total %.1f/%.1f [ms]",
+           queue.Percentile(0.5) * to_ms,
+           queue.Percentile(0.95) * to_ms,
+           render.Percentile(0.5) * to_ms,
+           render.Percentile(0.95) * to_ms,
+           present.Percentile(0.5) * to_ms,
+           present.Percentile(0.95) * to_ms,
+           total.Percentile(0.5) * to_ms,
+           total.Percentile(0.95) * to_ms);
+  GfxText(Font::kMono, Color(0.f, 0.65f, 0.f, 0.375f), 10, 16 * pos++, buf);
 }
 
 float GetDpiScale() {
@@ -487,13 +841,25 @@ float GetDpiScale() {
 }
 
 void DrawSolidRect(const Rect& rect, const Color& color) {
-  g_render_target->FillRectangle(
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddSolidRect(rect, color);
+    return;
+  }
+  if (!g_render_stack.IsVisible(rect))
+    return;
+  g_current_target->FillRectangle(
       D2D1::RectF(rect.x, rect.y, rect.x + rect.w, rect.y + rect.h),
       SolidBrushForColor(color));
 }
 
 void DrawSolidRoundedRect(const Rect& rect, const Color& color, float radius) {
-  g_render_target->FillRoundedRectangle(
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddSolidRoundedRect(rect, color, radius);
+    return;
+  }
+  if (!g_render_stack.IsVisible(rect))
+    return;
+  g_current_target->FillRoundedRectangle(
       D2D1::RoundedRect(
           D2D1::RectF(rect.x, rect.y, rect.x + rect.w, rect.y + rect.h),
           radius,
@@ -505,7 +871,13 @@ void DrawOutlineRoundedRect(const Rect& rect,
                             const Color& color,
                             float radius,
                             float width) {
-  g_render_target->DrawRoundedRectangle(
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddOutlineRoundedRect(rect, color, radius, width);
+    return;
+  }
+  if (!g_render_stack.IsVisible(rect.Expand(Rect(width, width, width, width))))
+    return;
+  g_current_target->DrawRoundedRectangle(
       D2D1::RoundedRect(
           D2D1::RectF(rect.x, rect.y, rect.x + rect.w, rect.y + rect.h),
           radius,
@@ -515,12 +887,24 @@ void DrawOutlineRoundedRect(const Rect& rect,
 }
 
 void DrawVerticalLine(const Color& color, float x, float y0, float y1) {
-  g_render_target->DrawLine(
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddVerticalLine(color, x, y0, y1);
+    return;
+  }
+  if (!g_render_stack.IsVisible(LineBounds(x, y0, x, y1)))
+    return;
+  g_current_target->DrawLine(
       D2D1::Point2F(x, y0), D2D1::Point2F(x, y1), SolidBrushForColor(color));
 }
 
 void DrawHorizontalLine(const Color& color, float x0, float x1, float y) {
-  g_render_target->DrawLine(
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddHorizontalLine(color, x0, x1, y);
+    return;
+  }
+  if (!g_render_stack.IsVisible(LineBounds(x0, y, x1, y)))
+    return;
+  g_current_target->DrawLine(
       D2D1::Point2F(x0, y), D2D1::Point2F(x1, y), SolidBrushForColor(color));
 }
 
@@ -529,6 +913,8 @@ void DrawTextInRect(Font font,
                     StringPiece str,
                     const Color& color,
                     float x_padding) {
+  if (!DisplayList::Current() && !g_render_stack.IsVisible(rect))
+    return;
   ScopedRenderOffset offset(rect, true);
   GfxText(font, color, x_padding, 0.f, str);
 }
@@ -539,6 +925,12 @@ void DrawWindow(const char* title,
                 float y,
                 float w,
                 float h) {
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddWindow(title, active, Rect(x, y, w, h));
+    return;
+  }
+  if (!g_render_stack.IsVisible(Rect(x, y, w, h)))
+    return;
   const Skin& sk = Skin::current();
   const ColorScheme& cs = sk.GetColorScheme();
   const float kCornerRadius = 3.f;
@@ -551,13 +943,13 @@ void DrawWindow(const char* title,
   // Drop shadow maybe.
 
   // Header.
-  g_render_target->FillRoundedRectangle(
+  g_current_target->FillRoundedRectangle(
       D2D1::RoundedRect(D2D1::RectF(x, y, x + w, y + sk.title_bar_size()),
                         kCornerRadius - 1,
                         kCornerRadius - 1),
       active ? g_title_bar_active_gradient_brush
              : g_title_bar_inactive_gradient_brush);
-  g_render_target->DrawLine(
+  g_current_target->DrawLine(
       D2D1::Point2F(x + 0.5f, y + sk.title_bar_size() - 1),
       D2D1::Point2F(x + 0.5f + w - 1, y + sk.title_bar_size() - 1),
       SolidBrushForColor(cs.border()));
@@ -574,31 +966,124 @@ void DrawWindow(const char* title,
           title);
 }
 
-class ScopedRenderOffset::Data {
- public:
-  Data() { g_render_target->GetTransform(&transform_); }
-  ~Data() { g_render_target->SetTransform(transform_); }
+GfxLayer* GfxCreateLayer() {
+  GfxLayer* layer = new GfxLayer;
+  g_layers.push_back(layer);
+  return layer;
+}
 
-  D2D1_MATRIX_3X2_F transform_;
-};
+void GfxDestroyLayer(GfxLayer* layer) {
+  if (!layer)
+    return;
+  g_layers.erase(std::find(g_layers.begin(), g_layers.end(), layer));
+  SafeRelease(&layer->target);
+  delete layer;
+}
+
+bool GfxLayerNeedsRepaint(GfxLayer* layer, float width, float height) {
+  return !layer->contents_valid || layer->width != width ||
+         layer->height != height;
+}
+
+void GfxDrawLayer(GfxLayer* layer, const Rect& rect, float alpha) {
+  if (DisplayList* list = DisplayList::Current()) {
+    list->AddLayer(layer, rect, alpha);
+    return;
+  }
+  if (!g_render_stack.IsVisible(rect))
+    return;
+  if (!layer->target || !layer->contents_valid)
+    return;
+  ID2D1Bitmap* bitmap;
+  CHECK(SUCCEEDED(layer->target->GetBitmap(&bitmap)), "GetBitmap");
+  // Linear filtering, as drag previews are drawn scaled.
+  g_current_target->DrawBitmap(
+      bitmap,
+      D2D1::RectF(rect.x, rect.y, rect.x + rect.w, rect.y + rect.h),
+      alpha,
+      D2D1_BITMAP_INTERPOLATION_MODE_LINEAR);
+  bitmap->Release();
+}
+
+ScopedRenderIntoLayer::ScopedRenderIntoLayer(GfxLayer* layer,
+                                             float width,
+                                             float height)
+    : layer_(layer), recorded_(false) {
+  if (DisplayList* list = DisplayList::Current()) {
+    list->BeginLayer(layer, width, height);
+    recorded_ = true;
+    return;
+  }
+  DCHECK(layer->target != g_current_target, "layer drawn into itself");
+  if (!layer->target || layer->width != width || layer->height != height) {
+    SafeRelease(&layer->target);
+    CHECK(SUCCEEDED(g_render_target->CreateCompatibleRenderTarget(
+              D2D1::SizeF(std::max(width, 1.f), std::max(height, 1.f)),
+              &layer->target)),
+          "CreateCompatibleRenderTarget");
+    // The layer is transparent where nothing is drawn, and ClearType can't be
+    // used without an opaque background.
+    layer->target->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+    layer->width = width;
+    layer->height = height;
+  }
+  layer->previous_target = g_current_target;
+  g_current_target = layer->target;
+  g_render_stack.PushRoot(width, height);
+  layer->target->BeginDraw();
+  layer->target->SetTransform(D2D1::Matrix3x2F::Identity());
+  layer->target->Clear(D2D1::ColorF(0.f, 0.f, 0.f, 0.f));
+}
+
+ScopedRenderIntoLayer::~ScopedRenderIntoLayer() {
+  if (recorded_) {
+    DisplayList::Current()->EndLayer();
+    return;
+  }
+  layer_->contents_valid = SUCCEEDED(layer_->target->EndDraw());
+  g_render_stack.Pop();
+  g_current_target = layer_->previous_target;
+  layer_->previous_target = nullptr;
+}
 
 ScopedRenderOffset::ScopedRenderOffset(const Rect& rect, bool scissor)
-    : data_(new Data), scissor_(scissor) {
-  g_render_target->SetTransform(data_->transform_ *
-                                D2D1::Matrix3x2F::Translation(rect.x, rect.y));
+    : scissor_(scissor), recorded_(false) {
+  if (DisplayList* list = DisplayList::Current()) {
+    list->PushOffset(rect, scissor);
+    recorded_ = true;
+    return;
+  }
+  g_render_stack.Push(rect, scissor);
+  ApplyRenderOffset();
   if (scissor) {
-    g_render_target->PushAxisAlignedClip(D2D1::RectF(0, 0, rect.w, rect.h),
-                                         D2D1_ANTIALIAS_MODE_ALIASED);
+    // The stack's clip is already intersected with the enclosing ones, and
+    // is in root coordinates.
+    const Rect& clip = g_render_stack.clip();
+    float x = clip.x - g_render_stack.offset_x();
+    float y = clip.y - g_render_stack.offset_y();
+    g_current_target->PushAxisAlignedClip(
+        D2D1::RectF(x, y, x + clip.w, y + clip.h), D2D1_ANTIALIAS_MODE_ALIASED);
   }
 }
 
 ScopedRenderOffset::ScopedRenderOffset(float dx, float dy)
-    : data_(new Data), scissor_(false) {
-  g_render_target->SetTransform(data_->transform_ *
-                                D2D1::Matrix3x2F::Translation(dx, dy));
+    : scissor_(false), recorded_(false) {
+  if (DisplayList* list = DisplayList::Current()) {
+    list->PushOffset(Rect(dx, dy, 0.f, 0.f), false);
+    recorded_ = true;
+    return;
+  }
+  g_render_stack.Push(Rect(dx, dy, 0.f, 0.f), false);
+  ApplyRenderOffset();
 }
 
 ScopedRenderOffset::~ScopedRenderOffset() {
+  if (recorded_) {
+    DisplayList::Current()->PopOffset();
+    return;
+  }
   if (scissor_)
-    g_render_target->PopAxisAlignedClip();
+    g_current_target->PopAxisAlignedClip();
+  g_render_stack.Pop();
+  ApplyRenderOffset();
 }
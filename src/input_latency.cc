@@ -0,0 +1,92 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "input_latency.h"
+
+#include <algorithm>
+
+namespace {
+
+LatencySamples g_latency[LatencyStage::Count];
+
+// The oldest event dispatched since the last frame, if any.
+bool g_has_input;
+int64_t g_event_time;
+int64_t g_dispatch_time;
+int64_t g_rendered_time;
+
+void TracePercentiles() {
+  static const char* const kNames[LatencyStage::Count] = {
+      "queue", "render", "present", "total",
+  };
+  double to_ms = 1000.0 / static_cast<double>(GetHPFrequency());
+  UNUSED(kNames);
+  UNUSED(to_ms);
+  for (int i = 0; i < LatencyStage::Count; ++i) {
+    TRACE("input latency %-7s p50 %7.3f p95 %7.3f p99 %7.3f [ms]",
+          kNames[i],
+          g_latency[i].Percentile(0.5) * to_ms,
+          g_latency[i].Percentile(0.95) * to_ms,
+          g_latency[i].Percentile(0.99) * to_ms);
+  }
+}
+
+}  // namespace
+
+const int LatencySamples::kCapacity;
+
+LatencySamples::LatencySamples() : next_(0), count_(0) {
+}
+
+void LatencySamples::Add(int64_t ticks) {
+  samples_[next_] = ticks;
+  next_ = (next_ + 1) % kCapacity;
+  count_ = std::min(count_ + 1, kCapacity);
+}
+
+int64_t LatencySamples::Percentile(double fraction) const {
+  if (count_ == 0)
+    return 0;
+  int64_t sorted[kCapacity];
+  std::copy(samples_, samples_ + count_, sorted);
+  int index = std::min(static_cast<int>(fraction * count_), count_ - 1);
+  std::nth_element(sorted, sorted + index, sorted + count_);
+  return sorted[index];
+}
+
+void NoteInputDispatched(int64_t event_time, int64_t dispatch_time) {
+  if (g_has_input && g_event_time <= event_time)
+    return;
+  g_has_input = true;
+  g_event_time = event_time;
+  g_dispatch_time = dispatch_time;
+}
+
+void NoteFrameSkipped() {
+  g_has_input = false;
+}
+
+void NoteFrameRendered(int64_t time) {
+  g_rendered_time = time;
+}
+
+void NoteFramePresented(int64_t time) {
+  if (!g_has_input)
+    return;
+  g_has_input = false;
+  g_latency[LatencyStage::Queue].Add(g_dispatch_time - g_event_time);
+  g_latency[LatencyStage::Render].Add(g_rendered_time - g_dispatch_time);
+  g_latency[LatencyStage::Present].Add(time - g_rendered_time);
+  g_latency[LatencyStage::Total].Add(time - g_event_time);
+
+  static int frames_since_trace;
+  if (++frames_since_trace == LatencySamples::kCapacity) {
+    frames_since_trace = 0;
+    TracePercentiles();
+  }
+}
+
+const LatencySamples& GetInputLatency(LatencyStage::Enum stage) {
+  return g_latency[stage];
+}
@@ -0,0 +1,65 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef INPUT_LATENCY_H_
+#define INPUT_LATENCY_H_
+
+#include "core.h"
+
+// Measures how long input takes to reach the screen. Each event is stamped
+// with GetHPCounter() when the window thread posts it, and for each frame
+// that's rendered in response to input, the oldest event's latency is split
+// into:
+//
+//   Queue:   posted -> dispatched by ProcessEvents(). Long if the main loop
+//            was busy or asleep.
+//   Render:  dispatched -> the frame's rendering is finished. Widget work.
+//   Present: rendered -> presented, including waiting for vsync.
+//
+// All of this is main thread only.
+
+struct LatencyStage {
+  enum Enum {
+    Queue,
+    Render,
+    Present,
+    Total,
+    Count,
+  };
+};
+
+// The most recent samples for one stage, in GetHPCounter() ticks.
+class LatencySamples {
+ public:
+  LatencySamples();
+
+  void Add(int64_t ticks);
+
+  // |fraction| is in [0, 1], e.g. 0.95 for the 95th percentile. Returns 0 if
+  // there are no samples.
+  int64_t Percentile(double fraction) const;
+
+  int count() const { return count_; }
+
+  static const int kCapacity = 256;
+
+ private:
+  int64_t samples_[kCapacity];
+  int next_;
+  int count_;
+};
+
+// Called by ProcessEvents() for each event, with its posting time.
+void NoteInputDispatched(int64_t event_time, int64_t dispatch_time);
+
+// The main loop calls one of these after dispatching. Skipped means there
+// was nothing to paint, so the input didn't change what's on screen and
+// isn't counted.
+void NoteFrameSkipped();
+void NoteFrameRendered(int64_t time);
+void NoteFramePresented(int64_t time);
+
+const LatencySamples& GetInputLatency(LatencyStage::Enum stage);
+
+#endif  // INPUT_LATENCY_H_
@@ -0,0 +1,44 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "input_latency.h"
+
+#include <gtest/gtest.h>
+
+TEST(InputLatencyTest, Percentiles) {
+  LatencySamples samples;
+  EXPECT_EQ(0, samples.Percentile(0.5));
+  for (int i = 100; i > 0; --i)
+    samples.Add(i);
+  EXPECT_EQ(100, samples.count());
+  EXPECT_EQ(51, samples.Percentile(0.5));
+  EXPECT_EQ(96, samples.Percentile(0.95));
+  EXPECT_EQ(100, samples.Percentile(1.0));
+
+  // Only the most recent samples are kept.
+  for (int i = 0; i < LatencySamples::kCapacity; ++i)
+    samples.Add(1000);
+  EXPECT_EQ(LatencySamples::kCapacity, samples.count());
+  EXPECT_EQ(1000, samples.Percentile(0.0));
+}
+
+TEST(InputLatencyTest, OldestEventInFrame) {
+  const LatencySamples& total = GetInputLatency(LatencyStage::Total);
+  int count = total.count();
+
+  NoteInputDispatched(20, 30);
+  NoteInputDispatched(10, 31);
+  NoteFrameRendered(40);
+  NoteFramePresented(55);
+  ASSERT_EQ(count + 1, total.count());
+  EXPECT_EQ(21, GetInputLatency(LatencyStage::Queue).Percentile(1.0));
+  EXPECT_EQ(45, total.Percentile(1.0));
+
+  // Input that didn't cause a paint isn't attributed to a later frame.
+  NoteInputDispatched(60, 61);
+  NoteFrameSkipped();
+  NoteFrameRendered(1000);
+  NoteFramePresented(1001);
+  EXPECT_EQ(count + 1, total.count());
+}
@@ -0,0 +1,178 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "input_recording.h"
+
+#include <string.h>
+
+namespace {
+
+const char kMagic[4] = {'S', 'G', 'I', 'R'};
+// 2: 64-bit times, as 32 bits of microseconds wrap after 71 minutes.
+const uint32_t kVersion = 2;
+
+enum RecordFlags {
+  kFlagDown = 1 << 0,
+  kFlagMove = 1 << 1,
+  kFlagWheel = 1 << 2,
+  kFlagRepeat = 1 << 3,
+};
+
+// The union in Event has padding and platform-sized enums, so records are
+// packed into this instead.
+struct PackedEvent {
+  int64_t time_us;
+  uint8_t type;
+  uint8_t modifiers;
+  uint8_t code;  // Key or button.
+  uint8_t flags;
+  int32_t a;  // x, width, or character.
+  int32_t b;  // y or height.
+  float delta;
+};
+static_assert(sizeof(PackedEvent) == 24, "PackedEvent should be packed");
+
+PackedEvent PackEvent(const Event& event, int64_t time_us) {
+  PackedEvent record;
+  memset(&record, 0, sizeof(record));
+  record.time_us = time_us;
+  record.type = static_cast<uint8_t>(event.type);
+  switch (event.type) {
+    case Event::Key:
+      record.code = static_cast<uint8_t>(event.key.key);
+      record.modifiers = event.key.modifiers;
+      record.flags = (event.key.down ? kFlagDown : 0) |
+                     (event.key.repeat ? kFlagRepeat : 0);
+      break;
+    case Event::Char:
+      record.a = event.text.character;
+      break;
+    case Event::Mouse:
+      record.code = static_cast<uint8_t>(event.mouse.button);
+      record.modifiers = event.mouse.modifiers;
+      record.flags = (event.mouse.down ? kFlagDown : 0) |
+                     (event.mouse.move ? kFlagMove : 0) |
+                     (event.mouse.wheel ? kFlagWheel : 0);
+      record.a = event.mouse.mx;
+      record.b = event.mouse.my;
+      record.delta = event.mouse.delta;
+      break;
+    case Event::Size:
+      record.a = static_cast<int32_t>(event.size.width);
+      record.b = static_cast<int32_t>(event.size.height);
+      break;
+    default:
+      break;
+  }
+  return record;
+}
+
+bool UnpackEvent(const PackedEvent& record, Event* event) {
+  memset(event, 0, sizeof(*event));
+  // Split so that the multiplication can't overflow.
+  int64_t freq = GetHPFrequency();
+  event->time = record.time_us / 1000000 * freq +
+                record.time_us % 1000000 * freq / 1000000;
+  switch (record.type) {
+    case Event::Exit:
+      event->type = Event::Exit;
+      break;
+    case Event::Key:
+      if (record.code > Key::KeyZ)
+        return false;
+      event->type = Event::Key;
+      event->key.key = static_cast<Key::Enum>(record.code);
+      event->key.modifiers = record.modifiers;
+      event->key.down = (record.flags & kFlagDown) != 0;
+      event->key.repeat = (record.flags & kFlagRepeat) != 0;
+      break;
+    case Event::Char:
+      event->type = Event::Char;
+      event->text.character = record.a;
+      break;
+    case Event::Mouse:
+      if (record.code >= MouseButton::Count)
+        return false;
+      event->type = Event::Mouse;
+      event->mouse.mx = record.a;
+      event->mouse.my = record.b;
+      event->mouse.delta = record.delta;
+      event->mouse.button = static_cast<MouseButton::Enum>(record.code);
+      event->mouse.modifiers = record.modifiers;
+      event->mouse.down = (record.flags & kFlagDown) != 0;
+      event->mouse.move = (record.flags & kFlagMove) != 0;
+      event->mouse.wheel = (record.flags & kFlagWheel) != 0;
+      break;
+    case Event::Size:
+      event->type = Event::Size;
+      event->size.width = static_cast<uint32_t>(record.a);
+      event->size.height = static_cast<uint32_t>(record.b);
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+InputRecorder::InputRecorder() : file_(NULL), start_time_(-1) {
+}
+
+InputRecorder::~InputRecorder() {
+  Close();
+}
+
+bool InputRecorder::Open(const char* path) {
+  Close();
+  file_ = fopen(path, "wb");
+  if (!file_)
+    return false;
+  start_time_ = -1;
+  fwrite(kMagic, sizeof(kMagic), 1, file_);
+  fwrite(&kVersion, sizeof(kVersion), 1, file_);
+  return true;
+}
+
+void InputRecorder::Close() {
+  if (file_)
+    fclose(file_);
+  file_ = NULL;
+}
+
+void InputRecorder::Record(const Event& event) {
+  if (!file_)
+    return;
+  if (start_time_ < 0)
+    start_time_ = event.time;
+  int64_t ticks = event.time - start_time_;
+  int64_t freq = GetHPFrequency();
+  int64_t time_us = ticks / freq * 1000000 + ticks % freq * 1000000 / freq;
+  PackedEvent record = PackEvent(event, time_us);
+  fwrite(&record, sizeof(record), 1, file_);
+}
+
+bool ReadInputRecording(const char* path, std::vector<Event>* events) {
+  events->clear();
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return false;
+  char magic[sizeof(kMagic)];
+  uint32_t version;
+  bool valid = fread(magic, sizeof(magic), 1, f) == 1 &&
+               memcmp(magic, kMagic, sizeof(kMagic)) == 0 &&
+               fread(&version, sizeof(version), 1, f) == 1 &&
+               version == kVersion;
+  PackedEvent record;
+  while (valid && fread(&record, sizeof(record), 1, f) == 1) {
+    Event event;
+    valid = UnpackEvent(record, &event);
+    if (valid)
+      events->push_back(event);
+  }
+  fclose(f);
+  if (!valid)
+    events->clear();
+  return valid;
+}
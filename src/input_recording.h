@@ -0,0 +1,43 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef INPUT_RECORDING_H_
+#define INPUT_RECORDING_H_
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "core.h"
+#include "event_queue.h"
+
+// Saves the events that ProcessEvents() dispatches so that a session can be
+// replayed later, e.g. to turn a slow interaction into a repeatable
+// benchmark. After a short header, each event is a fixed 24 byte record, with
+// its time stored as 64-bit microseconds since the first event.
+class InputRecorder {
+ public:
+  InputRecorder();
+  ~InputRecorder();
+
+  // Returns false if |path| can't be written.
+  bool Open(const char* path);
+  void Close();
+  bool IsOpen() const { return file_ != NULL; }
+
+  void Record(const Event& event);
+
+ private:
+  FILE* file_;
+  int64_t start_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(InputRecorder);
+};
+
+// Loads a file written by InputRecorder. Event times are converted back to
+// GetHPCounter() ticks, starting from 0. Returns false if the file is missing
+// or isn't a recording.
+bool ReadInputRecording(const char* path, std::vector<Event>* events);
+
+#endif  // INPUT_RECORDING_H_
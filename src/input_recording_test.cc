@@ -0,0 +1,112 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "input_recording.h"
+
+#include <stdio.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+const char kRecordingPath[] = "input_recording_test.sgir";
+
+}  // namespace
+
+TEST(InputRecordingTest, RoundTrip) {
+  int64_t freq = GetHPFrequency();
+  std::vector<Event> recorded(4);
+  recorded[0].type = Event::Size;
+  recorded[0].time = 1000;
+  recorded[0].size.width = 800;
+  recorded[0].size.height = 600;
+  recorded[1].type = Event::Mouse;
+  recorded[1].time = 1000 + freq / 2;
+  recorded[1].mouse.mx = 10;
+  recorded[1].mouse.my = -20;
+  recorded[1].mouse.delta = 1.5f;
+  recorded[1].mouse.button = MouseButton::None;
+  recorded[1].mouse.modifiers = Modifier::LeftCtrl;
+  recorded[1].mouse.down = false;
+  recorded[1].mouse.move = false;
+  recorded[1].mouse.wheel = true;
+  recorded[2].type = Event::Key;
+  recorded[2].time = 1000 + freq;
+  recorded[2].key.key = Key::PageDown;
+  recorded[2].key.modifiers = Modifier::LeftShift;
+  recorded[2].key.down = true;
+  recorded[2].key.repeat = true;
+  recorded[3].type = Event::Char;
+  recorded[3].time = 1000 + freq * 2;
+  recorded[3].text.character = 0x263a;
+
+  {
+    InputRecorder recorder;
+    ASSERT_TRUE(recorder.Open(kRecordingPath));
+    for (const auto& event : recorded)
+      recorder.Record(event);
+  }
+
+  std::vector<Event> events;
+  ASSERT_TRUE(ReadInputRecording(kRecordingPath, &events));
+  remove(kRecordingPath);
+  ASSERT_EQ(4u, events.size());
+
+  // Times are relative to the first event.
+  EXPECT_EQ(0, events[0].time);
+  EXPECT_EQ(800u, events[0].size.width);
+  EXPECT_EQ(600u, events[0].size.height);
+
+  EXPECT_NEAR(freq / 2, events[1].time, freq / 1000);
+  EXPECT_TRUE(events[1].mouse.wheel);
+  EXPECT_FALSE(events[1].mouse.move);
+  EXPECT_EQ(10, events[1].mouse.mx);
+  EXPECT_EQ(-20, events[1].mouse.my);
+  EXPECT_EQ(1.5f, events[1].mouse.delta);
+  EXPECT_EQ(Modifier::LeftCtrl, events[1].mouse.modifiers);
+
+  EXPECT_EQ(Key::PageDown, events[2].key.key);
+  EXPECT_EQ(Modifier::LeftShift, events[2].key.modifiers);
+  EXPECT_TRUE(events[2].key.down);
+  EXPECT_TRUE(events[2].key.repeat);
+
+  EXPECT_EQ(Event::Char, events[3].type);
+  EXPECT_EQ(0x263a, events[3].text.character);
+}
+
+TEST(InputRecordingTest, LongRecordingsStayInOrder) {
+  int64_t freq = GetHPFrequency();
+  std::vector<Event> recorded(3);
+  for (auto& event : recorded)
+    event.type = Event::Char;
+  recorded[0].time = 0;
+  // Past where 32 bits of microseconds would wrap, at about 71.6 minutes.
+  recorded[1].time = freq * 60 * 72;
+  recorded[2].time = freq * 60 * 60 * 24;
+
+  {
+    InputRecorder recorder;
+    ASSERT_TRUE(recorder.Open(kRecordingPath));
+    for (const auto& event : recorded)
+      recorder.Record(event);
+  }
+
+  std::vector<Event> events;
+  ASSERT_TRUE(ReadInputRecording(kRecordingPath, &events));
+  remove(kRecordingPath);
+  ASSERT_EQ(3u, events.size());
+  EXPECT_EQ(recorded[1].time, events[1].time);
+  EXPECT_EQ(recorded[2].time, events[2].time);
+}
+
+TEST(InputRecordingTest, RejectsOtherFiles) {
+  FILE* f = fopen(kRecordingPath, "wb");
+  ASSERT_TRUE(f);
+  fputs("not a recording", f);
+  fclose(f);
+  std::vector<Event> events;
+  EXPECT_FALSE(ReadInputRecording(kRecordingPath, &events));
+  remove(kRecordingPath);
+  EXPECT_FALSE(ReadInputRecording(kRecordingPath, &events));
+}
@@ -0,0 +1,117 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "input_replay.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "allocation_counter.h"
+#include "docking_workspace.h"
+#include "event_queue.h"
+#include "frame_scheduler.h"
+#include "gfx.h"
+
+namespace {
+
+struct FrameStats {
+  double milliseconds;
+  int64_t allocations;
+};
+
+double Percentile(std::vector<double>* values, double fraction) {
+  if (values->empty())
+    return 0.0;
+  size_t index = std::min(static_cast<size_t>(fraction * values->size()),
+                          values->size() - 1);
+  std::nth_element(values->begin(), values->begin() + index, values->end());
+  return (*values)[index];
+}
+
+void PrintReport(const std::vector<FrameStats>& frames, double seconds) {
+  std::vector<double> times;
+  double max_time = 0.0;
+  int64_t total_allocations = 0;
+  int64_t max_allocations = 0;
+  for (const auto& frame : frames) {
+    times.push_back(frame.milliseconds);
+    max_time = std::max(max_time, frame.milliseconds);
+    total_allocations += frame.allocations;
+    max_allocations = std::max(max_allocations, frame.allocations);
+  }
+  double allocations_per_frame =
+      frames.empty() ? 0.0 : static_cast<double>(total_allocations) /
+                                 static_cast<double>(frames.size());
+
+  printf("replay: %d frames in %.3f s\n",
+         static_cast<int>(frames.size()),
+         seconds);
+  printf("frame time: p50 %.3f p95 %.3f p99 %.3f max %.3f [ms]\n",
+         Percentile(&times, 0.5),
+         Percentile(&times, 0.95),
+         Percentile(&times, 0.99),
+         max_time);
+  printf("allocations: %lld total, %.1f per frame, %lld max\n",
+         static_cast<long long>(total_allocations),  // NOLINT(runtime/int)
+         allocations_per_frame,
+         static_cast<long long>(max_allocations));  // NOLINT(runtime/int)
+}
+
+}  // namespace
+
+void ReplayInput(const std::vector<Event>& events,
+                 DockingWorkspace* workspace,
+                 ReplayResizeFn resize) {
+  const double freq = static_cast<double>(GetHPFrequency());
+  const int64_t frame_ticks = GetHPFrequency() / 60;
+
+  std::vector<FrameStats> frames;
+  uint32_t width = 0, height = 0;
+  uint32_t prev_width = 0, prev_height = 0;
+  int64_t frame_end = 0;
+  int64_t replay_start = GetHPCounter();
+  for (size_t next = 0; next < events.size();) {
+    frame_end += frame_ticks;
+    double now = static_cast<double>(frame_end) / freq;
+    SetVirtualAnimationClock(now);
+
+    int64_t start = GetHPCounter();
+    int64_t start_allocations = GetAllocationCount();
+
+    bool exit = false;
+    while (next < events.size() && events[next].time < frame_end) {
+      if (DispatchEvent(events[next++], &width, &height, workspace))
+        exit = true;
+    }
+    if (exit)
+      break;
+    if (width != prev_width || height != prev_height) {
+      resize(workspace, width, height);
+      GfxResize(width, height);
+      prev_width = width;
+      prev_height = height;
+    }
+
+    RunScheduledInvalidates(now);
+    if (!workspace->NeedsPaint())
+      continue;
+    SetFrameTime(now);
+    workspace->Render();
+
+    FrameStats stats;
+    stats.milliseconds =
+        static_cast<double>(GetHPCounter() - start) * 1000.0 / freq;
+    stats.allocations = GetAllocationCount() - start_allocations;
+    frames.push_back(stats);
+
+    // Outside the timing, as presenting waits for vsync.
+    if (GfxFrame())
+      workspace->Invalidate();
+  }
+  SetVirtualAnimationClock(-1.0);
+
+  PrintReport(frames,
+              static_cast<double>(GetHPCounter() - replay_start) / freq);
+}
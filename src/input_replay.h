@@ -0,0 +1,33 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef INPUT_REPLAY_H_
+#define INPUT_REPLAY_H_
+
+#include <vector>
+
+#include "core.h"
+
+class DockingWorkspace;
+struct Event;
+
+// Called when a replayed Size event changes the window size.
+typedef void (*ReplayResizeFn)(DockingWorkspace* workspace,
+                               uint32_t width,
+                               uint32_t height);
+
+// Replays a recording made with StartInputRecording() into |workspace| as
+// fast as possible, and prints per-frame timings and allocation counts to
+// stdout.
+//
+// Events are grouped into 60Hz frames on the recorded timeline, and the
+// animation clock follows that timeline, so a replay does the same work
+// each time. Frames are drawn to the window as usual, but the timings stop
+// before the frame is presented. They therefore cover input handling,
+// layout, recording and issuing the draws, but not waiting for vsync.
+void ReplayInput(const std::vector<Event>& events,
+                 DockingWorkspace* workspace,
+                 ReplayResizeFn resize);
+
+#endif  // INPUT_REPLAY_H_
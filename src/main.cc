@@ -8,13 +8,21 @@
 #include "docking_workspace.h"
 #include "entry.h"
 #include "focus.h"
+#include "frame_scheduler.h"
 #include "gfx.h"
+#include "input_latency.h"
+#include "input_recording.h"
+#include "input_replay.h"
 #include "skin.h"
 #include "solid_color.h"
 #include "source_view/source_view.h"
 #include "text_edit.h"
 #include "tree_grid.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #if 0
 #include "clang-c/Index.h"
 #endif
@@ -28,6 +36,45 @@ void FillColumns(TreeGridNode* node,
   node->SetValue(2, new TreeGridNodeValueString(type));
 }
 
+// Stands in for a std::vector<int> with |size| elements, which is too many to
+// add to the watch up front.
+class SampleVectorProvider : public TreeGridNodeProvider {
+ public:
+  explicit SampleVectorProvider(int size) : size_(size) {}
+
+  int GetChildCount(const TreeGridNode* node) override {
+    UNUSED(node);
+    return size_;
+  }
+
+  void PopulateChild(const TreeGridNode* node,
+                     int index,
+                     TreeGridNode* child) override {
+    UNUSED(node);
+    char name[32], key[32];
+    snprintf(name, sizeof(name), "[%d]", index);
+    snprintf(key, sizeof(key), "%d", index);
+    FillColumns(child, name, "", "int");
+    child->SetValue(1, new TreeGridNodeValuePending(key));
+  }
+
+ private:
+  int size_;
+};
+
+// Formats the sample vector's elements, whose keys are their indices, as
+// reading them from the debuggee would.
+class SampleValueFormatter : public TreeGridValueFormatter {
+ public:
+  std::string Format(const std::string& key,
+                     const std::atomic<bool>& cancelled) override {
+    UNUSED(cancelled);
+    char value[32];
+    snprintf(value, sizeof(value), "%d", atoi(key.c_str()) * 7);
+    return value;
+  }
+};
+
 void FillWatchWithSampleData(TreeGrid* watch) {
   // The TreeGrid owns all these pointers once they're added.
 
@@ -93,14 +140,50 @@ void FillWatchWithSampleData(TreeGrid* watch) {
               "0x040a87b0 {color_={rgba=0x040a87c8 {0.000000000, 0.168627456, "
               "0.211764708, 1.00000000} r=0.000000000 ...} }",
               "Dockable *");
+
+  const int kSampleVectorSize = 10000000;
+  static SampleVectorProvider sample_vector_provider(kSampleVectorSize);
+  TreeGridNode* root2 = new TreeGridNode(watch, NULL);
+  watch->Nodes()->push_back(root2);
+  FillColumns(root2,
+              "samples",
+              "{ size=10000000 }",
+              "std::vector<int,std::allocator<int> >");
+  root2->SetProvider(&sample_vector_provider);
+
+  static SampleValueFormatter sample_value_formatter;
+  watch->SetValueFormatter(&sample_value_formatter);
+}
+
+void ResizeWorkspace(DockingWorkspace* workspace,
+                     uint32_t width,
+                     uint32_t height) {
+  const Skin& skin = Skin::current();
+  workspace->SetScreenRect(
+      Rect(skin.border_size() / GetDpiScale(),
+           skin.border_size() / GetDpiScale(),
+           (width - skin.border_size() * 2) / GetDpiScale(),
+           (height - skin.border_size() * 2) / GetDpiScale()));
+  workspace->Invalidate();
+}
+
+// Returns the value of --|name|=value in |argv|, or NULL.
+const char* GetSwitchValue(int argc, char** argv, const char* name) {
+  size_t length = strlen(name);
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--", 2) == 0 &&
+        strncmp(argv[i] + 2, name, length) == 0 && argv[i][2 + length] == '=')
+      return argv[i] + 2 + length + 1;
+  }
+  return NULL;
 }
 
 int Main(int argc, char** argv) {
   GfxInit();
   Skin::LoadData();
 
-  UNUSED(argc);
-  UNUSED(argv);
+  const char* record_path = GetSwitchValue(argc, argv, "record-input");
+  const char* replay_path = GetSwitchValue(argc, argv, "replay-input");
 
 /*
 uint32_t test_texture_data[4] = {
@@ -194,23 +277,52 @@ uint32_t test_texture_data[4] = {
       kSplitHorizontal, stack, breakpoints);
   stack->parent()->AsDockingSplitContainer()->SetFraction(0.7f);
 
+  if (replay_path) {
+    std::vector<Event> events;
+    CHECK(ReadInputRecording(replay_path, &events),
+          "Couldn't read input recording %s",
+          replay_path);
+    ReplayInput(events, &main_area, ResizeWorkspace);
+    GfxShutdown();
+    return 0;
+  }
+
+  if (record_path) {
+    CHECK(StartInputRecording(record_path),
+          "Couldn't write input recording %s",
+          record_path);
+  }
+
   uint32_t prev_width = 0, prev_height = 0;
   uint32_t width, height;
   while (!ProcessEvents(&width, &height, &main_area)) {
+    if (TakeRepaintRequest())
+      main_area.Invalidate();
     if (prev_width != width || prev_height != height) {
-      main_area.SetScreenRect(
-          Rect(skin.border_size() / GetDpiScale(),
-               skin.border_size() / GetDpiScale(),
-               (width - skin.border_size() * 2) / GetDpiScale(),
-               (height - skin.border_size() * 2) / GetDpiScale()));
+      ResizeWorkspace(&main_area, width, height);
       GfxResize(width, height);
       prev_width = width;
       prev_height = height;
     }
 
+    // Only draw when something changed, or an animation is due.
+    double now = GetAnimationClock();
+    double next_frame_time = RunScheduledInvalidates(now);
+    if (!main_area.NeedsPaint()) {
+      NoteFrameSkipped();
+      WaitForEventOrDeadline(next_frame_time);
+      continue;
+    }
+
+    SetFrameTime(now);
     main_area.Render();
+    NoteFrameRendered(GetHPCounter());
     GfxDrawFps();
-    GfxFrame();
+    // A lost device loses everything drawn so far, including cached layers.
+    if (GfxFrame())
+      main_area.Invalidate();
+    // Present() waits for vsync, so this is about when the frame is shown.
+    NoteFramePresented(GetHPCounter());
   }
 
   GfxShutdown();
@@ -0,0 +1,74 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef OBJECT_POOL_H_
+#define OBJECT_POOL_H_
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "core.h"
+#include "threading.h"
+
+// Fixed-size blocks for objects of type |Ty|, carved out of slabs of
+// |BlocksPerSlab| at a time. Freed blocks go on a free list and are reused,
+// but slabs are only released when the pool is destroyed. Intended to back a
+// class-specific operator new/delete for small objects that are created in
+// large numbers:
+//
+//   void* Foo::operator new(size_t size) {
+//     return size == sizeof(Foo) ? g_foo_pool->Allocate()
+//                                : ::operator new(size);
+//   }
+//
+// Any thread.
+template <typename Ty, size_t BlocksPerSlab = 1024>
+class ObjectPool {
+ public:
+  ObjectPool() : free_list_(NULL) {}
+  ~ObjectPool() {}
+
+  void* Allocate() {
+    ScopedFutex lock(&lock_);
+    if (!free_list_)
+      AddSlab();
+    Block* block = free_list_;
+    free_list_ = block->next;
+    return block;
+  }
+
+  void Free(void* ptr) {
+    if (!ptr)
+      return;
+    ScopedFutex lock(&lock_);
+    Block* block = static_cast<Block*>(ptr);
+    block->next = free_list_;
+    free_list_ = block;
+  }
+
+ private:
+  union Block {
+    Block* next;
+    typename std::aligned_storage<sizeof(Ty), ALIGNOF(Ty)>::type storage;
+  };
+
+  void AddSlab() {
+    Block* slab = new Block[BlocksPerSlab];
+    slabs_.push_back(std::unique_ptr<Block[]>(slab));
+    // Pushed in reverse so that they're handed out in address order.
+    for (size_t i = BlocksPerSlab; i-- > 0;) {
+      slab[i].next = free_list_;
+      free_list_ = &slab[i];
+    }
+  }
+
+  Futex lock_;
+  Block* free_list_;
+  std::vector<std::unique_ptr<Block[]>> slabs_;
+
+  DISALLOW_COPY_AND_ASSIGN(ObjectPool);
+};
+
+#endif  // OBJECT_POOL_H_
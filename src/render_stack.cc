@@ -0,0 +1,67 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "render_stack.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace {
+
+float Snap(float value) {
+  return floorf(value + 0.5f);
+}
+
+Rect Intersect(const Rect& a, const Rect& b) {
+  float x0 = std::max(a.x, b.x);
+  float y0 = std::max(a.y, b.y);
+  float x1 = std::min(a.x + a.w, b.x + b.w);
+  float y1 = std::min(a.y + a.h, b.y + b.h);
+  return Rect(x0, y0, std::max(x1 - x0, 0.f), std::max(y1 - y0, 0.f));
+}
+
+}  // namespace
+
+RenderStack::RenderStack() : depth_(0) {
+}
+
+void RenderStack::PushRoot(float width, float height) {
+  CHECK(depth_ < kMaxDepth, "render stack overflow");
+  Entry& entry = entries_[depth_++];
+  entry.x = 0.f;
+  entry.y = 0.f;
+  entry.clip = Rect(0.f, 0.f, width, height);
+  entry.scissor = false;
+}
+
+void RenderStack::Push(const Rect& rect, bool scissor) {
+  CHECK(depth_ > 0, "no root pushed");
+  CHECK(depth_ < kMaxDepth, "render stack overflow");
+  const Entry& parent = entries_[depth_ - 1];
+  Entry& entry = entries_[depth_++];
+  entry.x = Snap(parent.x + rect.x);
+  entry.y = Snap(parent.y + rect.y);
+  entry.scissor = scissor;
+  if (scissor) {
+    entry.clip = Intersect(
+        parent.clip, Rect(entry.x, entry.y, Snap(rect.w), Snap(rect.h)));
+  } else {
+    entry.clip = parent.clip;
+  }
+}
+
+void RenderStack::Pop() {
+  CHECK(depth_ > 0, "render stack underflow");
+  --depth_;
+}
+
+bool RenderStack::IsVisible(const Rect& rect) const {
+  const Entry& top = Top();
+  float x = top.x + rect.x;
+  float y = top.y + rect.y;
+  const Rect& clip = top.clip;
+  return x < clip.x + clip.w && x + rect.w > clip.x && y < clip.y + clip.h &&
+         y + rect.h > clip.y;
+}
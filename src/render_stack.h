@@ -0,0 +1,63 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef RENDER_STACK_H_
+#define RENDER_STACK_H_
+
+#include "core.h"
+#include "geometric_types.h"
+
+// Offsets and clips for immediate drawing, kept in a fixed-size array so that
+// pushing and popping never allocates. Offsets are snapped to whole units so
+// that lines and text land on pixel boundaries. Clips are intersected as
+// they're pushed, so that the backend can cheaply skip draws that would be
+// entirely clipped before they reach the device.
+class RenderStack {
+ public:
+  RenderStack();
+
+  // Starts a new root (a frame, or drawing into a layer) of the given size,
+  // with no offset and a clip to its bounds. Undone by Pop().
+  void PushRoot(float width, float height);
+
+  // Offsets by |rect|'s origin, and if |scissor|, also clips to |rect|.
+  // |rect| is in the current coordinates.
+  void Push(const Rect& rect, bool scissor);
+  void Pop();
+
+  int depth() const { return depth_; }
+
+  // Accumulated offset and clip relative to the current root.
+  float offset_x() const { return Top().x; }
+  float offset_y() const { return Top().y; }
+  const Rect& clip() const { return Top().clip; }
+  // Whether the most recent Push() was a scissor.
+  bool scissor() const { return Top().scissor; }
+
+  // Whether any part of |rect|, in the current coordinates, is inside the
+  // clip.
+  bool IsVisible(const Rect& rect) const;
+
+ private:
+  struct Entry {
+    float x;
+    float y;
+    Rect clip;
+    bool scissor;
+  };
+
+  const Entry& Top() const {
+    DCHECK(depth_ > 0, "empty render stack");
+    return entries_[depth_ - 1];
+  }
+
+  // Deeper than the widget tree will ever nest.
+  static const int kMaxDepth = 64;
+  Entry entries_[kMaxDepth];
+  int depth_;
+
+  DISALLOW_COPY_AND_ASSIGN(RenderStack);
+};
+
+#endif  // RENDER_STACK_H_
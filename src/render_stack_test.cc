@@ -0,0 +1,61 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "render_stack.h"
+
+#include <gtest/gtest.h>
+
+TEST(RenderStackTest, OffsetsAccumulateAndSnap) {
+  RenderStack stack;
+  stack.PushRoot(800, 600);
+  EXPECT_EQ(1, stack.depth());
+  stack.Push(Rect(10.4f, 20.6f, 100, 100), false);
+  EXPECT_EQ(10.f, stack.offset_x());
+  EXPECT_EQ(21.f, stack.offset_y());
+  stack.Push(Rect(5, 5, 0, 0), false);
+  EXPECT_EQ(15.f, stack.offset_x());
+  EXPECT_EQ(26.f, stack.offset_y());
+  stack.Pop();
+  stack.Pop();
+  EXPECT_EQ(0.f, stack.offset_x());
+  stack.Pop();
+  EXPECT_EQ(0, stack.depth());
+}
+
+TEST(RenderStackTest, ClipsIntersect) {
+  RenderStack stack;
+  stack.PushRoot(800, 600);
+  stack.Push(Rect(100, 100, 200, 200), true);
+  stack.Push(Rect(150, 150, 200, 200), true);
+  // The inner clip is at 250,250 in root coordinates, but limited by the
+  // outer one ending at 300,300.
+  EXPECT_EQ(250.f, stack.clip().x);
+  EXPECT_EQ(250.f, stack.clip().y);
+  EXPECT_EQ(50.f, stack.clip().w);
+  EXPECT_EQ(50.f, stack.clip().h);
+  EXPECT_TRUE(stack.scissor());
+
+  // Rects are relative to the current offset.
+  EXPECT_TRUE(stack.IsVisible(Rect(0, 0, 10, 10)));
+  EXPECT_TRUE(stack.IsVisible(Rect(-10, -10, 11, 11)));
+  EXPECT_FALSE(stack.IsVisible(Rect(-10, -10, 10, 10)));
+  EXPECT_FALSE(stack.IsVisible(Rect(50, 0, 10, 10)));
+
+  // An offset without a scissor keeps the clip.
+  stack.Push(Rect(-1000, 0, 0, 0), false);
+  EXPECT_FALSE(stack.scissor());
+  EXPECT_EQ(50.f, stack.clip().w);
+  EXPECT_TRUE(stack.IsVisible(Rect(1000, 0, 1, 1)));
+}
+
+TEST(RenderStackTest, RootResets) {
+  RenderStack stack;
+  stack.PushRoot(800, 600);
+  stack.Push(Rect(100, 100, 10, 10), true);
+  stack.PushRoot(300, 200);
+  EXPECT_EQ(0.f, stack.offset_x());
+  EXPECT_TRUE(stack.IsVisible(Rect(250, 150, 10, 10)));
+  stack.Pop();
+  EXPECT_FALSE(stack.IsVisible(Rect(250, 150, 10, 10)));
+}
@@ -4,15 +4,23 @@
 
 #include "scroll_helper.h"
 
+#include <math.h>
+
 #include <algorithm>
 
+#include "frame_scheduler.h"
 #include "gfx.h"
 #include "skin.h"
 
 namespace {
 
-const int kFadeOutAfterTicks = 90;
-const int kFadeOutOverTicks = 30;
+// Fraction of the remaining distance that's scrolled each nominal frame.
+const double kScrollEase = 0.2;
+const double kNominalFrameTime = 1.0 / 60.0;
+
+// In seconds.
+const double kFadeOutAfter = 1.5;
+const double kFadeOutOver = 0.5;
 
 }  // namespace
 
@@ -20,8 +28,11 @@ ScrollHelper::ScrollHelper(ScrollHelperDataProvider* data_provider,
                            float num_pixels_in_line)
     : y_pixel_scroll_(0),
       y_pixel_scroll_target_(0),
+      y_position_(0.0),
+      scrolling_(false),
+      last_update_time_(0.0),
       // Start hidden.
-      ticks_since_stopped_moving_(kFadeOutAfterTicks + kFadeOutOverTicks),
+      last_moved_time_(-(kFadeOutAfter + kFadeOutOver)),
       num_pixels_in_line_(static_cast<int>(num_pixels_in_line)),
       data_provider_(data_provider) {
 }
@@ -29,20 +40,39 @@ ScrollHelper::ScrollHelper(ScrollHelperDataProvider* data_provider,
 ScrollHelper::~ScrollHelper() {
 }
 
-bool ScrollHelper::Update() {
-  float delta = (y_pixel_scroll_target_ - y_pixel_scroll_) * 0.2f;
-  int before = y_pixel_scroll_;
-  y_pixel_scroll_ += static_cast<int>(delta);
-  if (before == y_pixel_scroll_) {
-    y_pixel_scroll_ = y_pixel_scroll_target_;
-    bool invalidate =
-        ticks_since_stopped_moving_ < (kFadeOutAfterTicks + kFadeOutOverTicks);
-    if (invalidate)
-      ticks_since_stopped_moving_++;
-    return invalidate;
+bool ScrollHelper::Update(double* next_frame_time) {
+  double now = GetFrameTime();
+  if (y_pixel_scroll_ != y_pixel_scroll_target_) {
+    // Eased by elapsed time rather than per frame, so that scrolling takes as
+    // long at any frame rate. There's no previous frame to measure from when
+    // starting from rest, so the first step is a nominal one.
+    double elapsed = scrolling_ ? now - last_update_time_ : kNominalFrameTime;
+    double fraction =
+        1.0 - pow(1.0 - kScrollEase, elapsed / kNominalFrameTime);
+    y_position_ += (y_pixel_scroll_target_ - y_position_) * fraction;
+    if (fabs(y_pixel_scroll_target_ - y_position_) < 0.5)
+      y_position_ = y_pixel_scroll_target_;
+    y_pixel_scroll_ = static_cast<int>(floor(y_position_ + 0.5));
+    scrolling_ = true;
+    last_update_time_ = now;
+    last_moved_time_ = now;
+    *next_frame_time = now;
+    return true;
   }
-  ticks_since_stopped_moving_ = 0;
-  return true;
+
+  scrolling_ = false;
+  y_position_ = y_pixel_scroll_;
+  double fade_start = last_moved_time_ + kFadeOutAfter;
+  if (now < fade_start) {
+    // Nothing changes until the indicator starts fading.
+    *next_frame_time = fade_start;
+    return true;
+  }
+  if (now < fade_start + kFadeOutOver) {
+    *next_frame_time = now;
+    return true;
+  }
+  return false;
 }
 
 void ScrollHelper::RenderScrollIndicators() {
@@ -61,12 +91,13 @@ void ScrollHelper::RenderScrollIndicators() {
   float scrollbar_offset = static_cast<float>(visible_height * offset_fraction);
 
   float alpha = 1.0;
-  if (ticks_since_stopped_moving_ >= kFadeOutAfterTicks) {
-    alpha =
-        1.f -
-        static_cast<float>(ticks_since_stopped_moving_ - kFadeOutAfterTicks) /
-            kFadeOutOverTicks;
+  double since_moved = GetFrameTime() - last_moved_time_;
+  if (since_moved >= kFadeOutAfter) {
+    alpha = 1.f - static_cast<float>((since_moved - kFadeOutAfter) /
+                                     kFadeOutOver);
   }
+  if (alpha <= 0.f)
+    return;
 
   DrawSolidRoundedRect(
       Rect(screen_rect.w - 13.f, scrollbar_offset, 8.f, scrollbar_height),
@@ -75,13 +106,16 @@ void ScrollHelper::RenderScrollIndicators() {
 }
 
 bool ScrollHelper::ClampScrollTarget() {
-  y_pixel_scroll_target_ = std::max(0, y_pixel_scroll_target_);
-  int largest_possible = data_provider_->GetContentSize() - num_pixels_in_line_;
+  // Content shorter than a line has nowhere to scroll, rather than somewhere
+  // above the top.
+  int largest_possible =
+      std::max(0, data_provider_->GetContentSize() - num_pixels_in_line_);
   y_pixel_scroll_target_ = std::min(largest_possible, y_pixel_scroll_target_);
+  y_pixel_scroll_target_ = std::max(0, y_pixel_scroll_target_);
   // Not this, if we want the scrollbar to re-appear if, e.g. you press up
   // while at the top of the document.
   // return y_pixel_scroll_ != y_pixel_scroll_target_;
-  ticks_since_stopped_moving_ = 0;
+  last_moved_time_ = GetAnimationClock();
   return true;
 }
 
@@ -113,6 +147,29 @@ bool ScrollHelper::ScrollToEnd() {
   return ClampScrollTarget();
 }
 
+bool ScrollHelper::ScrollToShow(int top, int height, int visible_height) {
+  if (top < y_pixel_scroll_target_)
+    y_pixel_scroll_target_ = top;
+  else if (top + height > y_pixel_scroll_target_ + visible_height)
+    y_pixel_scroll_target_ = top + height - visible_height;
+  else
+    return false;
+  return ClampScrollTarget();
+}
+
+bool ScrollHelper::ClampToContentSize() {
+  int largest_possible =
+      std::max(0, data_provider_->GetContentSize() - num_pixels_in_line_);
+  y_pixel_scroll_target_ =
+      std::max(0, std::min(largest_possible, y_pixel_scroll_target_));
+  int clamped = std::max(0, std::min(largest_possible, y_pixel_scroll_));
+  if (clamped == y_pixel_scroll_)
+    return false;
+  y_pixel_scroll_ = clamped;
+  y_position_ = clamped;
+  return true;
+}
+
 void ScrollHelper::CommonNotifyKey(Key::Enum key,
                                    bool down,
                                    uint8_t modifiers,
@@ -25,8 +25,9 @@ class ScrollHelper {
                float num_pixels_in_line);
   virtual ~ScrollHelper();
 
-  // Returns whether invalidation is required.
-  bool Update();
+  // Advances scrolling and fading to GetFrameTime(). Returns whether another
+  // frame is needed, and if so sets |*next_frame_time| to when.
+  bool Update(double* next_frame_time);
 
   void RenderScrollIndicators();
   int GetOffset() const { return y_pixel_scroll_; }
@@ -37,6 +38,14 @@ class ScrollHelper {
   bool ScrollPages(int delta);
   bool ScrollToBeginning();
   bool ScrollToEnd();
+  // Scrolls as little as possible so that the |height| pixels at |top| are
+  // within the first |visible_height| pixels of the view.
+  bool ScrollToShow(int top, int height, int visible_height);
+  // Brings the offset back within [0, content size - line] after the content
+  // has shrunk.
+  // It jumps rather than animates, as there'd be nothing to show on the
+  // way. Returns whether the offset moved.
+  bool ClampToContentSize();
 
   // Optional, standard handling of keys/mouse for scrolling.
   void CommonNotifyKey(Key::Enum key,
@@ -56,7 +65,13 @@ class ScrollHelper {
   // TODO(scottmg): x, Point.
   int y_pixel_scroll_;
   int y_pixel_scroll_target_;
-  int ticks_since_stopped_moving_;
+  // Unrounded |y_pixel_scroll_| while animating.
+  double y_position_;
+  bool scrolling_;
+  double last_update_time_;
+  // When scrolling last moved, or was last requested, for fading out the
+  // indicator.
+  double last_moved_time_;
   int num_pixels_in_line_;
   ScrollHelperDataProvider* data_provider_;
 };
@@ -59,7 +59,8 @@ ColorScheme::ColorScheme()
       op_(kGreen),
       margin_(kBase02),
       margin_text_(kBase0),
-      pc_indicator_(kYellow) {
+      pc_indicator_(kYellow),
+      changed_value_(kRed) {
   text_selection_.a = .3f;
 }
 
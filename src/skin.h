@@ -54,6 +54,7 @@ class ColorScheme {
   const Color& margin_text() const { return margin_text_; }
 
   const Color& pc_indicator() const { return pc_indicator_; }
+  const Color& changed_value() const { return changed_value_; }
 
  private:
   Color border_;
@@ -86,6 +87,7 @@ class ColorScheme {
   Color margin_text_;
 
   Color pc_indicator_;
+  Color changed_value_;
 };
 
 class Skin {
@@ -94,7 +94,9 @@ bool SourceView::NotifyKey(Key::Enum key, bool down, uint8_t modifiers) {
 }
 
 void SourceView::Render() {
-  scroll_.Update();
+  double next_frame_time;
+  if (scroll_.Update(&next_frame_time))
+    InvalidateAt(next_frame_time);
   const Skin& skin = Skin::current();
   const ColorScheme& cs = skin.GetColorScheme();
   DrawSolidRect(GetClientRect(), cs.background());
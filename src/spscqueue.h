@@ -5,6 +5,8 @@
 #ifndef SPSCQUEUE_H_
 #define SPSCQUEUE_H_
 
+#include <atomic>
+
 #include "threading.h"
 
 // --------------------------------------------------------------------------
@@ -28,7 +30,7 @@ class SpScQueue {
   }
 
   // Producer only.
-  void push(Ty* ptr) {
+  void Push(Ty* ptr) {
     last_->next_ = new Node(reinterpret_cast<void*>(ptr));
     AtomicExchangePtr(reinterpret_cast<void**>(&last_), last_->next_);
     while (first_ != divider_) {
@@ -72,6 +74,75 @@ class SpScQueue {
   DISALLOW_COPY_AND_ASSIGN(SpScQueue);
 };
 
+// Fixed-capacity single producer, single consumer ring buffer of values.
+// Unlike SpScQueue, nothing is allocated after construction. The producer's
+// and consumer's indices are on separate cache lines so they don't
+// false-share, and each side keeps a cached copy of the other's index so that
+// it only touches the other's line when it appears full (or empty).
+template <typename Ty, uint32_t Capacity>
+class SpScRingBuffer {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+ public:
+  SpScRingBuffer() : write_(0), cached_read_(0), read_(0), cached_write_(0) {}
+
+  // Producer only. Returns false, without blocking, if the buffer is full.
+  bool TryPush(const Ty& value) {
+    uint32_t write = write_.load(std::memory_order_relaxed);
+    if (write - cached_read_ == Capacity) {
+      cached_read_ = read_.load(std::memory_order_acquire);
+      if (write - cached_read_ == Capacity)
+        return false;
+    }
+    items_[write & (Capacity - 1)] = value;
+    write_.store(write + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Returns false if the buffer is empty.
+  bool TryPop(Ty* value) {
+    uint32_t read = read_.load(std::memory_order_relaxed);
+    if (read == cached_write_) {
+      cached_write_ = write_.load(std::memory_order_acquire);
+      if (read == cached_write_)
+        return false;
+    }
+    *value = items_[read & (Capacity - 1)];
+    read_.store(read + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. The next item that TryPop() would return, or null. Valid
+  // until the next TryPop().
+  const Ty* Peek() {
+    uint32_t read = read_.load(std::memory_order_relaxed);
+    if (read == cached_write_) {
+      cached_write_ = write_.load(std::memory_order_acquire);
+      if (read == cached_write_)
+        return NULL;
+    }
+    return &items_[read & (Capacity - 1)];
+  }
+
+ private:
+  char pad0_[CACHE_LINE_SIZE];
+  // Producer's line.
+  std::atomic<uint32_t> write_;
+  uint32_t cached_read_;
+  char pad1_[CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>) -
+             sizeof(uint32_t)];
+  // Consumer's line.
+  std::atomic<uint32_t> read_;
+  uint32_t cached_write_;
+  char pad2_[CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>) -
+             sizeof(uint32_t)];
+  Ty items_[Capacity];
+
+  DISALLOW_COPY_AND_ASSIGN(SpScRingBuffer);
+};
+
+// SpScQueue whose consumer can sleep until something is pushed.
 template <typename Ty>
 class SpScBlockingQueue {
  public:
@@ -80,23 +151,35 @@ class SpScBlockingQueue {
 
   // Producer only.
   void Push(Ty* ptr) {
-    queue_.push(reinterpret_cast<void*>(ptr));
-    count_.post();
+    queue_.Push(reinterpret_cast<void*>(ptr));
+    wake_.Signal();
   }
 
   // Consumer only.
-  Ty* Peek() { return reinterpret_cast<Ty*>(queue_.peek()); }
+  Ty* Peek() { return reinterpret_cast<Ty*>(queue_.Peek()); }
 
-  // Consumer only.
+  // Consumer only. Waits up to |_msecs| for an item, or indefinitely if
+  // negative. Returns null on timeout.
   Ty* Pop(int32_t _msecs = -1) {
-    if (count_.wait(_msecs)) {
-      return reinterpret_cast<Ty*>(queue_.pop());
+    int64_t deadline =
+        GetHPCounter() + GetHPFrequency() * std::max(_msecs, 0) / 1000;
+    for (;;) {
+      if (void* ptr = queue_.Pop())
+        return reinterpret_cast<Ty*>(ptr);
+      double seconds = -1.0;
+      if (_msecs >= 0) {
+        int64_t remaining = deadline - GetHPCounter();
+        if (remaining <= 0)
+          return NULL;
+        seconds = static_cast<double>(remaining) /
+                  static_cast<double>(GetHPFrequency());
+      }
+      wake_.Wait(seconds);
     }
-    return NULL;
   }
 
  private:
-  Semaphore count_;
+  WakeEvent wake_;
   SpScQueue<void> queue_;
 
   DISALLOW_COPY_AND_ASSIGN(SpScBlockingQueue);
@@ -0,0 +1,115 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "bench.h"
+#include "event_queue.h"
+#include "spscqueue.h"
+#include "threading.h"
+
+// Each benchmark has a producer thread pushing |iterations| items to the
+// calling thread, so the time per iteration is the throughput of a
+// cross-thread hand-off.
+
+namespace {
+
+struct Item {
+  int value;
+};
+
+struct LinkedQueueState {
+  SpScQueue<Item> queue;
+  int iterations;
+};
+
+int32_t LinkedQueueProducer(void* user_data) {
+  LinkedQueueState* state = reinterpret_cast<LinkedQueueState*>(user_data);
+  for (int i = 0; i < state->iterations; ++i) {
+    Item* item = new Item;
+    item->value = i;
+    state->queue.Push(item);
+  }
+  return 0;
+}
+
+struct RingBufferState {
+  SpScRingBuffer<Item, 1024> queue;
+  int iterations;
+};
+
+int32_t RingBufferProducer(void* user_data) {
+  RingBufferState* state = reinterpret_cast<RingBufferState*>(user_data);
+  for (int i = 0; i < state->iterations; ++i) {
+    Item item = {i};
+    while (!state->queue.TryPush(item))
+      YieldThread();
+  }
+  return 0;
+}
+
+struct EventQueueState {
+  EventQueue queue;
+  int iterations;
+};
+
+int32_t EventQueueProducer(void* user_data) {
+  EventQueueState* state = reinterpret_cast<EventQueueState*>(user_data);
+  for (int i = 0; i < state->iterations; ++i)
+    state->queue.PostMouseMoveEvent(i, i);
+  state->queue.PostExitEvent();
+  return 0;
+}
+
+}  // namespace
+
+// The queue that EventQueue used to be built on, with an allocation per item.
+BENCHMARK(SpScQueue_NewDelete) {
+  LinkedQueueState state;
+  state.iterations = iterations;
+  Thread producer;
+  producer.Init(LinkedQueueProducer, &state);
+  for (int received = 0; received < iterations;) {
+    if (Item* item = state.queue.Pop()) {
+      CHECK(item->value == received);
+      delete item;
+      ++received;
+    } else {
+      YieldThread();
+    }
+  }
+  producer.Shutdown();
+}
+
+BENCHMARK(SpScRingBuffer) {
+  RingBufferState state;
+  state.iterations = iterations;
+  Thread producer;
+  producer.Init(RingBufferProducer, &state);
+  Item item;
+  for (int received = 0; received < iterations;) {
+    if (state.queue.TryPop(&item)) {
+      CHECK(item.value == received);
+      ++received;
+    } else {
+      YieldThread();
+    }
+  }
+  producer.Shutdown();
+}
+
+// Mouse moves may be merged when the consumer falls behind, so this runs
+// until the exit event rather than counting.
+BENCHMARK(EventQueue_MouseMove) {
+  EventQueueState state;
+  state.iterations = iterations;
+  Thread producer;
+  producer.Init(EventQueueProducer, &state);
+  Event ev;
+  for (;;) {
+    if (!state.queue.Poll(&ev))
+      YieldThread();
+    else if (ev.type == Event::Exit)
+      break;
+  }
+  producer.Shutdown();
+}
@@ -0,0 +1,52 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "spscqueue.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+double Now() {
+  return static_cast<double>(GetHPCounter()) /
+         static_cast<double>(GetHPFrequency());
+}
+
+struct ProducerState {
+  SpScBlockingQueue<int> queue;
+  int values[3];
+};
+
+int32_t SlowProducer(void* user_data) {
+  ProducerState* state = reinterpret_cast<ProducerState*>(user_data);
+  for (size_t i = 0; i < COUNTOF(state->values); ++i) {
+    // Give the consumer time to block.
+    WakeEvent never_signaled;
+    never_signaled.Wait(0.01);
+    state->values[i] = static_cast<int>(i);
+    state->queue.Push(&state->values[i]);
+  }
+  return 0;
+}
+
+}  // namespace
+
+TEST(SpScBlockingQueueTest, PopWaitsForPush) {
+  ProducerState state;
+  Thread producer;
+  producer.Init(SlowProducer, &state);
+  EXPECT_EQ(0, *state.queue.Pop());
+  EXPECT_EQ(1, *state.queue.Pop(10000));
+  EXPECT_EQ(2, *state.queue.Pop(-1));
+  producer.Shutdown();
+  EXPECT_EQ(NULL, state.queue.Peek());
+}
+
+TEST(SpScBlockingQueueTest, PopTimesOut) {
+  SpScBlockingQueue<int> queue;
+  EXPECT_EQ(NULL, queue.Pop(0));
+  double start = Now();
+  EXPECT_EQ(NULL, queue.Pop(20));
+  EXPECT_GE(Now() - start, 0.019);
+}
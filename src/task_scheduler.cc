@@ -0,0 +1,375 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "task_scheduler.h"
+
+#include <algorithm>
+
+struct Task {
+  TaskFn fn;
+  void* user_data;
+  TaskGroup* group;
+  TaskPriority::Enum priority;
+};
+
+namespace {
+
+// Chase-Lev work-stealing deque, with the memory orderings from "Correct and
+// Efficient Work-Stealing for Weak Memory Models" (Le et al., 2013). The
+// owning worker pushes and pops at the bottom; any thread can steal from the
+// top.
+class WorkStealingDeque {
+ public:
+  WorkStealingDeque() : top_(0), bottom_(0), array_(new Array(256)) {}
+
+  ~WorkStealingDeque() { delete array_.load(std::memory_order_relaxed); }
+
+  // Owner only.
+  void Push(Task* task) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    Array* array = array_.load(std::memory_order_relaxed);
+    if (bottom - top > array->capacity - 1)
+      array = Grow(array, top, bottom);
+    array->Put(bottom, task);
+    bottom_.store(bottom + 1, std::memory_order_release);
+  }
+
+  // Owner only. Returns the most recently pushed task, or NULL.
+  Task* Pop() {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* array = array_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return NULL;
+    }
+    Task* task = array->Get(bottom);
+    if (top == bottom) {
+      // The last one, so race thieves for it.
+      if (!top_.compare_exchange_strong(top,
+                                        top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        task = NULL;
+      }
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  // Any thread. Returns the oldest task, or NULL if there are none or
+  // another thread took it first.
+  Task* Steal() {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom)
+      return NULL;
+    Array* array = array_.load(std::memory_order_acquire);
+    Task* task = array->Get(top);
+    if (!top_.compare_exchange_strong(top,
+                                      top + 1,
+                                      std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return NULL;
+    }
+    return task;
+  }
+
+ private:
+  struct Array {
+    explicit Array(int64_t capacity)
+        : capacity(capacity), items(new std::atomic<Task*>[capacity]) {}
+
+    Task* Get(int64_t i) const {
+      return items[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+    void Put(int64_t i, Task* task) {
+      items[i & (capacity - 1)].store(task, std::memory_order_relaxed);
+    }
+
+    int64_t capacity;
+    std::unique_ptr<std::atomic<Task*>[]> items;
+  };
+
+  Array* Grow(Array* array, int64_t top, int64_t bottom) {
+    Array* bigger = new Array(array->capacity * 2);
+    for (int64_t i = top; i < bottom; ++i)
+      bigger->Put(i, array->Get(i));
+    // A thief might still be reading from the old one, so it's kept until the
+    // deque is destroyed.
+    retired_.push_back(std::unique_ptr<Array>(array));
+    array_.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+
+  // Thieves write |top_| and the owner writes |bottom_|, so they're kept on
+  // separate lines.
+  std::atomic<int64_t> top_;
+  char pad0_[CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+  std::atomic<int64_t> bottom_;
+  char pad1_[CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+  std::atomic<Array*> array_;
+  std::vector<std::unique_ptr<Array>> retired_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingDeque);
+};
+
+THREAD TaskWorker* g_current_worker;
+THREAD uint32_t g_steal_seed;
+
+// Picks where to start looking for work to steal, so that idle threads don't
+// all go after the same worker.
+uint32_t NextStealIndex(uint32_t count) {
+  uint32_t x = g_steal_seed;
+  if (x == 0)
+    x = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&g_steal_seed)) | 1;
+  // xorshift32.
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  g_steal_seed = x;
+  return x % count;
+}
+
+struct ParallelForState {
+  TaskScheduler::ParallelForFn fn;
+  void* user_data;
+  int count;
+  std::atomic<int> next;
+};
+
+void RunParallelForItems(void* user_data) {
+  ParallelForState* state = reinterpret_cast<ParallelForState*>(user_data);
+  for (;;) {
+    int index = state->next.fetch_add(1, std::memory_order_relaxed);
+    if (index >= state->count)
+      return;
+    state->fn(state->user_data, index);
+  }
+}
+
+}  // namespace
+
+struct TaskWorker {
+  TaskScheduler* scheduler;
+  WorkStealingDeque deques[TaskPriority::Count];
+  Thread thread;
+};
+
+TaskGroup::TaskGroup() : pending_(0) {
+}
+
+TaskGroup::~TaskGroup() {
+  DCHECK(pending_.load() == 0, "TaskGroup destroyed with tasks pending");
+  // The last task to finish may still be releasing |lock_|.
+  ScopedFutex lock(&lock_);
+}
+
+bool TaskGroup::IsDone() const {
+  return pending_.load(std::memory_order_acquire) == 0;
+}
+
+TaskScheduler::TaskScheduler(int num_workers) : sleeping_(0), exiting_(false) {
+  for (int i = 0; i < TaskPriority::Count; ++i)
+    injected_count_[i] = 0;
+  // All the workers have to exist before any start, as they steal from each
+  // other.
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.push_back(std::unique_ptr<TaskWorker>(new TaskWorker));
+    workers_.back()->scheduler = this;
+  }
+  for (auto& worker : workers_)
+    worker->thread.Init(WorkerMain, worker.get());
+}
+
+TaskScheduler::~TaskScheduler() {
+  exiting_.store(true, std::memory_order_seq_cst);
+  wake_.Post(static_cast<uint32_t>(workers_.size()));
+  for (auto& worker : workers_)
+    worker->thread.Shutdown();
+}
+
+// static
+TaskScheduler* TaskScheduler::Get() {
+  // Leaked, so that it's still usable by anything else being torn down at
+  // exit.
+  static TaskScheduler* scheduler = new TaskScheduler(
+      std::max(static_cast<int>(GetNumberOfProcessors()) - 1, 1));
+  return scheduler;
+}
+
+void TaskScheduler::Post(TaskPriority::Enum priority,
+                         TaskFn fn,
+                         void* user_data,
+                         TaskGroup* group) {
+  Schedule(NewTask(priority, fn, user_data, group));
+}
+
+void TaskScheduler::PostContinuation(TaskGroup* after,
+                                     TaskPriority::Enum priority,
+                                     TaskFn fn,
+                                     void* user_data,
+                                     TaskGroup* group) {
+  Task* task = NewTask(priority, fn, user_data, group);
+  {
+    ScopedFutex lock(&after->lock_);
+    if (after->pending_.load(std::memory_order_acquire) > 0) {
+      after->continuations_.push_back(task);
+      return;
+    }
+  }
+  Schedule(task);
+}
+
+void TaskScheduler::Wait(TaskGroup* group) {
+  TaskWorker* self = CurrentWorker();
+  TaskPriority::Enum lowest = self || workers_.empty()
+                                  ? TaskPriority::Background
+                                  : TaskPriority::Interactive;
+  while (group->pending_.load(std::memory_order_acquire) > 0) {
+    if (Task* task = FindTask(self, lowest))
+      Run(task);
+    else
+      YieldThread();
+  }
+}
+
+void TaskScheduler::ParallelFor(TaskPriority::Enum priority,
+                                int count,
+                                ParallelForFn fn,
+                                void* user_data) {
+  if (count <= 0)
+    return;
+  ParallelForState state;
+  state.fn = fn;
+  state.user_data = user_data;
+  state.count = count;
+  state.next = 0;
+  // Each helper takes indices until they run out, so there's no need for a
+  // task per index.
+  TaskGroup group;
+  int helpers = std::min(num_workers(), count - 1);
+  for (int i = 0; i < helpers; ++i)
+    Post(priority, RunParallelForItems, &state, &group);
+  RunParallelForItems(&state);
+  Wait(&group);
+}
+
+// static
+int32_t TaskScheduler::WorkerMain(void* user_data) {
+  TaskWorker* self = reinterpret_cast<TaskWorker*>(user_data);
+  TaskScheduler* scheduler = self->scheduler;
+  g_current_worker = self;
+  for (;;) {
+    if (Task* task = scheduler->FindTask(self, TaskPriority::Background)) {
+      scheduler->Run(task);
+      continue;
+    }
+    if (scheduler->exiting_.load(std::memory_order_acquire))
+      return 0;
+
+    // Announce that we're going to sleep before looking one last time, so
+    // that a Schedule() racing with this either sees us sleeping and posts
+    // |wake_|, or its task is found here.
+    scheduler->sleeping_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    Task* task = scheduler->FindTask(self, TaskPriority::Background);
+    if (!task && !scheduler->exiting_.load(std::memory_order_acquire))
+      scheduler->wake_.Wait();
+    scheduler->sleeping_.fetch_sub(1, std::memory_order_seq_cst);
+    if (task)
+      scheduler->Run(task);
+  }
+}
+
+Task* TaskScheduler::NewTask(TaskPriority::Enum priority,
+                             TaskFn fn,
+                             void* user_data,
+                             TaskGroup* group) {
+  Task* task = new Task;
+  task->fn = fn;
+  task->user_data = user_data;
+  task->group = group;
+  task->priority = priority;
+  if (group)
+    group->pending_.fetch_add(1, std::memory_order_relaxed);
+  return task;
+}
+
+void TaskScheduler::Schedule(Task* task) {
+  if (TaskWorker* self = CurrentWorker()) {
+    self->deques[task->priority].Push(task);
+  } else {
+    ScopedFutex lock(&injected_lock_);
+    injected_[task->priority].push_back(task);
+    injected_count_[task->priority].fetch_add(1, std::memory_order_release);
+  }
+  WakeWorker();
+}
+
+void TaskScheduler::WakeWorker() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed) > 0)
+    wake_.Post();
+}
+
+Task* TaskScheduler::FindTask(TaskWorker* self, TaskPriority::Enum lowest) {
+  for (int priority = 0; priority <= lowest; ++priority) {
+    if (self) {
+      if (Task* task = self->deques[priority].Pop())
+        return task;
+    }
+
+    if (injected_count_[priority].load(std::memory_order_acquire) > 0) {
+      ScopedFutex lock(&injected_lock_);
+      std::deque<Task*>& queue = injected_[priority];
+      if (!queue.empty()) {
+        Task* task = queue.front();
+        queue.pop_front();
+        injected_count_[priority].fetch_sub(1, std::memory_order_relaxed);
+        return task;
+      }
+    }
+
+    uint32_t count = static_cast<uint32_t>(workers_.size());
+    if (count == 0)
+      continue;
+    uint32_t start = NextStealIndex(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      TaskWorker* victim = workers_[(start + i) % count].get();
+      if (victim == self)
+        continue;
+      if (Task* task = victim->deques[priority].Steal())
+        return task;
+    }
+  }
+  return NULL;
+}
+
+void TaskScheduler::Run(Task* task) {
+  task->fn(task->user_data);
+  TaskGroup* group = task->group;
+  delete task;
+  if (!group)
+    return;
+
+  std::vector<Task*> continuations;
+  {
+    ScopedFutex lock(&group->lock_);
+    if (group->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      continuations.swap(group->continuations_);
+  }
+  // |group| may be gone by now.
+  for (Task* continuation : continuations)
+    Schedule(continuation);
+}
+
+TaskWorker* TaskScheduler::CurrentWorker() const {
+  TaskWorker* worker = g_current_worker;
+  return worker && worker->scheduler == this ? worker : NULL;
+}
@@ -0,0 +1,141 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef TASK_SCHEDULER_H_
+#define TASK_SCHEDULER_H_
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "core.h"
+#include "threading.h"
+
+// Runs short tasks on a fixed set of worker threads. Each worker has its own
+// deque of tasks: it pushes and pops at one end, and workers that run out of
+// work steal from the other end of someone else's. Work that a task posts
+// therefore tends to stay on the same thread, and there's no lock shared by
+// every post. Tasks posted from threads that aren't workers go into a shared
+// queue instead.
+//
+// Interactive tasks are ones the current frame is waiting on, e.g. recording
+// display lists. Background tasks are everything else, e.g. loading files,
+// lexing and indexing. Workers always take Interactive work first, but
+// a Background task that's already running isn't interrupted.
+
+struct TaskPriority {
+  enum Enum {
+    Interactive,
+    Background,
+    Count,
+  };
+};
+
+typedef void (*TaskFn)(void* user_data);
+
+struct Task;
+struct TaskWorker;
+
+// A set of tasks that can be waited for, or followed by a continuation.
+// Tasks can be added while others in the group are running, e.g. by those
+// tasks. Must outlive its tasks.
+class TaskGroup {
+ public:
+  TaskGroup();
+  ~TaskGroup();
+
+  // Whether every task posted to the group so far has finished.
+  bool IsDone() const;
+
+ private:
+  friend class TaskScheduler;
+
+  std::atomic<int32_t> pending_;
+
+  // Protects |continuations_|, and is held while |pending_| drops to zero so
+  // that the destructor can wait for the last task to let go of the group.
+  Futex lock_;
+  std::vector<Task*> continuations_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+};
+
+class TaskScheduler {
+ public:
+  typedef void (*ParallelForFn)(void* user_data, int index);
+
+  explicit TaskScheduler(int num_workers);
+  // Finishes every posted task before returning.
+  ~TaskScheduler();
+
+  // The scheduler shared by the whole application. It has one worker per
+  // processor beyond the first, as the main thread helps out in Wait(), but
+  // always at least one so that Background work progresses.
+  static TaskScheduler* Get();
+
+  // Runs |fn| with |user_data|. |group| may be NULL. Any thread.
+  void Post(TaskPriority::Enum priority,
+            TaskFn fn,
+            void* user_data,
+            TaskGroup* group);
+
+  // Posts |fn| once every task in |after| has finished, or right away if
+  // they all have already. The continuation counts as part of |group| from
+  // now on, and |group| may be NULL. Any thread.
+  void PostContinuation(TaskGroup* after,
+                        TaskPriority::Enum priority,
+                        TaskFn fn,
+                        void* user_data,
+                        TaskGroup* group);
+
+  // Returns once every task in |group| has finished. The calling thread runs
+  // tasks in the meantime: any task if it's a worker, or if there are no
+  // workers; otherwise only Interactive ones, so that waiting for a frame
+  // isn't held up by a long Background task.
+  void Wait(TaskGroup* group);
+
+  // Calls |fn| with |user_data| and each index in [0, count) on the workers
+  // and the calling thread, and returns once all calls have completed.
+  void ParallelFor(TaskPriority::Enum priority,
+                   int count,
+                   ParallelForFn fn,
+                   void* user_data);
+
+  int num_workers() const { return static_cast<int>(workers_.size()); }
+
+ private:
+  static int32_t WorkerMain(void* user_data);
+
+  Task* NewTask(TaskPriority::Enum priority,
+                TaskFn fn,
+                void* user_data,
+                TaskGroup* group);
+  void Schedule(Task* task);
+  void WakeWorker();
+
+  // |self| is NULL if the caller isn't one of this scheduler's workers. Only
+  // tasks with a priority of at most |lowest| are returned.
+  Task* FindTask(TaskWorker* self, TaskPriority::Enum lowest);
+  void Run(Task* task);
+
+  TaskWorker* CurrentWorker() const;
+
+  std::vector<std::unique_ptr<TaskWorker>> workers_;
+
+  // Tasks posted from threads that aren't workers, and the number in each
+  // queue so that workers can check without locking.
+  Futex injected_lock_;
+  std::deque<Task*> injected_[TaskPriority::Count];
+  std::atomic<int32_t> injected_count_[TaskPriority::Count];
+
+  // Idle workers sleep on |wake_|, which is posted only if there are any.
+  std::atomic<int32_t> sleeping_;
+  Semaphore wake_;
+  std::atomic<bool> exiting_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskScheduler);
+};
+
+#endif  // TASK_SCHEDULER_H_
@@ -0,0 +1,103 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "task_scheduler.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+void AddIndex(void* user_data, int index) {
+  reinterpret_cast<std::atomic<int>*>(user_data)->fetch_add(index);
+}
+
+void Increment(void* user_data) {
+  reinterpret_cast<std::atomic<int>*>(user_data)->fetch_add(1);
+}
+
+struct FanOut {
+  TaskScheduler* scheduler;
+  TaskGroup* group;
+  std::atomic<int>* count;
+  int depth;
+};
+
+// Posts two more copies of itself until |depth| reaches 0, so tasks are
+// mostly posted from workers rather than the test thread.
+void RunFanOut(void* user_data) {
+  FanOut* fan_out = reinterpret_cast<FanOut*>(user_data);
+  fan_out->count->fetch_add(1);
+  if (fan_out->depth > 0) {
+    for (int i = 0; i < 2; ++i) {
+      FanOut* child = new FanOut(*fan_out);
+      child->depth--;
+      fan_out->scheduler->Post(
+          TaskPriority::Background, RunFanOut, child, fan_out->group);
+    }
+  }
+  delete fan_out;
+}
+
+struct Continuation {
+  std::atomic<int>* count;
+  int count_when_run;
+};
+
+void RecordCount(void* user_data) {
+  Continuation* continuation = reinterpret_cast<Continuation*>(user_data);
+  continuation->count_when_run = continuation->count->load();
+}
+
+}  // namespace
+
+TEST(TaskSchedulerTest, ParallelFor) {
+  for (int workers = 0; workers < 4; ++workers) {
+    TaskScheduler scheduler(workers);
+    std::atomic<int> sum(0);
+    scheduler.ParallelFor(TaskPriority::Interactive, 1000, AddIndex, &sum);
+    EXPECT_EQ(999 * 1000 / 2, sum.load());
+  }
+}
+
+TEST(TaskSchedulerTest, NestedPostsAndWait) {
+  TaskScheduler scheduler(3);
+  TaskGroup group;
+  std::atomic<int> count(0);
+  FanOut* root = new FanOut;
+  root->scheduler = &scheduler;
+  root->group = &group;
+  root->count = &count;
+  root->depth = 10;
+  scheduler.Post(TaskPriority::Background, RunFanOut, root, &group);
+  scheduler.Wait(&group);
+  EXPECT_TRUE(group.IsDone());
+  EXPECT_EQ((1 << 11) - 1, count.load());
+}
+
+TEST(TaskSchedulerTest, Continuation) {
+  TaskScheduler scheduler(2);
+  TaskGroup first;
+  TaskGroup second;
+  std::atomic<int> count(0);
+  for (int i = 0; i < 100; ++i)
+    scheduler.Post(TaskPriority::Background, Increment, &count, &first);
+  Continuation continuation = {&count, -1};
+  scheduler.PostContinuation(&first,
+                             TaskPriority::Interactive,
+                             RecordCount,
+                             &continuation,
+                             &second);
+  scheduler.Wait(&second);
+  EXPECT_EQ(100, continuation.count_when_run);
+
+  // |first| is done, so this runs right away.
+  continuation.count_when_run = -1;
+  scheduler.PostContinuation(&first,
+                             TaskPriority::Background,
+                             RecordCount,
+                             &continuation,
+                             &second);
+  scheduler.Wait(&second);
+  EXPECT_EQ(100, continuation.count_when_run);
+}
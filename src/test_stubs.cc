@@ -13,3 +13,13 @@ void SetWindowSize(uint32_t /*width*/, uint32_t /*height*/) {
 
 void SetMouseCursor(MouseCursor::Enum /*cursor*/) {
 }
+
+void WaitForEventOrDeadline(double /*deadline*/) {
+}
+
+// Counted so that tests can check what wakes the main loop.
+int g_post_wakeup_count;
+
+void PostWakeup() {
+  ++g_post_wakeup_count;
+}
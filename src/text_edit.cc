@@ -4,6 +4,7 @@
 
 #include "text_edit.h"
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -12,6 +13,7 @@
 
 #include "entry.h"
 #include "focus.h"
+#include "frame_scheduler.h"
 #include "gfx.h"
 #include "skin.h"
 #include "string_piece.h"
@@ -21,6 +23,9 @@
 
 #include "../third_party/stb/stb_textedit.h"
 
+// In seconds.
+const double kCursorBlinkInterval = 0.53;
+
 struct TextControl {
   char* string;
   int string_len;
@@ -153,10 +158,8 @@ struct ScopedCursorAlphaReset {
   ~ScopedCursorAlphaReset() {
     STB_TexteditState* state =
         &(static_cast<STB_TEXTEDIT_STRING*>(parent_->impl_)->state);
-    if (cursor_orig_ != state->cursor) {
-      parent_->cursor_color_.a = 1.f;
-      parent_->cursor_color_target_.a = 0.f;
-    }
+    if (cursor_orig_ != state->cursor)
+      parent_->cursor_blink_start_ = GetAnimationClock();
   }
 
   TextEdit* parent_;
@@ -164,11 +167,10 @@ struct ScopedCursorAlphaReset {
 };
 
 TextEdit::TextEdit()
-    : mouse_x_(-1.f), mouse_y_(-1.f), left_mouse_is_down_(false) {
-  const ColorScheme& cs = Skin::current().GetColorScheme();
-  cursor_color_ = cursor_color_target_ = cs.cursor();
-  cursor_color_.a = 255.f;
-  cursor_color_target_.a = 0.f;
+    : mouse_x_(-1.f),
+      mouse_y_(-1.f),
+      cursor_blink_start_(0.0),
+      left_mouse_is_down_(false) {
   impl_ = calloc(1, sizeof(STB_TEXTEDIT_STRING));
   LOCAL_state();
   LOCAL_control();
@@ -190,8 +192,10 @@ bool TextEdit::NotifyMouseMoved(int x, int y, uint8_t modifiers) {
   LOCAL_control();
   if (GetScreenRect().Contains(Point(mouse_x_, mouse_y_)))
     SetMouseCursor(MouseCursor::IBeam);
-  if (left_mouse_is_down_)
+  if (left_mouse_is_down_) {
     stb_textedit_drag(control, state, mouse_x_ - X(), mouse_y_ - Y());
+    Invalidate();
+  }
   return true;
 }
 
@@ -283,17 +287,16 @@ void TextEdit::Render() {
 
   // Caret.
   if (GetFocusedContents() == this) {
-    // TODO(scottmg): Frame rate.
-    cursor_color_ = Lerp(cursor_color_, cursor_color_target_, 0.3f);
-    if (fabsf(cursor_color_.a - cursor_color_target_.a) < 0.0001f) {
-      if (cursor_color_target_.a == 0.f)
-        cursor_color_target_.a = 1.f;
-      else
-        cursor_color_target_.a = 0.f;
+    // Toggles every kCursorBlinkInterval, so only needs a frame at each
+    // toggle rather than continuously.
+    double since_start = std::max(GetFrameTime() - cursor_blink_start_, 0.0);
+    double intervals = floor(since_start / kCursorBlinkInterval);
+    InvalidateAt(cursor_blink_start_ + (intervals + 1) * kCursorBlinkInterval);
+    if (fmod(intervals, 2.0) == 0.0) {
+      float cursor_x =
+          CursorXFromIndex(tm, control->string_len, state->cursor);
+      DrawSolidRect(Rect(cursor_x, rect.y, 1.5f, line_height_), cs.cursor());
     }
-    float cursor_x = CursorXFromIndex(tm, control->string_len, state->cursor);
-
-    DrawSolidRect(Rect(cursor_x, rect.y, 1.5f, line_height_), cursor_color_);
   }
 
   // Selection.
@@ -41,8 +41,8 @@ class TextEdit : public Widget {
   void* impl_;
   float mouse_x_;
   float mouse_y_;
-  Color cursor_color_;
-  Color cursor_color_target_;
+  // The caret blinks relative to this, so it's solid while it's moving.
+  double cursor_blink_start_;
   bool left_mouse_is_down_;
   float line_height_;
 
@@ -0,0 +1,136 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "text_width.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "threading.h"
+
+namespace {
+
+const int kNumFonts = static_cast<int>(Font::kTitle) + 1;
+
+const char kEllipsis[] = "...";
+
+float MeasureWithGfx(Font font, StringPiece str) {
+  return GfxMeasureText(font, str).width;
+}
+
+MeasureTextWidthFn g_measure = MeasureWithGfx;
+
+// The advance of each printable ASCII character.
+struct AdvanceTable {
+  float advances[128];
+};
+
+Futex g_tables_lock;
+AdvanceTable g_tables[kNumFonts];
+std::atomic<bool> g_tables_built[kNumFonts];
+
+const AdvanceTable& GetAdvanceTable(Font font) {
+  int index = static_cast<int>(font);
+  if (!g_tables_built[index].load(std::memory_order_acquire)) {
+    ScopedFutex lock(&g_tables_lock);
+    if (!g_tables_built[index].load(std::memory_order_relaxed)) {
+      // Measured between two other characters, as trailing spaces aren't
+      // included in a width.
+      AdvanceTable& table = g_tables[index];
+      float bracket_width = g_measure(font, "||");
+      char text[4] = {'|', 0, '|', 0};
+      for (int c = 0; c < 128; ++c) {
+        if (c < ' ' || c > '~') {
+          table.advances[c] = 0.f;
+          continue;
+        }
+        text[1] = static_cast<char>(c);
+        table.advances[c] = g_measure(font, StringPiece(text, 3)) -
+                            bracket_width;
+      }
+      g_tables_built[index].store(true, std::memory_order_release);
+    }
+  }
+  return g_tables[index];
+}
+
+}  // namespace
+
+float EstimateTextWidth(Font font, StringPiece str) {
+  const AdvanceTable& table = GetAdvanceTable(font);
+  if (font == Font::kMono) {
+    // Count code points, i.e. bytes other than continuation bytes.
+    size_t count = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+      if ((static_cast<uint8_t>(str.data()[i]) & 0xc0) != 0x80)
+        ++count;
+    }
+    return static_cast<float>(count) * table.advances['X'];
+  }
+
+  float width = 0.f;
+  for (size_t i = 0; i < str.size(); ++i) {
+    uint8_t c = static_cast<uint8_t>(str.data()[i]);
+    if (c < ' ' || c > '~')
+      return g_measure(font, str);
+    width += table.advances[c];
+  }
+  return width;
+}
+
+size_t TextPrefixWidths::LengthThatFits(Font font,
+                                        StringPiece str,
+                                        float width) {
+  if (width < 0.f)
+    return 0;
+  if (widths_.empty())
+    widths_.push_back(0.f);
+
+  // Measure on until past |width|, or to the end.
+  const AdvanceTable& table = GetAdvanceTable(font);
+  size_t measured = widths_.size() - 1;
+  float total = widths_.back();
+  while (measured < str.size() && total <= width) {
+    const char* start = str.data() + measured;
+    uint8_t c = static_cast<uint8_t>(*start);
+    size_t length = 1;
+    if (c >= 0x80) {
+      while (measured + length < str.size() &&
+             (static_cast<uint8_t>(start[length]) & 0xc0) == 0x80) {
+        ++length;
+      }
+    }
+    if (font == Font::kMono)
+      total += table.advances['X'];
+    else if (c >= ' ' && c <= '~')
+      total += table.advances[c];
+    else
+      total += g_measure(font, StringPiece(start, length));
+    widths_.insert(widths_.end(), length, total);
+    measured += length;
+  }
+
+  size_t fits = std::upper_bound(widths_.begin(), widths_.end(), width) -
+                widths_.begin() - 1;
+  while (fits > 0 && fits < str.size() &&
+         (static_cast<uint8_t>(str.data()[fits]) & 0xc0) == 0x80) {
+    --fits;
+  }
+  return fits;
+}
+
+std::string TextPrefixWidths::Elide(Font font, StringPiece str, float width) {
+  if (LengthThatFits(font, str, width) == str.size())
+    return str.AsString();
+  size_t length = LengthThatFits(
+      font, str, width - EstimateTextWidth(font, kEllipsis));
+  return std::string(str.data(), length) + kEllipsis;
+}
+
+void SetMeasureTextWidthFnForTesting(MeasureTextWidthFn fn) {
+  ScopedFutex lock(&g_tables_lock);
+  g_measure = fn ? fn : MeasureWithGfx;
+  for (int i = 0; i < kNumFonts; ++i)
+    g_tables_built[i].store(false, std::memory_order_relaxed);
+}
@@ -0,0 +1,59 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef TEXT_WIDTH_H_
+#define TEXT_WIDTH_H_
+
+#include <string>
+#include <vector>
+
+#include "core.h"
+#include "gfx.h"
+#include "string_piece.h"
+
+// Estimates the width of |str| in |font| without laying it out, by adding up
+// the advance of each character, which is measured once per font. Exact for
+// Font::kMono, where every character has the same advance, and close for the
+// others, as kerning is ignored. Text in the others that isn't all printable
+// ASCII is measured properly. Any thread.
+float EstimateTextWidth(Font font, StringPiece str);
+
+// The estimated widths of the prefixes of one string, calculated only as far
+// as they've been asked for. Finding how much of a long string fits in a
+// width therefore costs about as much as the part that fits, and nothing
+// once it's been done for that width. Widths are summed per code point, so
+// unlike EstimateTextWidth(), text that isn't ASCII is measured a character
+// at a time. Not thread-safe.
+class TextPrefixWidths {
+ public:
+  TextPrefixWidths() {}
+
+  // The length of the longest prefix of |str| that's at most |width| wide,
+  // not counting partial UTF-8 sequences. |font| and |str| must be the same
+  // on every call.
+  size_t LengthThatFits(Font font, StringPiece str, float width);
+  // |str| if it fits in |width|, or otherwise as much of it as fits followed
+  // by an ellipsis.
+  std::string Elide(Font font, StringPiece str, float width);
+
+  // How many bytes of the string have been measured so far.
+  size_t measured_length() const {
+    return widths_.empty() ? 0 : widths_.size() - 1;
+  }
+
+ private:
+  // The width of the prefix of each length. Lengths that end inside a UTF-8
+  // sequence have the width up to the end of it.
+  std::vector<float> widths_;
+
+  DISALLOW_COPY_AND_ASSIGN(TextPrefixWidths);
+};
+
+// Measures with GfxMeasureText() by default. Tests, which have no graphics
+// device, can substitute something else, which also clears the advances
+// measured so far. NULL restores the default.
+typedef float (*MeasureTextWidthFn)(Font font, StringPiece str);
+void SetMeasureTextWidthFnForTesting(MeasureTextWidthFn fn);
+
+#endif  // TEXT_WIDTH_H_
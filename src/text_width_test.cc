@@ -0,0 +1,101 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "text_width.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+int g_measure_calls;
+
+// 'W' is 10 wide and every other byte is 5, except that the mono font is 6.
+float FakeMeasure(Font font, StringPiece str) {
+  ++g_measure_calls;
+  float width = 0.f;
+  for (size_t i = 0; i < str.size(); ++i) {
+    if (font == Font::kMono)
+      width += 6.f;
+    else
+      width += str.data()[i] == 'W' ? 10.f : 5.f;
+  }
+  return width;
+}
+
+class TextWidthTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    SetMeasureTextWidthFnForTesting(FakeMeasure);
+    g_measure_calls = 0;
+  }
+  void TearDown() override { SetMeasureTextWidthFnForTesting(NULL); }
+};
+
+}  // namespace
+
+TEST_F(TextWidthTest, AsciiUsesAdvances) {
+  EXPECT_FLOAT_EQ(15.f, EstimateTextWidth(Font::kUI, "abc"));
+  EXPECT_FLOAT_EQ(25.f, EstimateTextWidth(Font::kUI, "W W"));
+  EXPECT_FLOAT_EQ(0.f, EstimateTextWidth(Font::kUI, ""));
+
+  // The advances are measured once, and then reused.
+  int calls = g_measure_calls;
+  EXPECT_FLOAT_EQ(5000.f, EstimateTextWidth(Font::kUI, std::string(1000, 'x')));
+  EXPECT_EQ(calls, g_measure_calls);
+}
+
+TEST_F(TextWidthTest, OtherTextIsMeasured) {
+  EstimateTextWidth(Font::kUI, "a");
+  int calls = g_measure_calls;
+  // Two bytes of UTF-8, or a tab.
+  EXPECT_FLOAT_EQ(10.f, EstimateTextWidth(Font::kUI, "\xc3\xa9"));
+  EXPECT_FLOAT_EQ(10.f, EstimateTextWidth(Font::kUI, "\ta"));
+  EXPECT_EQ(calls + 2, g_measure_calls);
+}
+
+TEST_F(TextWidthTest, MonoCountsCodePoints) {
+  EXPECT_FLOAT_EQ(18.f, EstimateTextWidth(Font::kMono, "WWW"));
+  int calls = g_measure_calls;
+  EXPECT_FLOAT_EQ(18.f, EstimateTextWidth(Font::kMono, "h\xc3\xa9y"));
+  EXPECT_EQ(calls, g_measure_calls);
+}
+
+TEST_F(TextWidthTest, PrefixWidthsMeasureOnlyWhatFits) {
+  std::string text(1000000, 'a');
+  TextPrefixWidths widths;
+  EXPECT_EQ(4u, widths.LengthThatFits(Font::kUI, text, 24.f));
+  EXPECT_EQ(5u, widths.LengthThatFits(Font::kUI, text, 25.f));
+  EXPECT_LT(widths.measured_length(), 10u);
+  EXPECT_EQ(0u, widths.LengthThatFits(Font::kUI, text, 4.f));
+
+  // Narrower again only looks at what's been measured.
+  EXPECT_EQ(40u, widths.LengthThatFits(Font::kUI, text, 200.f));
+  size_t measured = widths.measured_length();
+  EXPECT_EQ(20u, widths.LengthThatFits(Font::kUI, text, 100.f));
+  EXPECT_EQ(measured, widths.measured_length());
+}
+
+TEST_F(TextWidthTest, PrefixWidthsDontSplitCharacters) {
+  // The two-byte character is measured alone, as 10.
+  std::string text = "a\xc3\xa9" "b";
+  TextPrefixWidths widths;
+  EXPECT_EQ(1u, widths.LengthThatFits(Font::kUI, text, 14.f));
+  EXPECT_EQ(3u, widths.LengthThatFits(Font::kUI, text, 15.f));
+  EXPECT_EQ(4u, widths.LengthThatFits(Font::kUI, text, 1000.f));
+  EXPECT_EQ(4u, widths.measured_length());
+}
+
+TEST_F(TextWidthTest, Elide) {
+  std::string text = "abcdefghij";
+  TextPrefixWidths widths;
+  EXPECT_EQ("abcdefghij", widths.Elide(Font::kUI, text, 50.f));
+  EXPECT_EQ("abcdef...", widths.Elide(Font::kUI, text, 49.f));
+  EXPECT_EQ("a...", widths.Elide(Font::kUI, text, 20.f));
+  EXPECT_EQ("...", widths.Elide(Font::kUI, text, 5.f));
+
+  std::string long_text(1000000, 'x');
+  TextPrefixWidths long_widths;
+  EXPECT_EQ("xxxxxxx...", long_widths.Elide(Font::kUI, long_text, 50.f));
+  EXPECT_LT(long_widths.measured_length(), 20u);
+}
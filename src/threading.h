@@ -5,21 +5,131 @@
 #ifndef THREADING_H_
 #define THREADING_H_
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
 #include "core.h"
 
+#if PLATFORM_POSIX
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#if PLATFORM_LINUX
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+// --------------------------------------------------------------------------
+//
+// Contention counters.
+//
+// --------------------------------------------------------------------------
+
+// Process-wide counts of how often Futex::Lock() found the lock already held,
+// and how often that meant sleeping rather than spinning until it was free.
+struct LockContention {
+  std::atomic<int64_t> contended;
+  std::atomic<int64_t> parked;
+};
+
+inline LockContention* GetLockContention() {
+  static LockContention contention;
+  return &contention;
+}
+
+// --------------------------------------------------------------------------
+//
+// Futex syscall.
+//
+// --------------------------------------------------------------------------
+
+// A hint to the CPU that this is a spin-wait loop.
+inline void CpuRelax() {
+#if CPU_X86 && COMPILER_MSVC
+  _mm_pause();
+#elif CPU_X86
+  __builtin_ia32_pause();
+#endif
+}
+
+#if PLATFORM_LINUX
+
+// Sleeps while |*address| == |expected|, for up to |seconds| if that's not
+// negative. The timeout is relative, on the monotonic clock. Returns false if
+// it timed out; otherwise it was woken, the value had already changed, or it
+// was interrupted, so the caller should check again.
+inline bool FutexWait(std::atomic<int32_t>* address,
+                      int32_t expected,
+                      double seconds) {
+  timespec timeout;
+  if (seconds >= 0.0) {
+    timeout.tv_sec = static_cast<time_t>(seconds);
+    timeout.tv_nsec =
+        static_cast<long>((seconds - timeout.tv_sec) * 1e9);  // NOLINT
+  }
+  long result = syscall(SYS_futex,  // NOLINT(runtime/int)
+                        reinterpret_cast<int32_t*>(address),
+                        FUTEX_WAIT_PRIVATE,
+                        expected,
+                        seconds < 0.0 ? NULL : &timeout,
+                        NULL,
+                        0);
+  return result == 0 || errno != ETIMEDOUT;
+}
+
+// Wakes up to |count| threads in FutexWait() on |address|.
+inline void FutexWake(std::atomic<int32_t>* address, int32_t count) {
+  syscall(SYS_futex,
+          reinterpret_cast<int32_t*>(address),
+          FUTEX_WAKE_PRIVATE,
+          count,
+          NULL,
+          NULL,
+          0);
+}
+
+#endif  // PLATFORM_LINUX
+
 // --------------------------------------------------------------------------
 //
 // Mutex.
 //
 // --------------------------------------------------------------------------
 
+class ConditionVariable;
+
+// On Linux this is a real futex: uncontended Lock() and Unlock() are a single
+// atomic operation each, and a contended Lock() spins briefly before
+// sleeping in the kernel. The state is 0 when unlocked, 1 when locked, and 2
+// when locked and there may be threads asleep waiting for it. On Windows it's
+// a critical section, which spins the same way before it waits.
 class Futex {
  public:
-#if defined(PLATFORM_WINDOWS)
+#if PLATFORM_WINDOWS
   Futex() { InitializeCriticalSection(&handle_); }
   ~Futex() { DeleteCriticalSection(&handle_); }
-  void Lock() { EnterCriticalSection(&handle_); }
+  void Lock() {
+    if (!TryEnterCriticalSection(&handle_))
+      LockContended();
+  }
   void Unlock() { LeaveCriticalSection(&handle_); }
+#elif PLATFORM_LINUX
+  Futex() : state_(0) {}
+  ~Futex() {}
+  void Lock() {
+    int32_t unlocked = 0;
+    if (!state_.compare_exchange_strong(
+            unlocked, 1, std::memory_order_acquire, std::memory_order_relaxed))
+      LockContended();
+  }
+  void Unlock() {
+    if (state_.exchange(0, std::memory_order_release) == 2)
+      FutexWake(&state_, 1);
+  }
 #else
   Futex() { pthread_mutex_init(&handle_, NULL); }
   ~Futex() { pthread_mutex_destroy(&handle_); }
@@ -31,8 +141,52 @@ class Futex {
   Futex(const Futex&);             // no copy constructor
   Futex& operator=(const Futex&);  // no assignment operator
 
-#if defined(PLATFORM_WINDOWS)
+  friend class ConditionVariable;
+
+  // Most critical sections here are a few instructions long, so it's
+  // usually cheaper to spin than to sleep.
+  static const int kSpinCount = 100;
+
+#if PLATFORM_WINDOWS
+  void LockContended() {
+    GetLockContention()->contended.fetch_add(1, std::memory_order_relaxed);
+    // Spin here rather than with the critical section's own spin count, so
+    // that getting as far as EnterCriticalSection() can be counted as parking.
+    // It's an estimate, as the lock may be released just before it waits.
+    for (int i = 0; i < kSpinCount; ++i) {
+      CpuRelax();
+      if (TryEnterCriticalSection(&handle_))
+        return;
+    }
+    GetLockContention()->parked.fetch_add(1, std::memory_order_relaxed);
+    EnterCriticalSection(&handle_);
+  }
+
   CRITICAL_SECTION handle_;
+#elif PLATFORM_LINUX
+  void LockContended() {
+    GetLockContention()->contended.fetch_add(1, std::memory_order_relaxed);
+    for (int i = 0; i < kSpinCount; ++i) {
+      int32_t state = state_.load(std::memory_order_relaxed);
+      if (state == 0 &&
+          state_.compare_exchange_weak(state,
+                                       1,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+        return;
+      if (state == 2)
+        break;  // Others are already asleep, so join them.
+      CpuRelax();
+    }
+    // Taking it as 2 rather than 1 is conservative: the next Unlock() makes a
+    // wake call even if there's no one left to wake.
+    while (state_.exchange(2, std::memory_order_acquire) != 0) {
+      GetLockContention()->parked.fetch_add(1, std::memory_order_relaxed);
+      FutexWait(&state_, 2, -1.0);
+    }
+  }
+
+  std::atomic<int32_t> state_;
 #else
   pthread_mutex_t handle_;
 #endif
@@ -51,6 +205,90 @@ class ScopedFutex {
   Futex* futex_;
 };
 
+// --------------------------------------------------------------------------
+//
+// Condition variable.
+//
+// --------------------------------------------------------------------------
+
+class ConditionVariable {
+ public:
+#if PLATFORM_WINDOWS
+  ConditionVariable() { InitializeConditionVariable(&handle_); }
+  ~ConditionVariable() {}
+#elif PLATFORM_LINUX
+  ConditionVariable() : sequence_(0) {}
+  ~ConditionVariable() {}
+#else
+  ConditionVariable() { pthread_cond_init(&handle_, NULL); }
+  ~ConditionVariable() { pthread_cond_destroy(&handle_); }
+#endif
+
+  // |futex| must be held, and is held again on return. As with any condition
+  // variable, it can return without being signaled, so wait in a loop that
+  // checks the condition. If |seconds| isn't negative, returns false if that
+  // long passes without a signal.
+  bool Wait(Futex* futex, double seconds = -1.0) {
+#if PLATFORM_WINDOWS
+    DWORD milliseconds =
+        seconds < 0.0 ? INFINITE : static_cast<DWORD>(seconds * 1000.0);
+    return SleepConditionVariableCS(&handle_, &futex->handle_, milliseconds) !=
+           0;
+#elif PLATFORM_LINUX
+    // A Signal() between unlocking and sleeping changes |sequence_|, so the
+    // wait returns immediately rather than missing it.
+    int32_t sequence = sequence_.load(std::memory_order_relaxed);
+    futex->Unlock();
+    bool signaled = FutexWait(&sequence_, sequence, seconds);
+    futex->Lock();
+    return signaled;
+#else
+    if (seconds < 0.0)
+      return pthread_cond_wait(&handle_, &futex->handle_) == 0;
+    timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    int64_t nanoseconds =
+        deadline.tv_nsec + static_cast<int64_t>(seconds * 1e9);
+    deadline.tv_sec += static_cast<time_t>(nanoseconds / 1000000000);
+    deadline.tv_nsec = static_cast<long>(nanoseconds % 1000000000);  // NOLINT
+    return pthread_cond_timedwait(&handle_, &futex->handle_, &deadline) == 0;
+#endif
+  }
+
+  void Signal() {
+#if PLATFORM_WINDOWS
+    WakeConditionVariable(&handle_);
+#elif PLATFORM_LINUX
+    sequence_.fetch_add(1, std::memory_order_release);
+    FutexWake(&sequence_, 1);
+#else
+    pthread_cond_signal(&handle_);
+#endif
+  }
+
+  void Broadcast() {
+#if PLATFORM_WINDOWS
+    WakeAllConditionVariable(&handle_);
+#elif PLATFORM_LINUX
+    sequence_.fetch_add(1, std::memory_order_release);
+    FutexWake(&sequence_, INT32_MAX);
+#else
+    pthread_cond_broadcast(&handle_);
+#endif
+  }
+
+ private:
+#if PLATFORM_WINDOWS
+  CONDITION_VARIABLE handle_;
+#elif PLATFORM_LINUX
+  std::atomic<int32_t> sequence_;
+#else
+  pthread_cond_t handle_;
+#endif
+
+  DISALLOW_COPY_AND_ASSIGN(ConditionVariable);
+};
+
 // --------------------------------------------------------------------------
 //
 // Semaphore.
@@ -61,54 +299,54 @@ class ScopedFutex {
 
 #error "TODO: don't think sem_* works on OSX, need mutex+cond implementation."
 
-#elif PLATFORM_POSIX
+#elif PLATFORM_LINUX
 
 class Semaphore {
  public:
-  Semaphore() {
-    int32_t result = sem_init(&handle_, 0, 0);
-    CHECK(0 == result, "sem_init failed. errno %d", errno);
-    UNUSED(result);
-  }
-
-  ~Semaphore() {
-    int32_t result = sem_destroy(&handle_);
-    CHECK(0 == result, "sem_destroy failed. errno %d", errno);
-    UNUSED(result);
-  }
+  Semaphore() : count_(0), waiters_(0) {}
+  ~Semaphore() {}
 
   void Post(uint32_t count = 1) {
-    int32_t result;
-    for (uint32_t ii = 0; ii < count; ++ii) {
-      result = sem_post(&handle_);
-      CHECK(0 == result, "sem_post failed. errno %d", errno);
-    }
-    UNUSED(result);
+    count_.fetch_add(static_cast<int32_t>(count), std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_seq_cst) > 0)
+      FutexWake(&count_, static_cast<int32_t>(count));
   }
 
+  // Waits for up to |_msecs|, or indefinitely if negative, measured on the
+  // monotonic clock. Returns false if it timed out.
   bool Wait(int32_t _msecs = -1) {
-    if (0 > _msecs) {
-      int32_t result;
-      do {
-        result = sem_wait(&handle_);
-        // Keep waiting when interrupted by a signal handler...
-      } while (-1 == result && EINTR == errno);
-      CHECK(0 == result, "sem_wait failed. errno %d", errno);
-      return 0 == result;
+    int64_t deadline = GetHPCounter() + GetHPFrequency() * _msecs / 1000;
+    for (;;) {
+      int32_t count = count_.load(std::memory_order_relaxed);
+      while (count > 0) {
+        if (count_.compare_exchange_weak(count,
+                                         count - 1,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed))
+          return true;
+      }
+      double seconds = -1.0;
+      if (_msecs >= 0) {
+        int64_t remaining = deadline - GetHPCounter();
+        if (remaining <= 0)
+          return false;
+        seconds = static_cast<double>(remaining) /
+                  static_cast<double>(GetHPFrequency());
+      }
+      // Post() checks |waiters_| after incrementing |count_|, and the wait
+      // only sleeps if |count_| is still 0, so a post can't be missed.
+      waiters_.fetch_add(1, std::memory_order_seq_cst);
+      FutexWait(&count_, 0, seconds);
+      waiters_.fetch_sub(1, std::memory_order_seq_cst);
     }
-
-    timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    ts.tv_sec += _msecs / 1000;
-    ts.tv_nsec += (_msecs % 1000) * 1000;
-    return 0 == sem_timedwait(&handle_, &ts);
   }
 
  private:
   Semaphore(const Semaphore&);             // no copy constructor
   Semaphore& operator=(const Semaphore&);  // no assignment operator
 
-  sem_t handle_;
+  std::atomic<int32_t> count_;
+  std::atomic<int32_t> waiters_;
 };
 
 #elif PLATFORM_WINDOWS
@@ -140,6 +378,71 @@ class Semaphore {
 
 #endif
 
+// --------------------------------------------------------------------------
+//
+// Wake event.
+//
+// --------------------------------------------------------------------------
+
+// Lets any thread wake one waiting thread. Signals don't accumulate: any
+// number of Signal()s before a Wait() wake it once. Signal() only makes a
+// system call when the event goes from unsignaled to signaled, so it's cheap
+// to call for every item added to a queue.
+class WakeEvent {
+ public:
+#if PLATFORM_WINDOWS
+  WakeEvent() : signaled_(false) {
+    handle_ = CreateEvent(NULL, FALSE, FALSE, NULL);
+    CHECK(NULL != handle_, "Failed to create event!");
+  }
+  ~WakeEvent() { CloseHandle(handle_); }
+#else
+  WakeEvent() : signaled_(0) {}
+  ~WakeEvent() {}
+#endif
+
+  // Any thread.
+  void Signal() {
+#if PLATFORM_WINDOWS
+    if (!signaled_.exchange(true, std::memory_order_release))
+      SetEvent(handle_);
+#elif PLATFORM_LINUX
+    if (signaled_.exchange(1, std::memory_order_release) == 0)
+      FutexWake(&signaled_, 1);
+#endif
+  }
+
+  // One thread at a time. Returns once signaled, or after |seconds| if that's
+  // not negative. It may also return early, so the caller should check
+  // whatever it was waiting for again.
+  void Wait(double seconds) {
+#if PLATFORM_WINDOWS
+    if (signaled_.exchange(false, std::memory_order_acquire))
+      return;
+    DWORD milliseconds =
+        seconds < 0.0 ? INFINITE : static_cast<DWORD>(seconds * 1000.0);
+    WaitForSingleObject(handle_, milliseconds);
+    signaled_.store(false, std::memory_order_relaxed);
+#elif PLATFORM_LINUX
+    if (signaled_.exchange(0, std::memory_order_acquire) == 1)
+      return;
+    // Sleeps only if still unsignaled.
+    FutexWait(&signaled_, 0, seconds);
+    signaled_.exchange(0, std::memory_order_acquire);
+#endif
+  }
+
+ private:
+#if PLATFORM_WINDOWS
+  std::atomic<bool> signaled_;
+  HANDLE handle_;
+#else
+  std::atomic<int32_t> signaled_;
+#endif
+
+  DISALLOW_COPY_AND_ASSIGN(WakeEvent);
+};
+
 // --------------------------------------------------------------------------
 //
 // Thread.
@@ -263,4 +566,24 @@ class Thread {
   DISALLOW_COPY_AND_ASSIGN(Thread);
 };
 
+inline uint32_t GetNumberOfProcessors() {
+#if PLATFORM_WINDOWS
+  SYSTEM_INFO system_info;
+  GetSystemInfo(&system_info);
+  return system_info.dwNumberOfProcessors;
+#else
+  long result = sysconf(_SC_NPROCESSORS_ONLN);  // NOLINT(runtime/int)
+  return result > 0 ? static_cast<uint32_t>(result) : 1;
+#endif
+}
+
+// Gives up the rest of the time slice, e.g. while spinning on another thread.
+inline void YieldThread() {
+#if PLATFORM_WINDOWS
+  ::SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
 #endif  // THREADING_H_
@@ -0,0 +1,112 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mutex>
+
+#include "bench.h"
+#include "threading.h"
+
+// Futex against the standard library's mutex (a pthread mutex or SRW lock),
+// both uncontended and with several threads incrementing a shared counter.
+
+namespace {
+
+const int kContendingThreads = 4;
+
+template <class Mutex>
+struct ContendedState {
+  Mutex mutex;
+  int iterations_per_thread;
+  int64_t counter;
+};
+
+template <class Mutex>
+void LockMutex(Mutex* mutex);
+template <class Mutex>
+void UnlockMutex(Mutex* mutex);
+
+template <>
+void LockMutex(Futex* mutex) {
+  mutex->Lock();
+}
+template <>
+void UnlockMutex(Futex* mutex) {
+  mutex->Unlock();
+}
+template <>
+void LockMutex(std::mutex* mutex) {
+  mutex->lock();
+}
+template <>
+void UnlockMutex(std::mutex* mutex) {
+  mutex->unlock();
+}
+
+template <class Mutex>
+int32_t IncrementCounter(void* user_data) {
+  ContendedState<Mutex>* state =
+      reinterpret_cast<ContendedState<Mutex>*>(user_data);
+  for (int i = 0; i < state->iterations_per_thread; ++i) {
+    LockMutex(&state->mutex);
+    ++state->counter;
+    UnlockMutex(&state->mutex);
+  }
+  return 0;
+}
+
+int32_t WaitForSemaphore(void* user_data) {
+  reinterpret_cast<Semaphore*>(user_data)->Wait();
+  return 0;
+}
+
+// glibc skips the bus lock while the process has only one thread, which no
+// process using a mutex would, so another thread is kept waiting meanwhile.
+template <class Mutex>
+void Uncontended(int iterations) {
+  Semaphore done;
+  Thread idle;
+  idle.Init(WaitForSemaphore, &done);
+  Mutex mutex;
+  volatile int64_t counter = 0;
+  for (int i = 0; i < iterations; ++i) {
+    LockMutex(&mutex);
+    counter = counter + 1;
+    UnlockMutex(&mutex);
+  }
+  done.Post();
+  idle.Shutdown();
+}
+
+// |iterations| lock/unlock pairs in total, split between the threads.
+template <class Mutex>
+void Contended(int iterations) {
+  ContendedState<Mutex> state;
+  state.iterations_per_thread = iterations / kContendingThreads + 1;
+  state.counter = 0;
+  Thread threads[kContendingThreads];
+  for (int i = 0; i < kContendingThreads; ++i)
+    threads[i].Init(IncrementCounter<Mutex>, &state);
+  for (int i = 0; i < kContendingThreads; ++i)
+    threads[i].Shutdown();
+  CHECK(state.counter ==
+        static_cast<int64_t>(state.iterations_per_thread) * kContendingThreads);
+}
+
+}  // namespace
+
+BENCHMARK(Futex_Uncontended) {
+  Uncontended<Futex>(iterations);
+}
+
+BENCHMARK(StdMutex_Uncontended) {
+  Uncontended<std::mutex>(iterations);
+}
+
+BENCHMARK(Futex_Contended) {
+  Contended<Futex>(iterations);
+}
+
+BENCHMARK(StdMutex_Contended) {
+  Contended<std::mutex>(iterations);
+}
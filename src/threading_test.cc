@@ -0,0 +1,126 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "threading.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+double Now() {
+  return static_cast<double>(GetHPCounter()) /
+         static_cast<double>(GetHPFrequency());
+}
+
+const int kThreads = 4;
+const int kIncrementsPerThread = 10000;
+
+struct CounterState {
+  Futex lock;
+  int counter;
+};
+
+int32_t IncrementCounter(void* user_data) {
+  CounterState* state = reinterpret_cast<CounterState*>(user_data);
+  for (int i = 0; i < kIncrementsPerThread; ++i) {
+    ScopedFutex lock(&state->lock);
+    ++state->counter;
+  }
+  return 0;
+}
+
+struct HandOffState {
+  Futex lock;
+  ConditionVariable changed;
+  int value;
+};
+
+// Waits for each value in turn and replies with the next one.
+int32_t PingPong(void* user_data) {
+  HandOffState* state = reinterpret_cast<HandOffState*>(user_data);
+  ScopedFutex lock(&state->lock);
+  for (int expected = 1; expected < 100; expected += 2) {
+    while (state->value != expected)
+      state->changed.Wait(&state->lock);
+    state->value = expected + 1;
+    state->changed.Broadcast();
+  }
+  return 0;
+}
+
+struct SemaphoreState {
+  Semaphore semaphore;
+  std::atomic<int> acquired;
+};
+
+int32_t AcquireOnce(void* user_data) {
+  SemaphoreState* state = reinterpret_cast<SemaphoreState*>(user_data);
+  state->semaphore.Wait();
+  state->acquired.fetch_add(1);
+  return 0;
+}
+
+}  // namespace
+
+TEST(FutexTest, MutualExclusion) {
+  CounterState state;
+  state.counter = 0;
+  Thread threads[kThreads];
+  for (int i = 0; i < kThreads; ++i)
+    threads[i].Init(IncrementCounter, &state);
+  for (int i = 0; i < kThreads; ++i)
+    threads[i].Shutdown();
+  EXPECT_EQ(kThreads * kIncrementsPerThread, state.counter);
+}
+
+TEST(ConditionVariableTest, HandOff) {
+  HandOffState state;
+  state.value = 0;
+  Thread thread;
+  thread.Init(PingPong, &state);
+  {
+    ScopedFutex lock(&state.lock);
+    for (int next = 1; next < 100; next += 2) {
+      state.value = next;
+      state.changed.Broadcast();
+      while (state.value != next + 1)
+        state.changed.Wait(&state.lock);
+    }
+  }
+  thread.Shutdown();
+  EXPECT_EQ(100, state.value);
+}
+
+TEST(ConditionVariableTest, TimedWaitTimesOut) {
+  Futex lock;
+  ConditionVariable never_signaled;
+  ScopedFutex hold(&lock);
+  double start = Now();
+  // Spurious wakeups are allowed, so wait until it reports a timeout.
+  while (never_signaled.Wait(&lock, 0.02)) {
+  }
+  EXPECT_GE(Now() - start, 0.015);
+}
+
+TEST(SemaphoreTest, PostReleasesWaiters) {
+  SemaphoreState state;
+  state.acquired = 0;
+  Thread threads[kThreads];
+  for (int i = 0; i < kThreads; ++i)
+    threads[i].Init(AcquireOnce, &state);
+  state.semaphore.Post(kThreads);
+  for (int i = 0; i < kThreads; ++i)
+    threads[i].Shutdown();
+  EXPECT_EQ(kThreads, state.acquired.load());
+}
+
+TEST(SemaphoreTest, TimedWait) {
+  Semaphore semaphore;
+  double start = Now();
+  EXPECT_FALSE(semaphore.Wait(20));
+  EXPECT_GE(Now() - start, 0.015);
+  semaphore.Post();
+  EXPECT_TRUE(semaphore.Wait(0));
+  EXPECT_FALSE(semaphore.Wait(0));
+}
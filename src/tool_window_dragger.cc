@@ -17,8 +17,8 @@
 namespace {
 
 float kDetachedScale = 0.8f;
-#if 0
 float kHoveringAlpha = 0.75f;
+#if 0
 float kDropTargetAlpha = 0.6f;
 #endif
 
@@ -207,24 +207,13 @@ void ToolWindowDragger::CancelDrag() {
 }
 
 void ToolWindowDragger::Render() {
-// TODO(scottmg): nanovg doesn't currently support render to texture
-// https://github.com/memononen/nanovg/issues/90 so we just do simple
-// outline box for now.
-#if 0  // R-T-T
-  // TODO(rendering): Not much practical reason to re-render this every frame
-  // during drag. Investigate if it makes anything snappier if it's cached
-  // after the first render.
-  scoped_ptr<RenderToTextureRenderer> render_to_texture_renderer(
-      renderer->CreateRenderToTextureRenderer(dragging_->GetScreenRect().w,
-        dragging_->GetScreenRect().h));
-  dragging_->Render(render_to_texture_renderer.get());
-#endif
-
   for (const auto& dti : targets_)
     GfxDrawIcon(dti.icon, dti.rect, .7f);
 
   Rect draw_rect;
   if (on_drop_target_) {
+    // Already in the tree, so it was drawn at its docked position along with
+    // everything else.
     draw_rect = dragging_->GetScreenRect();
   } else {
     Point draw_at =
@@ -233,18 +222,9 @@ void ToolWindowDragger::Render() {
                      draw_at.y,
                      dragging_->GetClientRect().w * kDetachedScale,
                      dragging_->GetClientRect().h * kDetachedScale);
+    // The window's size doesn't change while it's floating, so this is a
+    // scaled composite of its cached layer, not a re-render.
+    dragging_->RenderToRect(draw_rect, kHoveringAlpha);
   }
-#if 0  // R-T-T
-  renderer->DrawRenderToTextureResult(
-      render_to_texture_renderer.get(),
-      draw_rect,
-      kHoveringAlpha,
-      0.f, 0.f, 1.f, 1.f);
-  renderer->SetDrawColor(Color(0, 128, 128, kHoveringAlpha * 128));
-  renderer->DrawFilledRect(draw_rect);
-#else
-  DrawSolidRect(draw_rect, Color(1, 1, 1, .25f));
-#endif
-
-  // TODO(scottmg): Workspace::Invalidate();
+  DrawSolidRect(draw_rect, Color(0.f, .5f, .5f, kHoveringAlpha * .5f));
 }
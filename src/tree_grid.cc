@@ -4,18 +4,63 @@
 
 #include "tree_grid.h"
 
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <algorithm>
+#include <atomic>
+#include <map>
+#include <unordered_set>
 
 #include "gfx.h"
 #include "draggable.h"
 #include "focus.h"
+#include "frame_scheduler.h"
+#include "object_pool.h"
 #include "skin.h"
+#include "task_scheduler.h"
 #include "text_edit.h"
+#include "text_width.h"
 
 namespace {
+
 const float kTextPadding = 3;
+// TODO(scottmg): Should be something font-related.
+const float kMarginWidth = 22;
+const float kHeaderHeight = kMarginWidth;
+// TODO(scottmg): Wrong height, just happens to be about right.
+const float kRowHeight = kMarginWidth;
+
+// Children of nodes with a provider are created this many at a time.
+const size_t kLazyPageSize = 256;
+
+// Fitting a column to its values samples this many rows at first, then twice
+// as many each round up to the maximum, for at most this many rounds.
+const int kAutoSizeFirstSample = 128;
+const int kAutoSizeMaxSample = 2048;
+const int kAutoSizeMaxRounds = 8;
+// Sampled cells are measured in chunks of this many on each worker.
+const size_t kAutoSizeChunkSize = 256;
+
+// Presses on a splitter closer together than this are a double click.
+const double kDoubleClickTime = 0.5;
+
+// Never destroyed, as nodes may outlive static destructors.
+ObjectPool<TreeGridNode>* GetNodePool() {
+  static ObjectPool<TreeGridNode>* pool = new ObjectPool<TreeGridNode>;
+  return pool;
+}
+
+ObjectPool<TreeGridNodeValueString>* GetStringValuePool() {
+  static ObjectPool<TreeGridNodeValueString>* pool =
+      new ObjectPool<TreeGridNodeValueString>;
+  return pool;
 }
 
+}  // namespace
+
 TreeGridNodeValue::~TreeGridNodeValue() {
 }
 
@@ -24,26 +69,162 @@ TreeGridNodeValueString::TreeGridNodeValueString(const std::string& value)
     : value_(value) {
 }
 
-void TreeGridNodeValueString::Render(const Rect& rect) const {
-  const ColorScheme& cs = Skin::current().GetColorScheme();
-  DrawTextInRect(Font::kUI, rect, value_.c_str(), cs.text(), kTextPadding);
+void TreeGridNodeValueString::Render(const Rect& rect,
+                                     const Color& color) const {
+  std::string text =
+      prefix_widths_.Elide(Font::kUI, value_, rect.w - 2 * kTextPadding);
+  DrawTextInRect(Font::kUI, rect, text, color, kTextPadding);
+}
+
+// Subclasses are bigger than a block, so they use the global heap.
+void* TreeGridNodeValueString::operator new(size_t size) {
+  if (size != sizeof(TreeGridNodeValueString))
+    return ::operator new(size);
+  return GetStringValuePool()->Allocate();
+}
+
+void TreeGridNodeValueString::operator delete(void* ptr, size_t size) {
+  if (size != sizeof(TreeGridNodeValueString))
+    ::operator delete(ptr);
+  else
+    GetStringValuePool()->Free(ptr);
+}
+
+// --------------------------------------------------------------------
+TreeGridNodeValuePending::TreeGridNodeValuePending(const std::string& key)
+    : key_(key), has_previous_(false) {
+}
+
+void TreeGridNodeValuePending::Render(const Rect& rect,
+                                      const Color& color) const {
+  DrawTextInRect(Font::kUI, rect, "...", color, kTextPadding);
 }
 
 // --------------------------------------------------------------------
+struct TreeGridNode::LazyChildren {
+  explicit LazyChildren(TreeGridNodeProvider* provider)
+      : provider(provider), count(-1) {}
+  ~LazyChildren() {
+    for (const auto& page : pages) {
+      for (TreeGridNode* child : page.second)
+        delete child;
+    }
+  }
+
+  // A created child whose subtree takes more than its own row, and the rows
+  // the subtree takes, counting from the first child's row.
+  struct ExpandedChild {
+    size_t index;
+    int start_row;
+    int end_row;
+  };
+
+  TreeGridNodeProvider* provider;
+  // -1 until first asked for.
+  int count;
+  // The children that have been created, by page.
+  std::map<size_t, std::vector<TreeGridNode*>> pages;
+  // In order of index. Updated by UpdateVisibleRows().
+  std::vector<ExpandedChild> expanded;
+};
+
+// --------------------------------------------------------------------
+// A copy of the top-level nodes' values, so that the view can be calculated
+// on a worker without touching the tree.
+struct TreeGrid::ViewSnapshot {
+  // Only compared, on the main thread, as they may be deleted.
+  std::vector<const TreeGridNode*> nodes;
+  // Each node's text in each column, or empty if it has no value.
+  std::vector<std::string> columns[TreeGridNode::kMaxColumns];
+  int num_columns;
+};
+
+struct TreeGrid::ViewJob {
+  ViewJob() : cancelled(false), done(false) {}
+
+  std::shared_ptr<const ViewSnapshot> snapshot;
+  uint32_t nodes_generation;
+  int sort_column;
+  bool sort_ascending;
+  // Lower case.
+  std::string filter;
+  TreeGrid* tree_grid;
+
+  std::atomic<bool> cancelled;
+  std::atomic<bool> done;
+  // Indices of the nodes to show, in order. Valid once |done|.
+  std::vector<uint32_t> rows;
+};
+
+struct TreeGrid::AutoSizeJob {
+  AutoSizeJob() : cancelled(false), done(false), width(0.f) {}
+
+  int column;
+  int round;
+  // The number of rows sampled by this round and the ones before.
+  int rows_sampled;
+  // The widest cell found by the rounds before.
+  float previous_width;
+  TreeGrid* tree_grid;
+  // The sampled cells' text, and the space each needs besides its text.
+  std::vector<std::string> texts;
+  std::vector<float> offsets;
+
+  std::atomic<bool> cancelled;
+  std::atomic<bool> done;
+  // The widest of the cells. Valid once |done|.
+  float width;
+};
+
+struct TreeGrid::FormatRequest {
+  FormatRequest() : cancelled(false), done(false) {}
+
+  std::string key;
+  TreeGridValueFormatter* formatter;
+  TreeGrid* tree_grid;
+  std::atomic<bool> cancelled;
+  std::atomic<bool> done;
+  // Written before |done| is set.
+  std::string text;
+};
+
+// --------------------------------------------------------------------
+// static
+const int TreeGridNode::kMaxColumns;
+
 TreeGridNode::TreeGridNode(TreeGrid* tree_grid, TreeGridNode* parent)
     : tree_grid_(tree_grid),
       parent_(parent),
       expanded_(false),
-      selected_(false) {
+      selected_(false),
+      view_(NULL),
+      values_(),
+      changed_columns_(0),
+      changed_generation_(0),
+      index_in_parent_(0),
+      child_indices_dirty_(false),
+      visible_rows_dirty_(true),
+      visible_rows_(1) {
 }
 
 TreeGridNode::~TreeGridNode() {
-  for (std::map<int, TreeGridNodeValue*>::iterator i(items_.begin());
-       i != items_.end();
-       ++i) {
-    delete i->second;
-  }
-  // TODO(scottmg): nodes_ cleanup.
+  for (TreeGridNodeValue* value : values_)
+    delete value;
+  for (TreeGridNode* node : nodes_)
+    delete node;
+}
+
+void* TreeGridNode::operator new(size_t size) {
+  if (size != sizeof(TreeGridNode))
+    return ::operator new(size);
+  return GetNodePool()->Allocate();
+}
+
+void TreeGridNode::operator delete(void* ptr, size_t size) {
+  if (size != sizeof(TreeGridNode))
+    ::operator delete(ptr);
+  else
+    GetNodePool()->Free(ptr);
 }
 
 const std::vector<TreeGridNode*>* TreeGridNode::Nodes() const {
@@ -51,21 +232,434 @@ const std::vector<TreeGridNode*>* TreeGridNode::Nodes() const {
 }
 
 std::vector<TreeGridNode*>* TreeGridNode::Nodes() {
+  InvalidateVisibleRows(false);
+  child_indices_dirty_ = true;
   return &nodes_;
 }
 
+void TreeGridNode::SetProvider(TreeGridNodeProvider* provider) {
+  DCHECK(nodes_.empty(), "can't have both Nodes() and a provider");
+  if (lazy_ && tree_grid_) {
+    // Don't leave focus on a child that's about to be deleted.
+    for (const TreeGridNode* node = tree_grid_->focused_node_; node;
+         node = node->parent_) {
+      if (node->parent_ == this) {
+        tree_grid_->focused_node_ = this;
+        break;
+      }
+    }
+  }
+  lazy_.reset(provider ? new LazyChildren(provider) : NULL);
+  InvalidateVisibleRows(false);
+}
+
+void TreeGridNode::SetExpanded(bool expanded) {
+  if (expanded == expanded_)
+    return;
+  expanded_ = expanded;
+  InvalidateVisibleRows(true);
+}
+
+size_t TreeGridNode::NumChildren() {
+  if (!lazy_)
+    return Children().size();
+  if (lazy_->count < 0)
+    lazy_->count = std::max(0, lazy_->provider->GetChildCount(this));
+  return static_cast<size_t>(lazy_->count);
+}
+
+TreeGridNode* TreeGridNode::GetChild(size_t index) {
+  if (!lazy_)
+    return Children()[index];
+  DCHECK(index < NumChildren(), "child out of range");
+  size_t page_index = index / kLazyPageSize;
+  std::vector<TreeGridNode*>& page = lazy_->pages[page_index];
+  if (page.empty()) {
+    size_t first = page_index * kLazyPageSize;
+    size_t last = std::min(first + kLazyPageSize, NumChildren());
+    page.reserve(last - first);
+    for (size_t i = first; i < last; ++i)
+      page.push_back(CreateLazyChild(i));
+  }
+  return page[index % kLazyPageSize];
+}
+
+TreeGridNode* TreeGridNode::CreateLazyChild(size_t index) {
+  TreeGridNode* child = new TreeGridNode(tree_grid_, this);
+  child->index_in_parent_ = index;
+  lazy_->provider->PopulateChild(this, static_cast<int>(index), child);
+  return child;
+}
+
+TreeGridNode* TreeGridNode::GetChildIfCreated(size_t index) {
+  if (!lazy_)
+    return Children()[index];
+  std::map<size_t, std::vector<TreeGridNode*>>::iterator it =
+      lazy_->pages.find(index / kLazyPageSize);
+  if (it == lazy_->pages.end() || it->second.empty())
+    return NULL;
+  return it->second[index % kLazyPageSize];
+}
+
+int TreeGridNode::IndexOfChild(const TreeGridNode* child) {
+  const std::vector<TreeGridNode*>& children = Children();
+  if (child_indices_dirty_) {
+    for (size_t i = 0; i < children.size(); ++i)
+      children[i]->index_in_parent_ = i;
+    child_indices_dirty_ = false;
+  }
+  size_t index = child->index_in_parent_;
+  if (lazy_)
+    return child->parent_ == this ? static_cast<int>(index) : -1;
+  // Nodes that have been removed, or filtered out of the view, may have a
+  // stale index.
+  if (index >= children.size() || children[index] != child)
+    return -1;
+  return static_cast<int>(index);
+}
+
+TreeGridNode* TreeGridNode::ParentOrRoot() {
+  if (parent_)
+    return parent_;
+  if (tree_grid_ && this != &tree_grid_->root_)
+    return &tree_grid_->root_;
+  return NULL;
+}
+
+TreeGridNode* TreeGridNode::ParentForChildren() {
+  return tree_grid_ && this == &tree_grid_->root_ ? NULL : this;
+}
+
+void TreeGridNode::InvalidateVisibleRows(bool count_changed) {
+  visible_rows_dirty_ = true;
+  // A collapsed node takes one row whatever its children, so nothing above
+  // one is affected.
+  if (count_changed || expanded_) {
+    for (TreeGridNode* node = ParentOrRoot(); node;
+         node = node->expanded_ ? node->ParentOrRoot() : NULL) {
+      node->visible_rows_dirty_ = true;
+    }
+  }
+  if (tree_grid_)
+    tree_grid_->InvalidateLayout();
+}
+
+int TreeGridNode::UpdateVisibleRows() {
+  if (!visible_rows_dirty_)
+    return visible_rows_;
+  // Children that are hidden are left dirty until they're shown again.
+  child_row_ends_.clear();
+  if (lazy_)
+    lazy_->expanded.clear();
+  int rows = 0;
+  if (expanded_ && lazy_) {
+    // Children that haven't been created yet take a row each, so only those
+    // that have need to be looked at.
+    rows = static_cast<int>(NumChildren());
+    int extra_rows = 0;
+    for (const auto& page : lazy_->pages) {
+      for (TreeGridNode* child : page.second) {
+        int child_rows = child->UpdateVisibleRows();
+        if (child_rows == 1)
+          continue;
+        LazyChildren::ExpandedChild expanded;
+        expanded.index = child->index_in_parent_;
+        expanded.start_row = static_cast<int>(expanded.index) + extra_rows;
+        extra_rows += child_rows - 1;
+        expanded.end_row = static_cast<int>(expanded.index) + 1 + extra_rows;
+        lazy_->expanded.push_back(expanded);
+      }
+    }
+    rows += extra_rows;
+  } else if (expanded_) {
+    child_row_ends_.reserve(Children().size());
+    for (TreeGridNode* child : Children()) {
+      rows += child->UpdateVisibleRows();
+      child_row_ends_.push_back(rows);
+    }
+  }
+  visible_rows_ = 1 + rows;
+  visible_rows_dirty_ = false;
+  return visible_rows_;
+}
+
+size_t TreeGridNode::ChildAtRow(int row, int* child_row) const {
+  if (!lazy_) {
+    const std::vector<int>& ends = child_row_ends_;
+    size_t index =
+        std::upper_bound(ends.begin(), ends.end(), row) - ends.begin();
+    *child_row = index == 0 ? 0 : ends[index - 1];
+    return index;
+  }
+
+  // Find the last expanded child that starts at or before |row|. Between
+  // expanded children, each child takes one row.
+  const std::vector<LazyChildren::ExpandedChild>& expanded = lazy_->expanded;
+  std::vector<LazyChildren::ExpandedChild>::const_iterator it =
+      std::upper_bound(expanded.begin(),
+                       expanded.end(),
+                       row,
+                       [](int row, const LazyChildren::ExpandedChild& child) {
+                         return row < child.start_row;
+                       });
+  if (it == expanded.begin()) {
+    *child_row = row;
+    return static_cast<size_t>(row);
+  }
+  --it;
+  if (row < it->end_row) {
+    *child_row = it->start_row;
+    return it->index;
+  }
+  *child_row = row;
+  return it->index + 1 + (row - it->end_row);
+}
+
+int TreeGridNode::RowOfChild(size_t index) const {
+  if (!lazy_)
+    return index == 0 ? 0 : child_row_ends_[index - 1];
+
+  const std::vector<LazyChildren::ExpandedChild>& expanded = lazy_->expanded;
+  std::vector<LazyChildren::ExpandedChild>::const_iterator it =
+      std::lower_bound(expanded.begin(),
+                       expanded.end(),
+                       index,
+                       [](const LazyChildren::ExpandedChild& child,
+                          size_t index) { return child.index < index; });
+  if (it != expanded.end() && it->index == index)
+    return it->start_row;
+  if (it == expanded.begin())
+    return static_cast<int>(index);
+  --it;
+  return it->end_row + static_cast<int>(index - it->index - 1);
+}
+
 void TreeGridNode::SetValue(int column, TreeGridNodeValue* value) {
-  std::map<int, TreeGridNodeValue*>::iterator i = items_.find(column);
-  if (i != items_.end())
-    delete i->second;
-  items_[column] = value;
+  CHECK(column >= 0 && column < kMaxColumns, "column %d out of range", column);
+  delete values_[column];
+  values_[column] = value;
 }
 
 const TreeGridNodeValue* TreeGridNode::GetValue(int column) const {
-  std::map<int, TreeGridNodeValue*>::const_iterator i = items_.find(column);
-  if (i == items_.end())
+  if (column < 0 || column >= kMaxColumns)
     return NULL;
-  return i->second;
+  return values_[column];
+}
+
+bool TreeGridNode::UpdateValue(int column, TreeGridNodeValue* value) {
+  CHECK(column >= 0 && column < kMaxColumns, "column %d out of range", column);
+  TreeGridNodeValue* old_value = values_[column];
+  if (TreeGridNodeValuePending* pending = value ? value->AsPending() : NULL) {
+    TreeGridNodeValuePending* old_pending =
+        old_value ? old_value->AsPending() : NULL;
+    if (old_pending && old_pending->key() == pending->key()) {
+      delete value;
+      return false;
+    }
+    // Compared with the old text once it's formatted instead.
+    if (old_value && !old_pending) {
+      pending->has_previous_ = true;
+      pending->previous_ = old_value->AsString();
+    } else if (old_pending) {
+      pending->has_previous_ = old_pending->has_previous_;
+      pending->previous_ = old_pending->previous_;
+    }
+    delete old_value;
+    values_[column] = value;
+    return false;
+  }
+  if (old_value && value && old_value->AsString() == value->AsString()) {
+    delete value;
+    return false;
+  }
+  if (!old_value && !value)
+    return false;
+  delete old_value;
+  values_[column] = value;
+  MarkChanged(column);
+  return true;
+}
+
+bool TreeGridNode::ValueChanged(int column) const {
+  if (!tree_grid_ || column < 0 || column >= kMaxColumns)
+    return false;
+  return changed_generation_ == tree_grid_->update_generation_ &&
+         (changed_columns_ & (1u << column)) != 0;
+}
+
+void TreeGridNode::MarkChanged(int column) {
+  if (!tree_grid_)
+    return;
+  if (changed_generation_ != tree_grid_->update_generation_) {
+    changed_generation_ = tree_grid_->update_generation_;
+    changed_columns_ = 0;
+  }
+  changed_columns_ |= 1u << column;
+}
+
+void TreeGridNode::SetFormattedValue(int column, const std::string& text) {
+  TreeGridNodeValuePending* pending = values_[column]->AsPending();
+  DCHECK(pending, "no pending value in column %d", column);
+  bool changed = pending->has_previous_ && pending->previous_ != text;
+  SetValue(column, new TreeGridNodeValueString(text));
+  if (changed)
+    MarkChanged(column);
+}
+
+std::string TreeGridNode::Key() const {
+  return values_[0] ? values_[0]->AsString() : std::string();
+}
+
+void TreeGridNode::TakeFocusFrom(const TreeGridNode* child) {
+  if (!tree_grid_)
+    return;
+  for (const TreeGridNode* node = tree_grid_->focused_node_; node;
+       node = node->parent_) {
+    if (node == child) {
+      tree_grid_->focused_node_ = ParentForChildren();
+      return;
+    }
+  }
+}
+
+void TreeGridNode::Adopt(TreeGrid* tree_grid, TreeGridNode* parent) {
+  tree_grid_ = tree_grid;
+  parent_ = parent;
+  for (TreeGridNode* child : nodes_)
+    child->Adopt(tree_grid, this);
+  if (lazy_) {
+    for (const auto& page : lazy_->pages) {
+      for (TreeGridNode* child : page.second)
+        child->Adopt(tree_grid, this);
+    }
+  }
+}
+
+void TreeGridNode::MergeFrom(TreeGridNode* fresh) {
+  for (int i = 0; i < kMaxColumns; ++i) {
+    UpdateValue(i, fresh->values_[i]);
+    fresh->values_[i] = NULL;
+  }
+
+  if (fresh->lazy_) {
+    TreeGridNodeProvider* provider = fresh->lazy_->provider;
+    if (lazy_) {
+      MergeLazyChildrenFrom(provider);
+      return;
+    }
+    for (TreeGridNode* child : nodes_) {
+      TakeFocusFrom(child);
+      delete child;
+    }
+    nodes_.clear();
+    SetProvider(provider);
+    return;
+  }
+
+  if (lazy_)
+    SetProvider(NULL);
+  MergeChildrenFrom(fresh);
+}
+
+void TreeGridNode::MergeChildrenFrom(TreeGridNode* fresh) {
+  std::vector<TreeGridNode*> old_children;
+  old_children.swap(nodes_);
+  std::vector<TreeGridNode*> fresh_children;
+  fresh_children.swap(fresh->nodes_);
+  bool structure_changed = old_children.size() != fresh_children.size();
+
+  // Usually the children are the same as last time, in the same order, so
+  // they're matched by position until one doesn't match, and then by key.
+  // Keys may be repeated, in which case they're matched in order.
+  std::multimap<std::string, size_t> unmatched;
+  bool match_by_key = false;
+  nodes_.reserve(fresh_children.size());
+  for (size_t i = 0; i < fresh_children.size(); ++i) {
+    TreeGridNode* fresh_child = fresh_children[i];
+    std::string key = fresh_child->Key();
+    TreeGridNode* match = NULL;
+    if (!match_by_key && i < old_children.size() &&
+        old_children[i]->Key() == key) {
+      match = old_children[i];
+      old_children[i] = NULL;
+    } else {
+      if (!match_by_key) {
+        for (size_t j = i; j < old_children.size(); ++j)
+          unmatched.insert(std::make_pair(old_children[j]->Key(), j));
+        match_by_key = true;
+        structure_changed = true;
+      }
+      std::multimap<std::string, size_t>::iterator it =
+          unmatched.lower_bound(key);
+      if (it != unmatched.end() && it->first == key) {
+        match = old_children[it->second];
+        old_children[it->second] = NULL;
+        unmatched.erase(it);
+      }
+    }
+
+    if (match) {
+      match->MergeFrom(fresh_child);
+      delete fresh_child;
+      nodes_.push_back(match);
+    } else {
+      fresh_child->Adopt(tree_grid_, ParentForChildren());
+      nodes_.push_back(fresh_child);
+      structure_changed = true;
+    }
+  }
+
+  for (TreeGridNode* old_child : old_children) {
+    if (!old_child)
+      continue;
+    TakeFocusFrom(old_child);
+    delete old_child;
+  }
+
+  if (structure_changed) {
+    child_indices_dirty_ = true;
+    InvalidateVisibleRows(false);
+  }
+}
+
+void TreeGridNode::MergeLazyChildrenFrom(TreeGridNodeProvider* provider) {
+  lazy_->provider = provider;
+  // If the count hasn't been asked for, no children have been created.
+  if (lazy_->count < 0)
+    return;
+  int old_count = lazy_->count;
+  lazy_->count = -1;
+  size_t count = NumChildren();
+
+  std::map<size_t, std::vector<TreeGridNode*>>::iterator it =
+      lazy_->pages.begin();
+  while (it != lazy_->pages.end()) {
+    std::vector<TreeGridNode*>& page = it->second;
+    size_t first = it->first * kLazyPageSize;
+    size_t last = std::max(first, std::min(first + kLazyPageSize, count));
+    while (first + page.size() > last) {
+      TakeFocusFrom(page.back());
+      delete page.back();
+      page.pop_back();
+    }
+    for (size_t i = 0; i < page.size(); ++i) {
+      // Populated outside the tree, so that it doesn't invalidate anything.
+      TreeGridNode fresh(NULL, NULL);
+      provider->PopulateChild(this, static_cast<int>(first + i), &fresh);
+      page[i]->MergeFrom(&fresh);
+    }
+    // The last page grows if the count did.
+    for (size_t i = first + page.size(); i < last; ++i)
+      page.push_back(CreateLazyChild(i));
+
+    if (page.empty())
+      it = lazy_->pages.erase(it);
+    else
+      ++it;
+  }
+
+  if (static_cast<int>(count) != old_count)
+    InvalidateVisibleRows(false);
 }
 
 // --------------------------------------------------------------------
@@ -75,6 +669,7 @@ TreeGridColumn::TreeGridColumn(TreeGrid* tree_grid, const std::string& caption)
 
 void TreeGridColumn::SetWidthPercentage(float fraction) {
   width_fraction_ = fraction;
+  tree_grid_->InvalidateLayout();
 }
 
 void TreeGridColumn::SetPercentageToMatchWidth(float width, float whole_width) {
@@ -106,6 +701,7 @@ void TreeGridColumn::SetPercentageToMatchWidth(float width, float whole_width) {
   tree_grid_->Columns()->at(self_index + 1)->width_fraction_ =
       column_widths[self_index + 1] / two_column_total_width *
       two_column_total_fraction;
+  tree_grid_->InvalidateLayout();
 }
 
 void TreeGridColumn::SetPercentageToMatchPosition(float splitter_position,
@@ -141,26 +737,764 @@ class ReadOnlyTreeGridEditObserver : public TreeGridEditObserver {
 
 // --------------------------------------------------------------------
 TreeGrid::TreeGrid()
-    : focused_node_(NULL), edit_observer_(new ReadOnlyTreeGridEditObserver) {
+    : focused_node_(NULL),
+      edit_observer_(new ReadOnlyTreeGridEditObserver),
+      root_(this, NULL),
+      scroll_(this, kRowHeight),
+      layout_valid_(false),
+      update_generation_(0),
+      sort_column_(-1),
+      sort_ascending_(true),
+      nodes_generation_(0),
+      view_stale_(false),
+      last_splitter_pressed_(-1),
+      last_splitter_press_time_(0.0),
+      formatter_(NULL) {
+  root_.SetExpanded(true);
 }
 
 TreeGrid::~TreeGrid() {
+  if (view_job_)
+    view_job_->cancelled.store(true, std::memory_order_relaxed);
+  if (auto_size_job_)
+    auto_size_job_->cancelled.store(true, std::memory_order_relaxed);
+  CancelFormatRequests();
+  if (tasks_ && !tasks_->IsDone())
+    TaskScheduler::Get()->Wait(tasks_.get());
+  // The nodes are deleted by |root_|.
+  for (TreeGridColumn* column : columns_)
+    delete column;
 }
 
 std::vector<TreeGridNode*>* TreeGrid::Nodes() {
-  return &nodes_;
+  NodesWillChange();
+  return root_.Nodes();
+}
+
+void TreeGrid::UpdateNodes(std::vector<TreeGridNode*>* nodes) {
+  ++update_generation_;
+  NodesWillChange();
+  TreeGridNode fresh(NULL, NULL);
+  fresh.nodes_.swap(*nodes);
+  root_.MergeChildrenFrom(&fresh);
+  // Only the layout of rows that were added or removed is invalidated, but
+  // any of the values might be in view.
+  Invalidate();
+}
+
+void TreeGrid::NodesWillChange() {
+  ++nodes_generation_;
+  view_snapshot_.reset();
+  if (sort_column_ < 0 && filter_.empty())
+    return;
+  // The view may refer to nodes that are about to be deleted, so it isn't
+  // used again until UpdateView() has checked it against the new nodes.
+  SetView(NULL);
+  view_stale_ = true;
+}
+
+// --------------------------------------------------------------------
+namespace {
+
+// Rows are filtered and sorted in chunks of this many on each worker.
+const size_t kViewChunkSize = 4096;
+
+bool EqualsIgnoringCase(const char* a, const char* lower_b, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (tolower(static_cast<unsigned char>(a[i])) != lower_b[i])
+      return false;
+  }
+  return true;
+}
+
+// Whether |text| contains |needle|, which is lower case, ignoring ASCII case.
+// Most of the scanning is memchr() for the first character of the needle in
+// either case, which the C library vectorizes.
+bool ContainsIgnoringCase(const std::string& text, const std::string& needle) {
+  if (needle.empty())
+    return true;
+  if (text.size() < needle.size())
+    return false;
+  char lower = needle[0];
+  char upper = static_cast<char>(toupper(static_cast<unsigned char>(lower)));
+  const char* p = text.data();
+  // The last position the needle could start at, plus one.
+  const char* end = text.data() + text.size() - needle.size() + 1;
+  while (p < end) {
+    const char* candidate =
+        reinterpret_cast<const char*>(memchr(p, lower, end - p));
+    if (upper != lower) {
+      const char* upper_end = candidate ? candidate : end;
+      if (const char* upper_candidate = reinterpret_cast<const char*>(
+              memchr(p, upper, upper_end - p))) {
+        candidate = upper_candidate;
+      }
+    }
+    if (!candidate)
+      return false;
+    if (EqualsIgnoringCase(candidate + 1, &needle[1], needle.size() - 1))
+      return true;
+    p = candidate + 1;
+  }
+  return false;
+}
+
+int CompareIgnoringCase(const std::string& a, const std::string& b) {
+  size_t length = std::min(a.size(), b.size());
+  for (size_t i = 0; i < length; ++i) {
+    int ca = tolower(static_cast<unsigned char>(a[i]));
+    int cb = tolower(static_cast<unsigned char>(b[i]));
+    if (ca != cb)
+      return ca < cb ? -1 : 1;
+  }
+  if (a.size() == b.size())
+    return 0;
+  return a.size() < b.size() ? -1 : 1;
+}
+
+// NaN if |text| isn't entirely a number.
+double ParseNumber(const std::string& text) {
+  if (text.empty())
+    return NAN;
+  const char* start = text.c_str();
+  char* end;
+  double number = strtod(start, &end);
+  if (end != start + text.size())
+    return NAN;
+  return number;
+}
+
+// Orders row indices by their values: numbers numerically and before other
+// text, which is compared ignoring ASCII case. Rows that compare equal stay
+// in their original order, so the result doesn't depend on how the sort is
+// split up.
+class RowOrder {
+ public:
+  RowOrder(const std::vector<std::string>& values,
+           const std::vector<double>& numbers,
+           bool ascending)
+      : values_(values), numbers_(numbers), ascending_(ascending) {}
+
+  bool operator()(uint32_t a, uint32_t b) const {
+    int order = Compare(a, b);
+    if (order != 0)
+      return ascending_ ? order < 0 : order > 0;
+    return a < b;
+  }
+
+ private:
+  int Compare(uint32_t a, uint32_t b) const {
+    double number_a = numbers_[a], number_b = numbers_[b];
+    bool is_number_a = !isnan(number_a), is_number_b = !isnan(number_b);
+    if (is_number_a && is_number_b) {
+      if (number_a == number_b)
+        return 0;
+      return number_a < number_b ? -1 : 1;
+    }
+    if (is_number_a != is_number_b)
+      return is_number_a ? -1 : 1;
+    return CompareIgnoringCase(values_[a], values_[b]);
+  }
+
+  const std::vector<std::string>& values_;
+  const std::vector<double>& numbers_;
+  bool ascending_;
+};
+
+struct FilterRowsData {
+  const std::vector<std::string>* columns;
+  int num_columns;
+  const std::string* filter;
+  // Empty if not sorting.
+  const std::vector<std::string>* sort_values;
+  const std::atomic<bool>* cancelled;
+  size_t count;
+  std::vector<uint8_t>* keep;
+  std::vector<double>* numbers;
+};
+
+void FilterRows(void* user_data, int chunk) {
+  FilterRowsData* data = reinterpret_cast<FilterRowsData*>(user_data);
+  if (data->cancelled->load(std::memory_order_relaxed))
+    return;
+  size_t first = chunk * kViewChunkSize;
+  size_t last = std::min(first + kViewChunkSize, data->count);
+  for (size_t row = first; row < last; ++row) {
+    bool keep = data->filter->empty();
+    for (int column = 0; column < data->num_columns && !keep; ++column)
+      keep = ContainsIgnoringCase(data->columns[column][row], *data->filter);
+    (*data->keep)[row] = keep;
+    if (keep && data->sort_values)
+      (*data->numbers)[row] = ParseNumber((*data->sort_values)[row]);
+  }
+}
+
+struct SortRowsData {
+  std::vector<uint32_t>* rows;
+  // Chunk |i| is [bounds[i], bounds[i + 1]).
+  std::vector<size_t> bounds;
+  const RowOrder* order;
+  // For merging, the number of sorted chunks in each run.
+  size_t run_chunks;
+  const std::atomic<bool>* cancelled;
+};
+
+void SortChunk(void* user_data, int chunk) {
+  SortRowsData* data = reinterpret_cast<SortRowsData*>(user_data);
+  if (data->cancelled->load(std::memory_order_relaxed))
+    return;
+  std::vector<uint32_t>::iterator begin = data->rows->begin();
+  std::sort(begin + data->bounds[chunk],
+            begin + data->bounds[chunk + 1],
+            *data->order);
+}
+
+void MergeRuns(void* user_data, int pair) {
+  SortRowsData* data = reinterpret_cast<SortRowsData*>(user_data);
+  if (data->cancelled->load(std::memory_order_relaxed))
+    return;
+  size_t num_chunks = data->bounds.size() - 1;
+  size_t first = pair * 2 * data->run_chunks;
+  size_t middle = first + data->run_chunks;
+  if (middle >= num_chunks)
+    return;
+  size_t last = std::min(middle + data->run_chunks, num_chunks);
+  std::vector<uint32_t>::iterator begin = data->rows->begin();
+  std::inplace_merge(begin + data->bounds[first],
+                     begin + data->bounds[middle],
+                     begin + data->bounds[last],
+                     *data->order);
+}
+
+// Sorts the chunks in parallel, and then merges pairs of runs in parallel
+// until there's one.
+void SortRows(std::vector<uint32_t>* rows,
+              const RowOrder& order,
+              const std::atomic<bool>* cancelled) {
+  SortRowsData data;
+  data.rows = rows;
+  for (size_t i = 0; i < rows->size(); i += kViewChunkSize)
+    data.bounds.push_back(i);
+  data.bounds.push_back(rows->size());
+  data.order = &order;
+  data.run_chunks = 1;
+  data.cancelled = cancelled;
+  int num_chunks = static_cast<int>(data.bounds.size() - 1);
+  TaskScheduler* scheduler = TaskScheduler::Get();
+  scheduler->ParallelFor(
+      TaskPriority::Background, num_chunks, SortChunk, &data);
+  while (data.run_chunks < static_cast<size_t>(num_chunks)) {
+    int num_pairs = static_cast<int>((num_chunks + 2 * data.run_chunks - 1) /
+                                     (2 * data.run_chunks));
+    scheduler->ParallelFor(
+        TaskPriority::Background, num_pairs, MergeRuns, &data);
+    data.run_chunks *= 2;
+  }
+}
+
+}  // namespace
+
+// static
+void TreeGrid::RunViewJob(void* user_data) {
+  std::unique_ptr<std::shared_ptr<ViewJob>> job_ref(
+      reinterpret_cast<std::shared_ptr<ViewJob>*>(user_data));
+  ViewJob* job = job_ref->get();
+  const ViewSnapshot& snapshot = *job->snapshot;
+  size_t count = snapshot.nodes.size();
+  bool sorting = job->sort_column >= 0 &&
+                 job->sort_column < snapshot.num_columns;
+
+  std::vector<uint8_t> keep(count);
+  std::vector<double> numbers(sorting ? count : 0);
+  FilterRowsData filter_data;
+  filter_data.columns = snapshot.columns;
+  filter_data.num_columns = snapshot.num_columns;
+  filter_data.filter = &job->filter;
+  filter_data.sort_values =
+      sorting ? &snapshot.columns[job->sort_column] : NULL;
+  filter_data.cancelled = &job->cancelled;
+  filter_data.count = count;
+  filter_data.keep = &keep;
+  filter_data.numbers = &numbers;
+  TaskScheduler::Get()->ParallelFor(
+      TaskPriority::Background,
+      static_cast<int>((count + kViewChunkSize - 1) / kViewChunkSize),
+      FilterRows,
+      &filter_data);
+
+  std::vector<uint32_t> rows;
+  if (!job->cancelled.load(std::memory_order_relaxed)) {
+    for (size_t i = 0; i < count; ++i) {
+      if (keep[i])
+        rows.push_back(static_cast<uint32_t>(i));
+    }
+    if (sorting) {
+      RowOrder order(
+          snapshot.columns[job->sort_column], numbers, job->sort_ascending);
+      SortRows(&rows, order, &job->cancelled);
+    }
+  }
+
+  job->rows.swap(rows);
+  job->done.store(true, std::memory_order_release);
+  // The grid waits for its jobs before it's destroyed.
+  if (!job->cancelled.load(std::memory_order_relaxed))
+    ScheduleInvalidate(job->tree_grid, 0.0);
+}
+
+void TreeGrid::StartViewJob() {
+  if (view_job_) {
+    view_job_->cancelled.store(true, std::memory_order_relaxed);
+    view_job_.reset();
+  }
+  if (sort_column_ < 0 && filter_.empty()) {
+    SetView(NULL);
+    view_nodes_.clear();
+    shown_snapshot_.reset();
+    return;
+  }
+
+  if (!view_snapshot_) {
+    ViewSnapshot* snapshot = new ViewSnapshot;
+    const std::vector<TreeGridNode*>& nodes = root_.nodes_;
+    snapshot->nodes.assign(nodes.begin(), nodes.end());
+    snapshot->num_columns = std::min(static_cast<int>(columns_.size()),
+                                     TreeGridNode::kMaxColumns);
+    for (int column = 0; column < snapshot->num_columns; ++column) {
+      std::vector<std::string>& values = snapshot->columns[column];
+      values.resize(nodes.size());
+      for (size_t i = 0; i < nodes.size(); ++i) {
+        if (const TreeGridNodeValue* value = nodes[i]->GetValue(column))
+          values[i] = value->AsString();
+      }
+    }
+    view_snapshot_.reset(snapshot);
+  }
+
+  std::shared_ptr<ViewJob> job(new ViewJob);
+  job->snapshot = view_snapshot_;
+  job->nodes_generation = nodes_generation_;
+  job->sort_column = sort_column_;
+  job->sort_ascending = sort_ascending_;
+  job->filter = filter_;
+  for (char& c : job->filter)
+    c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  job->tree_grid = this;
+  view_job_ = job;
+  if (!tasks_)
+    tasks_.reset(new TaskGroup);
+  TaskScheduler::Get()->Post(TaskPriority::Background,
+                             RunViewJob,
+                             new std::shared_ptr<ViewJob>(job),
+                             tasks_.get());
+}
+
+void TreeGrid::ApplyFinishedViewJob() {
+  if (!view_job_ || !view_job_->done.load(std::memory_order_acquire))
+    return;
+  std::shared_ptr<ViewJob> job;
+  job.swap(view_job_);
+  if (job->nodes_generation != nodes_generation_)
+    return;
+
+  view_nodes_.clear();
+  view_nodes_.reserve(job->rows.size());
+  for (uint32_t row : job->rows)
+    view_nodes_.push_back(root_.nodes_[row]);
+  shown_snapshot_ = job->snapshot;
+  SetView(&view_nodes_);
+
+  // Don't leave focus in a node that's been filtered out.
+  if (focused_node_) {
+    TreeGridNode* top_level = focused_node_;
+    while (top_level->Parent())
+      top_level = top_level->Parent();
+    if (root_.IndexOfChild(top_level) < 0)
+      focused_node_ = NULL;
+  }
+}
+
+void TreeGrid::ShowProvisionalView() {
+  if (!shown_snapshot_)
+    return;
+  std::unordered_set<const TreeGridNode*> live(root_.nodes_.begin(),
+                                               root_.nodes_.end());
+  std::unordered_set<const TreeGridNode*> previous(
+      shown_snapshot_->nodes.begin(), shown_snapshot_->nodes.end());
+  std::vector<TreeGridNode*> view;
+  view.reserve(root_.nodes_.size());
+  for (TreeGridNode* node : view_nodes_) {
+    if (live.erase(node))
+      view.push_back(node);
+  }
+  for (TreeGridNode* node : root_.nodes_) {
+    if (live.count(node) && !previous.count(node))
+      view.push_back(node);
+  }
+  view_nodes_.swap(view);
+  SetView(&view_nodes_);
+}
+
+void TreeGrid::UpdateView() {
+  if (view_stale_) {
+    view_stale_ = false;
+    ShowProvisionalView();
+    StartViewJob();
+  }
+  ApplyFinishedViewJob();
+}
+
+void TreeGrid::SetView(const std::vector<TreeGridNode*>* view) {
+  root_.view_ = view;
+  root_.child_indices_dirty_ = true;
+  root_.InvalidateVisibleRows(false);
+}
+
+void TreeGrid::SetSortColumn(int column, bool ascending) {
+  sort_column_ = column;
+  sort_ascending_ = ascending;
+  StartViewJob();
+  Invalidate();
+}
+
+void TreeGrid::SetFilter(const std::string& filter) {
+  if (filter == filter_)
+    return;
+  filter_ = filter;
+  StartViewJob();
+  Invalidate();
+}
+
+void TreeGrid::WaitForViewForTesting() {
+  UpdateView();
+  if (view_job_)
+    TaskScheduler::Get()->Wait(tasks_.get());
+  ApplyFinishedViewJob();
+}
+
+void TreeGrid::NotifyHeaderClicked(int column) {
+  if (column == sort_column_)
+    SetSortColumn(column, !sort_ascending_);
+  else
+    SetSortColumn(column, true);
+}
+
+void TreeGrid::AutoSizeColumn(int column) {
+  if (auto_size_job_) {
+    auto_size_job_->cancelled.store(true, std::memory_order_relaxed);
+    auto_size_job_.reset();
+  }
+  if (column < 0 || static_cast<size_t>(column) + 1 >= columns_.size())
+    return;
+  StartAutoSizeJob(column, 0, 0, 0.f);
+}
+
+void TreeGrid::StartAutoSizeJob(int column,
+                                int round,
+                                int rows_sampled,
+                                float width) {
+  std::shared_ptr<AutoSizeJob> job(new AutoSizeJob);
+  job->column = column;
+  job->round = round;
+  job->previous_width = width;
+  job->tree_grid = this;
+
+  // The space each cell needs besides its text: the padding either side,
+  // the column separator, and for the first column, the indent and the
+  // expansion box.
+  const float kPadding = 2 * kTextPadding + 1.f;
+  const LayoutData& layout_data = GetLayout();
+  if (round == 0) {
+    job->texts.push_back(columns_[column]->GetCaption());
+    job->offsets.push_back(kPadding);
+    float column_x = layout_data.header_columns[column].x;
+    for (const auto& cell : layout_data.cells) {
+      const TreeGridNodeValue* value = cell.node->GetValue(cell.index);
+      if (cell.index != column || !value)
+        continue;
+      job->texts.push_back(value->AsString());
+      job->offsets.push_back(cell.rect.x - column_x + kPadding);
+    }
+  }
+
+  // One row from each of |sample_size| equal slices of the rows, at a
+  // different place in the slice each round. Rows that are in collapsed
+  // nodes, or that a provider hasn't created, aren't looked at, so this
+  // doesn't create any nodes.
+  int num_rows = VisibleRowCount();
+  int sample_size = std::min(kAutoSizeFirstSample << round, kAutoSizeMaxSample);
+  double phase = fmod(round * 0.6180339887, 1.0);
+  if (round == 0 && num_rows <= sample_size)
+    sample_size = num_rows;
+  std::vector<RowPosition> path;
+  for (int i = 0; i < sample_size; ++i) {
+    int row = std::min(
+        num_rows - 1,
+        static_cast<int>((i + phase) * num_rows / sample_size));
+    GetPathToRow(row, &path);
+    const TreeGridNode* node =
+        path.back().parent->GetChildIfCreated(path.back().index);
+    const TreeGridNodeValue* value = node ? node->GetValue(column) : NULL;
+    if (!value)
+      continue;
+    float offset = kPadding;
+    if (column == 0)
+      offset += (path.size() - 1) * kMarginWidth + kRowHeight;
+    job->texts.push_back(value->AsString());
+    job->offsets.push_back(offset);
+  }
+  job->rows_sampled = rows_sampled + sample_size;
+
+  auto_size_job_ = job;
+  if (!tasks_)
+    tasks_.reset(new TaskGroup);
+  TaskScheduler::Get()->Post(TaskPriority::Background,
+                             RunAutoSizeJob,
+                             new std::shared_ptr<AutoSizeJob>(job),
+                             tasks_.get());
+}
+
+namespace {
+
+struct MeasureCellsData {
+  const std::vector<std::string>* texts;
+  const std::vector<float>* offsets;
+  const std::atomic<bool>* cancelled;
+  // The widest cell in each chunk.
+  std::vector<float> widths;
+};
+
+void MeasureCells(void* user_data, int chunk) {
+  MeasureCellsData* data = reinterpret_cast<MeasureCellsData*>(user_data);
+  if (data->cancelled->load(std::memory_order_relaxed))
+    return;
+  size_t first = chunk * kAutoSizeChunkSize;
+  size_t last = std::min(first + kAutoSizeChunkSize, data->texts->size());
+  float widest = 0.f;
+  for (size_t i = first; i < last; ++i) {
+    float width = (*data->offsets)[i] +
+                  EstimateTextWidth(Font::kUI, (*data->texts)[i]);
+    widest = std::max(widest, width);
+  }
+  data->widths[chunk] = widest;
+}
+
+}  // namespace
+
+// static
+void TreeGrid::RunAutoSizeJob(void* user_data) {
+  std::unique_ptr<std::shared_ptr<AutoSizeJob>> job_ref(
+      reinterpret_cast<std::shared_ptr<AutoSizeJob>*>(user_data));
+  AutoSizeJob* job = job_ref->get();
+  MeasureCellsData data;
+  data.texts = &job->texts;
+  data.offsets = &job->offsets;
+  data.cancelled = &job->cancelled;
+  int num_chunks = static_cast<int>(
+      (job->texts.size() + kAutoSizeChunkSize - 1) / kAutoSizeChunkSize);
+  data.widths.resize(num_chunks);
+  TaskScheduler::Get()->ParallelFor(
+      TaskPriority::Background, num_chunks, MeasureCells, &data);
+
+  float width = 0.f;
+  for (float chunk_width : data.widths)
+    width = std::max(width, chunk_width);
+  job->width = width;
+  job->done.store(true, std::memory_order_release);
+  if (!job->cancelled.load(std::memory_order_relaxed))
+    ScheduleInvalidate(job->tree_grid, 0.0);
+}
+
+void TreeGrid::ApplyFinishedAutoSizeJob() {
+  if (!auto_size_job_ || !auto_size_job_->done.load(std::memory_order_acquire))
+    return;
+  std::shared_ptr<AutoSizeJob> job;
+  job.swap(auto_size_job_);
+  int column = job->column;
+  if (static_cast<size_t>(column) + 1 >= columns_.size())
+    return;
+
+  // The first round fits the column, and later ones only widen it, as the
+  // widest value so far is still there.
+  float width = std::max(job->previous_width, job->width);
+  if (job->round == 0 || width > job->previous_width) {
+    float body_width = Width() - kMarginWidth;
+    std::vector<float> widths = GetColumnWidths(body_width);
+    float border = Skin::current().border_size();
+    float max_width = widths[column] + widths[column + 1] - border;
+    columns_[column]->SetPercentageToMatchWidth(
+        std::min(max_width, std::max(border, width)), body_width);
+    Invalidate();
+  }
+
+  if (job->rows_sampled < VisibleRowCount() &&
+      job->round + 1 < kAutoSizeMaxRounds) {
+    StartAutoSizeJob(column, job->round + 1, job->rows_sampled, width);
+  }
+}
+
+void TreeGrid::WaitForAutoSizeForTesting() {
+  while (auto_size_job_) {
+    TaskScheduler::Get()->Wait(tasks_.get());
+    ApplyFinishedAutoSizeJob();
+  }
+}
+
+void TreeGrid::SetValueFormatter(TreeGridValueFormatter* formatter) {
+  InvalidateFormattedValues();
+  formatter_ = formatter;
+}
+
+void TreeGrid::InvalidateFormattedValues() {
+  CancelFormatRequests();
+  format_cache_.clear();
+  Invalidate();
+}
+
+void TreeGrid::CancelFormatRequests() {
+  for (const auto& it : format_requests_)
+    it.second->cancelled.store(true, std::memory_order_relaxed);
+  format_requests_.clear();
+}
+
+// static
+void TreeGrid::RunFormatRequest(void* user_data) {
+  std::unique_ptr<std::shared_ptr<FormatRequest>> request_ref(
+      reinterpret_cast<std::shared_ptr<FormatRequest>*>(user_data));
+  FormatRequest* request = request_ref->get();
+  // Rows that were scrolled past quickly are usually cancelled before their
+  // formatting starts.
+  if (!request->cancelled.load(std::memory_order_relaxed)) {
+    request->text =
+        request->formatter->Format(request->key, request->cancelled);
+  }
+  request->done.store(true, std::memory_order_release);
+  if (!request->cancelled.load(std::memory_order_relaxed))
+    ScheduleInvalidate(request->tree_grid, 0.0);
+}
+
+void TreeGrid::UpdateFormattedValues() {
+  if (!formatter_)
+    return;
+  const LayoutData& layout_data = GetLayout();
+  std::unordered_map<std::string, std::shared_ptr<FormatRequest>> in_view;
+  bool top_level_changed = false;
+  for (const auto& cell : layout_data.cells) {
+    if (cell.index >= TreeGridNode::kMaxColumns)
+      continue;
+    TreeGridNodeValue* value = cell.node->values_[cell.index];
+    TreeGridNodeValuePending* pending = value ? value->AsPending() : NULL;
+    if (!pending)
+      continue;
+    auto cached = format_cache_.find(pending->key());
+    if (cached == format_cache_.end()) {
+      std::shared_ptr<FormatRequest>& request = in_view[pending->key()];
+      if (!request) {
+        auto started = format_requests_.find(pending->key());
+        if (started != format_requests_.end()) {
+          request = started->second;
+        } else {
+          request.reset(new FormatRequest);
+          request->key = pending->key();
+          request->formatter = formatter_;
+          request->tree_grid = this;
+          if (!tasks_)
+            tasks_.reset(new TaskGroup);
+          TaskScheduler::Get()->Post(
+              TaskPriority::Background,
+              RunFormatRequest,
+              new std::shared_ptr<FormatRequest>(request),
+              tasks_.get());
+        }
+      }
+      if (!request->done.load(std::memory_order_acquire))
+        continue;
+      cached = format_cache_.insert(
+          std::make_pair(request->key, request->text)).first;
+    }
+    cell.node->SetFormattedValue(cell.index, cached->second);
+    if (!cell.node->Parent())
+      top_level_changed = true;
+  }
+
+  // Values that have been scrolled away from aren't worth waiting for, but
+  // what's already been done is kept.
+  for (const auto& it : format_requests_) {
+    FormatRequest* request = it.second.get();
+    if (in_view.count(it.first))
+      continue;
+    if (request->done.load(std::memory_order_acquire))
+      format_cache_.insert(std::make_pair(request->key, request->text));
+    else
+      request->cancelled.store(true, std::memory_order_relaxed);
+  }
+  for (auto it = in_view.begin(); it != in_view.end();) {
+    if (it->second->done.load(std::memory_order_relaxed))
+      it = in_view.erase(it);
+    else
+      ++it;
+  }
+  format_requests_.swap(in_view);
+
+  // The view is calculated from the top-level values.
+  if (top_level_changed) {
+    NodesWillChange();
+    UpdateView();
+  }
+}
+
+void TreeGrid::WaitForFormattingForTesting() {
+  UpdateFormattedValues();
+  while (!format_requests_.empty()) {
+    TaskScheduler::Get()->Wait(tasks_.get());
+    UpdateFormattedValues();
+  }
+}
+
+int TreeGrid::VisibleRowCount() {
+  // Not including the root itself.
+  return root_.UpdateVisibleRows() - 1;
+}
+
+int TreeGrid::GetContentSize() {
+  return static_cast<int>(VisibleRowCount() * kRowHeight);
+}
+
+const Rect& TreeGrid::GetScreenRect() const {
+  return Widget::GetScreenRect();
 }
 
 std::vector<TreeGridColumn*>* TreeGrid::Columns() {
+  InvalidateLayout();
   return &columns_;
 }
 
-TreeGrid::LayoutData TreeGrid::CalculateLayout(const Rect& client_rect) {
-  TreeGrid::LayoutData ret;
+const TreeGrid::LayoutData& TreeGrid::GetLayout() {
+  // Filtering, collapsing or updating the nodes can leave fewer rows than
+  // the scroll offset is past.
+  scroll_.ClampToContentSize();
+  Rect client_rect = GetClientRect();
+  if (!layout_valid_ || layout_.client_rect.w != client_rect.w ||
+      layout_.client_rect.h != client_rect.h ||
+      layout_.scroll_offset != scroll_.GetOffset() ||
+      layout_.focused_node != focused_node_) {
+    CalculateLayout(client_rect, &layout_);
+    layout_valid_ = true;
+  }
+  return layout_;
+}
+
+void TreeGrid::InvalidateLayout() {
+  layout_valid_ = false;
+}
 
-  const float kMarginWidth =
-      22;  // TODO(scottmg): Should be something font-related.
-  const float kHeaderHeight = kMarginWidth;
+void TreeGrid::CalculateLayout(const Rect& client_rect,
+                               LayoutData* layout_data) {
+  TreeGrid::LayoutData& ret = *layout_data;
+  ret = LayoutData();
+  ret.client_rect = client_rect;
+  ret.scroll_offset = scroll_.GetOffset();
+  ret.focused_node = focused_node_;
 
   ret.margin =
       Rect(0, kHeaderHeight, kMarginWidth, client_rect.h - kHeaderHeight);
@@ -186,82 +1520,232 @@ TreeGrid::LayoutData TreeGrid::CalculateLayout(const Rect& client_rect) {
     ret.column_splitters.push_back(splitter_x);
   }
 
-  float y_position = 0.f;
-  CalculateLayoutNodes(
-      *Nodes(), ret.column_widths, kMarginWidth, 0.f, &y_position, &ret);
+  int num_rows = VisibleRowCount();
+  int scroll_offset = ret.scroll_offset;
+  int first_row = static_cast<int>(scroll_offset / kRowHeight);
+  ret.first_row_y = kHeaderHeight + first_row * kRowHeight - scroll_offset;
+  if (num_rows == 0 || first_row < 0 || first_row >= num_rows ||
+      ret.body.h <= 0)
+    return;
 
-  return ret;
+  // Find the node on |first_row|, keeping the path to it so that the
+  // following rows can be walked without searching again.
+  std::vector<RowPosition> path;
+  GetPathToRow(first_row, &path);
+
+  float y_position = ret.first_row_y;
+  while (y_position < client_rect.h && !path.empty()) {
+    const RowPosition& position = path.back();
+    TreeGridNode* node = position.parent->GetChild(position.index);
+    AddRowToLayout(node, static_cast<int>(path.size()) - 1, y_position, &ret);
+    y_position += kRowHeight;
+
+    // On to the next visible row: the first child if expanded, otherwise the
+    // next sibling of this node or its closest ancestor that has one.
+    if (node->Expanded() && node->NumChildren() > 0) {
+      path.push_back(RowPosition(node, 0));
+      continue;
+    }
+    while (!path.empty() &&
+           path.back().index + 1 >= path.back().parent->NumChildren()) {
+      path.pop_back();
+    }
+    if (!path.empty())
+      ++path.back().index;
+  }
 }
 
-void TreeGrid::CalculateLayoutNodes(const std::vector<TreeGridNode*>& nodes,
-                                    const std::vector<float>& column_widths,
-                                    const float depth_per_indent,
-                                    float current_indent,
-                                    float* y_position,
-                                    TreeGrid::LayoutData* layout_data) {
-  float kLineHeight = depth_per_indent;  // TODO(scottmg): Wrong height, just
-                                         // happens to be about right.
-  for (size_t i = 0; i < nodes.size(); ++i) {
-    TreeGridNode* node = nodes[i];
-    float last_x = 0.f;
-    for (size_t j = 0; j < column_widths.size(); ++j) {
-      float x = last_x;
-      if (j == 0) {
-        if (node->Nodes()->size() > 0) {
-          float half = kLineHeight / 2.f;
-          layout_data->expansion_boxes.push_back(LayoutData::RectAndNode(
-              Rect(current_indent + layout_data->margin.w + half / 2.f,
-                   *y_position + layout_data->header.h + half / 2.f,
-                   half,
-                   half),
-              node));
-        }
-
-        // Then space for the text.
-        const float kIndicatorWidth = kLineHeight;
-        x = current_indent + kIndicatorWidth;
+void TreeGrid::AddRowToLayout(TreeGridNode* node,
+                              int depth,
+                              float y_position,
+                              TreeGrid::LayoutData* layout_data) {
+  const std::vector<float>& column_widths = layout_data->column_widths;
+  float current_indent = depth * kMarginWidth;
+  layout_data->row_expansion_boxes.push_back(-1);
+  float last_x = 0.f;
+  for (size_t j = 0; j < column_widths.size(); ++j) {
+    float x = last_x;
+    if (j == 0) {
+      if (node->NumChildren() > 0) {
+        layout_data->row_expansion_boxes.back() =
+            static_cast<int>(layout_data->expansion_boxes.size());
+        float half = kRowHeight / 2.f;
+        layout_data->expansion_boxes.push_back(LayoutData::RectAndNode(
+            Rect(current_indent + layout_data->margin.w + half / 2.f,
+                 y_position + half / 2.f,
+                 half,
+                 half),
+            node));
       }
-      // -1 on width for column separator.
-      float adjusted_width =
-          std::max(0.f, column_widths[j] - 1.f - (x - last_x));
-      last_x += column_widths[j];
-      Rect box(x + layout_data->margin.w,
-               *y_position + layout_data->header.h,
-               adjusted_width,
-               kLineHeight);
-      layout_data->cells.push_back(
-          LayoutData::RectNodeAndIndex(box, node, static_cast<int>(j)));
-      if (j == 0 && node == focused_node_)
-        layout_data->focus = box;
-    }
-    *y_position += kLineHeight;
-    if (node->Expanded()) {
-      CalculateLayoutNodes(*node->Nodes(),
-                           column_widths,
-                           depth_per_indent,
-                           current_indent + depth_per_indent,
-                           y_position,
-                           layout_data);
+
+      // Then space for the text.
+      const float kIndicatorWidth = kRowHeight;
+      x = current_indent + kIndicatorWidth;
     }
+    // -1 on width for column separator.
+    float adjusted_width =
+        std::max(0.f, column_widths[j] - 1.f - (x - last_x));
+    last_x += column_widths[j];
+    Rect box(x + layout_data->margin.w, y_position, adjusted_width, kRowHeight);
+    layout_data->cells.push_back(
+        LayoutData::RectNodeAndIndex(box, node, static_cast<int>(j)));
+    if (j == 0 && node == focused_node_)
+      layout_data->focus = box;
+  }
+}
+
+TreeGridNode* TreeGrid::ExpansionBoxAtPoint(const LayoutData& layout_data,
+                                           const Point& point) {
+  float row = floorf((point.y - layout_data.first_row_y) / kRowHeight);
+  if (row < 0.f ||
+      row >= static_cast<float>(layout_data.row_expansion_boxes.size()))
+    return NULL;
+  int box = layout_data.row_expansion_boxes[static_cast<size_t>(row)];
+  if (box < 0 || !layout_data.expansion_boxes[box].rect.Contains(point))
+    return NULL;
+  return layout_data.expansion_boxes[box].node;
+}
+
+TreeGridNode* TreeGrid::NodeAtPoint(const LayoutData& layout_data,
+                                    const Point& point) {
+  float row = floorf((point.y - layout_data.first_row_y) / kRowHeight);
+  if (row < 0.f ||
+      row >= static_cast<float>(layout_data.row_expansion_boxes.size()))
+    return NULL;
+  // The column whose splitter is the first one right of the point.
+  const std::vector<float>& splitters = layout_data.column_splitters;
+  size_t column =
+      std::lower_bound(splitters.begin(), splitters.end(), point.x) -
+      splitters.begin();
+  if (column == splitters.size())
+    return NULL;
+  const LayoutData::RectNodeAndIndex& cell =
+      layout_data.cells[static_cast<size_t>(row) * splitters.size() + column];
+  if (!cell.rect.Contains(point))
+    return NULL;
+  return cell.node;
+}
+
+int TreeGrid::ColumnSplitterAtPoint(const LayoutData& layout_data,
+                                    const Point& point) {
+  float half_width = Skin::current().border_size() / 2.f;
+  // The first splitter that's not entirely left of the point.
+  const std::vector<float>& splitters = layout_data.column_splitters;
+  size_t index =
+      std::lower_bound(
+          splitters.begin(), splitters.end(), point.x - half_width) -
+      splitters.begin();
+  if (index == splitters.size() || point.x <= splitters[index] - half_width)
+    return -1;
+  return static_cast<int>(index);
+}
+
+void TreeGrid::GetPathToRow(int row, std::vector<RowPosition>* path) {
+  root_.UpdateVisibleRows();
+  path->clear();
+  TreeGridNode* parent = &root_;
+  for (;;) {
+    int child_row;
+    size_t index = parent->ChildAtRow(row, &child_row);
+    path->push_back(RowPosition(parent, index));
+    if (row == child_row)
+      break;
+    // In the child's subtree, below the child itself.
+    parent = parent->GetChild(index);
+    row -= child_row + 1;
+  }
+}
+
+TreeGridNode* TreeGrid::GetNodeAtRow(int row) {
+  std::vector<RowPosition> path;
+  GetPathToRow(row, &path);
+  return path.back().parent->GetChild(path.back().index);
+}
+
+int TreeGrid::GetRowsPerPage() {
+  // Keep one row of the last page in view, like a text view does.
+  int rows_in_body = static_cast<int>((Height() - kHeaderHeight) / kRowHeight);
+  return std::max(1, rows_in_body - 1);
+}
+
+int TreeGrid::GetRowOfNode(TreeGridNode* node) {
+  root_.UpdateVisibleRows();
+  int row = 0;
+  while (node) {
+    TreeGridNode* parent = node->ParentOrRoot();
+    if (!parent->Expanded())
+      return -1;
+    int index = parent->IndexOfChild(node);
+    if (index < 0)
+      return -1;
+    row += parent->RowOfChild(index);
+    // Below the parent's own row, unless it's the root.
+    if (node->Parent())
+      ++row;
+    node = node->Parent();
+  }
+  return row;
+}
+
+void TreeGrid::ScrollToShowFocusedNode() {
+  if (!focused_node_)
+    return;
+  int row = GetRowOfNode(focused_node_);
+  if (row < 0)
+    return;
+  int body_height = static_cast<int>(Height() - kHeaderHeight);
+  if (scroll_.ScrollToShow(static_cast<int>(row * kRowHeight),
+                           static_cast<int>(kRowHeight),
+                           body_height)) {
+    Invalidate();
   }
 }
 
 void TreeGrid::Render() {
+  UpdateView();
+  ApplyFinishedAutoSizeJob();
+
+  double next_frame_time;
+  if (scroll_.Update(&next_frame_time))
+    InvalidateAt(next_frame_time);
+  UpdateFormattedValues();
+
   const Rect& client_rect = GetClientRect();
-  const LayoutData& ld = CalculateLayout(client_rect);
+  const LayoutData& ld = GetLayout();
 
   const ColorScheme& cs = Skin::current().GetColorScheme();
   DrawSolidRect(client_rect, cs.background());
 
   DrawSolidRect(ld.margin, cs.margin());
+
+  for (const auto& cell : ld.cells) {
+    if (const TreeGridNodeValue* value = cell.node->GetValue(cell.index)) {
+      value->Render(cell.rect,
+                    cell.node->ValueChanged(cell.index) ? cs.changed_value()
+                                                        : cs.text());
+    }
+  }
+
+  for (const auto& button : ld.expansion_boxes) {
+    GfxDrawIcon(
+        button.node->Expanded() ? Icon::kTreeExpanded : Icon::kTreeCollapsed,
+        button.rect,
+        1.f);
+  }
+
+  // The header is drawn last, as the first row may be partly scrolled under
+  // it.
   DrawSolidRect(ld.header, cs.margin());
 
   DrawVerticalLine(cs.border(), ld.header.x, ld.header.y, client_rect.h);
 
   for (size_t i = 0; i < columns_.size(); ++i) {
+    std::string caption = columns_[i]->GetCaption();
+    if (static_cast<int>(i) == sort_column_)
+      caption += sort_ascending_ ? " ^" : " v";
     DrawTextInRect(Font::kUI,
                    ld.header_columns[i],
-                   columns_[i]->GetCaption(),
+                   caption,
                    cs.margin_text(),
                    kTextPadding);
     DrawVerticalLine(cs.border(),
@@ -272,16 +1756,21 @@ void TreeGrid::Render() {
   DrawHorizontalLine(
       cs.border(), ld.header.x, ld.header.x + ld.header.w, ld.header.h);
 
-  for (const auto& cell : ld.cells)
-    cell.node->GetValue(cell.index)->Render(cell.rect);
-
-  for (const auto& button : ld.expansion_boxes) {
-    GfxDrawIcon(
-        button.node->Expanded() ? Icon::kTreeExpanded : Icon::kTreeCollapsed,
-        button.rect,
-        1.f);
+  if (!filter_.empty()) {
+    Rect filter_bar(kMarginWidth,
+                    client_rect.h - kRowHeight,
+                    client_rect.w - kMarginWidth,
+                    kRowHeight);
+    DrawSolidRect(filter_bar, cs.margin());
+    std::string text = "Filter: " + filter_;
+    if (IsViewPending())
+      text += " ...";
+    DrawTextInRect(
+        Font::kUI, filter_bar, text, cs.margin_text(), kTextPadding);
   }
 
+  scroll_.RenderScrollIndicators();
+
   /*
     // TODO(scottmg): lost focus should cancel or commit edit
     if (ld.focus.IsValid()) {
@@ -322,6 +1811,7 @@ class ColumnDragHelper : public Draggable {
     // Nth column.
     tree_grid_->Columns()->at(column_)->SetPercentageToMatchPosition(
         body_point.x, body_.w);
+    tree_grid_->Invalidate();
   }
 
   void CancelDrag() override {}
@@ -338,26 +1828,35 @@ class ColumnDragHelper : public Draggable {
 };
 
 bool TreeGrid::CouldStartDrag(DragSetup* drag_setup) {
-  // This layout calculation is pretty expensive (or would be for many nodes).
-  // Removing the cache for now, but it could also be saved off in Render and
-  // just reused here.
-  const LayoutData& layout_data = CalculateLayout(GetClientRect());
+  const LayoutData& layout_data = GetLayout();
   Point client_point = drag_setup->screen_position.RelativeTo(GetScreenRect());
-  float half_width = Skin::current().border_size() / 2.f;
-  for (size_t i = 0; i < layout_data.column_splitters.size(); ++i) {
-    float column_x = layout_data.column_splitters[i];
-    if (client_point.x > column_x - half_width &&
-        client_point.x <= column_x + half_width) {
-      // TODO(scottmg): Should this only be in the header?
-      drag_setup->drag_direction = kDragDirectionLeftRight;
-      if (drag_setup->draggable) {
-        drag_setup->draggable->reset(new ColumnDragHelper(
-            this, static_cast<int>(i), column_x, layout_data.body));
-      }
+  int splitter = ColumnSplitterAtPoint(layout_data, client_point);
+  if (splitter < 0)
+    return false;
+  if (drag_setup->draggable) {
+    // Double clicking fits the column to the left. A drag takes over from a
+    // fit that's still refining.
+    double now = GetAnimationClock();
+    if (splitter == last_splitter_pressed_ &&
+        now - last_splitter_press_time_ < kDoubleClickTime) {
+      last_splitter_pressed_ = -1;
+      AutoSizeColumn(splitter);
       return true;
     }
+    last_splitter_pressed_ = splitter;
+    last_splitter_press_time_ = now;
+    AutoSizeColumn(-1);
   }
-  return false;
+  // TODO(scottmg): Should this only be in the header?
+  drag_setup->drag_direction = kDragDirectionLeftRight;
+  if (drag_setup->draggable) {
+    drag_setup->draggable->reset(
+        new ColumnDragHelper(this,
+                             splitter,
+                             layout_data.column_splitters[splitter],
+                             layout_data.body));
+  }
+  return true;
 }
 
 bool TreeGrid::NotifyKey(Key::Enum key, bool down, uint8_t modifiers) {
@@ -369,11 +1868,25 @@ bool TreeGrid::NotifyKey(Key::Enum key, bool down, uint8_t modifiers) {
       {Key::Down, kFocusDown},
       {Key::Left, kFocusLeft},
       {Key::Right, kFocusRight},
+      {Key::PageUp, kFocusPageUp},
+      {Key::PageDown, kFocusPageDown},
+      {Key::Home, kFocusHome},
+      {Key::End, kFocusEnd},
   };
   if (down && modifiers == 0) {  // TODO(scottmg): Shift-move for selection.
+    if (key == Key::Backspace && !filter_.empty()) {
+      SetFilter(filter_.substr(0, filter_.size() - 1));
+      return true;
+    }
+    if (key == Key::Esc && !filter_.empty()) {
+      SetFilter(std::string());
+      return true;
+    }
     for (const auto& mapping : mappings) {
       if (mapping.key == key) {
         MoveFocusByDirection(mapping.direction);
+        ScrollToShowFocusedNode();
+        Invalidate();
         return true;
       }
     }
@@ -385,29 +1898,57 @@ bool TreeGrid::NotifyKey(Key::Enum key, bool down, uint8_t modifiers) {
   return false;
 }
 
+bool TreeGrid::NotifyChar(int character) {
+  if (!isprint(character))
+    return false;
+  SetFilter(filter_ + static_cast<char>(character));
+  return true;
+}
+
+bool TreeGrid::NotifyMouseWheel(int x,
+                                int y,
+                                float delta,
+                                uint8_t modifiers) {
+  UNUSED(x);
+  UNUSED(y);
+  bool invalidate = false;
+  bool handled = false;
+  scroll_.CommonMouseWheel(delta, modifiers, &invalidate, &handled);
+  if (invalidate)
+    Invalidate();
+  return handled;
+}
+
 bool TreeGrid::NotifyMouseButton(int x,
                                  int y,
                                  MouseButton::Enum button,
                                  bool down,
                                  uint8_t modifiers) {
-  // See CouldStartDrag (this could be cached).
-  const LayoutData& layout_data = CalculateLayout(GetClientRect());
   UNUSED(modifiers);
   Point client_point = Point(static_cast<float>(x), static_cast<float>(y))
                            .RelativeTo(GetScreenRect());
   if (down && button == MouseButton::Left) {
-    for (const auto& eb : layout_data.expansion_boxes) {
-      if (eb.rect.Contains(client_point)) {
-        eb.node->SetExpanded(!eb.node->Expanded());
-        focused_node_ = eb.node;
-        return true;
-      }
+    const LayoutData& layout_data = GetLayout();
+    if (TreeGridNode* node = ExpansionBoxAtPoint(layout_data, client_point)) {
+      node->SetExpanded(!node->Expanded());
+      focused_node_ = node;
+      Invalidate();
+      return true;
     }
 
-    for (const auto& cell : layout_data.cells) {
-      if (cell.rect.Contains(client_point)) {
-        focused_node_ = cell.node;
-        return true;
+    if (TreeGridNode* node = NodeAtPoint(layout_data, client_point)) {
+      focused_node_ = node;
+      Invalidate();
+      return true;
+    }
+
+    if (layout_data.header.Contains(client_point) &&
+        ColumnSplitterAtPoint(layout_data, client_point) < 0) {
+      for (size_t i = 0; i < layout_data.header_columns.size(); ++i) {
+        if (layout_data.header_columns[i].Contains(client_point)) {
+          NotifyHeaderClicked(static_cast<int>(i));
+          return true;
+        }
       }
     }
   }
@@ -435,31 +1976,22 @@ std::vector<float> TreeGrid::GetColumnWidths(float layout_in_width) const {
 }
 
 TreeGridNode* TreeGrid::GetSibling(TreeGridNode* node, int direction) {
-  // This is kind of ugly. Maybe a dummy TreeGridNode at the root would be
-  // nicer.
   DCHECK(direction == -1 || direction == 1, "bad direction");
-  std::vector<TreeGridNode*>* parent_nodes;
-  if (!node->Parent())
-    parent_nodes = Nodes();
-  else
-    parent_nodes = node->Parent()->Nodes();
-
-  std::vector<TreeGridNode*>::iterator it =
-      std::find(parent_nodes->begin(), parent_nodes->end(), node);
-  if (it == parent_nodes->end())
+  TreeGridNode* parent = node->ParentOrRoot();
+  int index = parent->IndexOfChild(node);
+  if (index < 0)
     return NULL;
-  if (it == parent_nodes->begin() && direction < 0)
+  if (index == 0 && direction < 0)
     return node;
-  if (it == parent_nodes->end() - 1 && direction > 0)
+  if (static_cast<size_t>(index) + 1 == parent->NumChildren() && direction > 0)
     return node;
-  return *(it + direction);
+  return parent->GetChild(index + direction);
 }
 
 TreeGridNode* TreeGrid::GetLastVisibleChild(TreeGridNode* root) {
-  if (!root->Nodes()->empty() && root->Expanded())
-    return GetLastVisibleChild(root->Nodes()->back());
-  else
-    return root;
+  while (root->Expanded() && root->NumChildren() > 0)
+    root = root->GetChild(root->NumChildren() - 1);
+  return root;
 }
 
 TreeGridNode* TreeGrid::GetNextVisibleInDirection(TreeGridNode* node,
@@ -468,8 +2000,8 @@ TreeGridNode* TreeGrid::GetNextVisibleInDirection(TreeGridNode* node,
     // If we have children, and we're expanded, go to the first child.
     // Otherwise, to our sibling. If we have no next sibling, check to see if
     // our parent does, recursively.
-    if (node->Expanded() && !node->Nodes()->empty()) {
-      return node->Nodes()->at(0);
+    if (node->Expanded() && node->NumChildren() > 0) {
+      return node->GetChild(0);
     } else {
       TreeGridNode* next_sibling = GetSibling(node, 1);
       if (next_sibling == node) {
@@ -501,14 +2033,33 @@ TreeGridNode* TreeGrid::GetNextVisibleInDirection(TreeGridNode* node,
 }
 
 void TreeGrid::MoveFocusByDirection(FocusDirection direction) {
+  if (direction == kFocusPageUp || direction == kFocusPageDown ||
+      direction == kFocusHome || direction == kFocusEnd) {
+    // By visible row, rather than by walking the tree.
+    int num_rows = VisibleRowCount();
+    if (num_rows == 0)
+      return;
+    int row = focused_node_ ? GetRowOfNode(focused_node_) : -1;
+    if (direction == kFocusHome || (row < 0 && direction == kFocusPageUp))
+      row = 0;
+    else if (direction == kFocusEnd || row < 0)
+      row = num_rows - 1;
+    else if (direction == kFocusPageUp)
+      row = std::max(0, row - GetRowsPerPage());
+    else
+      row = std::min(num_rows - 1, row + GetRowsPerPage());
+    focused_node_ = GetNodeAtRow(row);
+    return;
+  }
+
   if (!focused_node_ && (direction == kFocusDown || direction == kFocusLeft) &&
-      !Nodes()->empty()) {
-    focused_node_ = Nodes()->front();
+      root_.NumChildren() > 0) {
+    focused_node_ = root_.GetChild(0);
     return;
   } else if (!focused_node_ &&
              (direction == kFocusUp || direction == kFocusRight) &&
-             !Nodes()->empty()) {
-    focused_node_ = Nodes()->back();
+             root_.NumChildren() > 0) {
+    focused_node_ = root_.GetChild(root_.NumChildren() - 1);
     return;
   }
 
@@ -519,7 +2070,7 @@ void TreeGrid::MoveFocusByDirection(FocusDirection direction) {
     focused_node_ = GetNextVisibleInDirection(focused_node_, direction);
   } else if (direction == kFocusLeft) {
     // Contract ourselves, or move to our parent on left.
-    if (!focused_node_->Nodes()->empty() && focused_node_->Expanded()) {
+    if (focused_node_->NumChildren() > 0 && focused_node_->Expanded()) {
       focused_node_->SetExpanded(false);
     } else if (focused_node_->Parent()) {
       focused_node_ = focused_node_->Parent();
@@ -528,7 +2079,7 @@ void TreeGrid::MoveFocusByDirection(FocusDirection direction) {
     // On leaf, does nothing. Otherwise, set expanded. VS does something like
     // "next in traversal" when expanded, but it's non-intuitive so we don't
     // emulate it here.
-    if (!focused_node_->Nodes()->empty()) {
+    if (focused_node_->NumChildren() > 0) {
       focused_node_->SetExpanded(true);
     }
   }
@@ -5,41 +5,133 @@
 #ifndef TREE_GRID_H_
 #define TREE_GRID_H_
 
-#include <map>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "gfx.h"
+#include "scroll_helper.h"
+#include "text_width.h"
 #include "widget.h"
 
+class TaskGroup;
 class TextEdit;
+class TreeGridNodeValuePending;
 
 class TreeGridNodeValue {
  public:
   virtual ~TreeGridNodeValue();
-  virtual void Render(const Rect& rect) const = 0;
+  // |color| is the text color, which is highlighted if the value changed on
+  // the last TreeGrid::UpdateNodes().
+  virtual void Render(const Rect& rect, const Color& color) const = 0;
   virtual std::string AsString() const = 0;
+
+  virtual TreeGridNodeValuePending* AsPending() { return NULL; }
 };
 
+// Allocated from a pool, as there's usually one per cell. Short values are
+// stored inline by std::string. Only as much of the value as fits in the cell
+// is drawn, with an ellipsis, so a long one costs no more to draw than a
+// short one.
 class TreeGridNodeValueString : public TreeGridNodeValue {
  public:
   explicit TreeGridNodeValueString(const std::string& value);
-  void Render(const Rect& rect) const override;
+  void Render(const Rect& rect, const Color& color) const override;
   std::string AsString() const override { return value_; }
 
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
+
  private:
   std::string value_;
+  // Filled in by Render() as far as the width of the cell.
+  mutable TextPrefixWidths prefix_widths_;
+};
+
+// A value whose text is too slow to produce on the main thread, e.g. one
+// that reads the debuggee's memory and walks its type. It's formatted by the
+// grid's TreeGridValueFormatter once it's in view, and a placeholder is drawn
+// until then. It's then replaced by a TreeGridNodeValueString.
+class TreeGridNodeValuePending : public TreeGridNodeValue {
+ public:
+  // |key| identifies the value to the formatter, e.g. an expression.
+  explicit TreeGridNodeValuePending(const std::string& key);
+  void Render(const Rect& rect, const Color& color) const override;
+  // The text of the value this replaced in TreeGridNode::UpdateValue(), if
+  // any, so that sorting and filtering have something to go on meanwhile.
+  std::string AsString() const override { return previous_; }
+  TreeGridNodeValuePending* AsPending() override { return this; }
+
+  const std::string& key() const { return key_; }
+
+ private:
+  friend class TreeGridNode;
+
+  std::string key_;
+  // The formatted text is highlighted if it differs from |previous_|.
+  bool has_previous_;
+  std::string previous_;
+};
+
+// Produces the text of TreeGridNodeValuePending values.
+class TreeGridValueFormatter {
+ public:
+  virtual ~TreeGridValueFormatter() {}
+
+  // Returns the text of the value identified by |key|. Called on workers,
+  // possibly for several keys at once. Formatting that takes a while should
+  // check |cancelled| as it goes, and return early once it's set, as the
+  // result won't be used.
+  virtual std::string Format(const std::string& key,
+                             const std::atomic<bool>& cancelled) = 0;
 };
 
 class TreeGrid;
+class TreeGridNode;
+
+// Supplies the children of a node on demand, for values that may have too
+// many to create up front, e.g. a std::vector with millions of elements.
+// Children are only created when they're about to be shown, a page at a time.
+//
+// That happens in input handling on the main thread, but also in Render(),
+// which DockingWorkspace runs on TaskScheduler workers while the main thread
+// waits for them. Calls for one grid never overlap, but a provider shared by
+// several grids may be called from more than one thread at once. Providers
+// that can only work on a particular thread need to hand off to it.
+class TreeGridNodeProvider {
+ public:
+  virtual ~TreeGridNodeProvider() {}
+
+  // The number of children |node| has. Called when the node's expansion box
+  // is first shown, so it should be cheap, e.g. the size of a container
+  // without reading its elements.
+  virtual int GetChildCount(const TreeGridNode* node) = 0;
+
+  // Fills in |child|, which is |node|'s |index|th child: its values, and its
+  // own provider if it has children too.
+  virtual void PopulateChild(const TreeGridNode* node,
+                             int index,
+                             TreeGridNode* child) = 0;
+};
 
-// Tree of nodes. All pointers are owned, and will be delete'd.
+// Tree of nodes. All pointers are owned, and will be delete'd, including
+// the child nodes. Nodes are allocated from a pool, so that building large
+// trees is cheap.
 class TreeGridNode {
  public:
+  // The most columns a node can have values for.
+  static const int kMaxColumns = 6;
+
   TreeGridNode(TreeGrid* tree_grid, TreeGridNode* parent);
   ~TreeGridNode();
 
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
+
   bool Expanded() const { return expanded_; }
-  void SetExpanded(bool expanded) { expanded_ = expanded; }
+  void SetExpanded(bool expanded);
 
   bool Selected() const { return selected_; }
   void SetSelected(bool selected) { selected_ = selected; }
@@ -48,20 +140,116 @@ class TreeGridNode {
   TreeGridNode* Parent() { return parent_; }
 
   const std::vector<TreeGridNode*>* Nodes() const;
+  // Assumes the children are about to be modified, so the tree's layout is
+  // recalculated. Don't hold on to the result across a Render(). Must be
+  // empty if the node has a provider.
   std::vector<TreeGridNode*>* Nodes();
 
+  // Has the children come from |provider| instead of Nodes(), which must
+  // outlive this node. Deletes any children it already created, so it can
+  // also be used to refresh them. NULL switches back to Nodes().
+  void SetProvider(TreeGridNodeProvider* provider);
+
+  // |column| must be less than kMaxColumns.
   void SetValue(int column, TreeGridNodeValue* value);
+  // NULL if |column| has no value.
   const TreeGridNodeValue* GetValue(int column) const;
+  // Like SetValue(), but keeps the current value if |value| has the same
+  // AsString(), and otherwise marks the cell as changed. Returns whether the
+  // value changed. A pending |value| always replaces the current one unless
+  // that's pending with the same key, and isn't compared until it's
+  // formatted.
+  bool UpdateValue(int column, TreeGridNodeValue* value);
+  // Whether |column| changed on the tree's last UpdateNodes(), or since.
+  bool ValueChanged(int column) const;
 
   const TreeGrid* GetTreeGrid() const { return tree_grid_; }
 
  private:
+  friend class TreeGrid;
+
+  struct LazyChildren;
+
+  // The children as shown: |nodes_|, or for the root when the grid is sorted
+  // or filtered, |view_|. Not for nodes with a provider.
+  const std::vector<TreeGridNode*>& Children() const {
+    return view_ ? *view_ : nodes_;
+  }
+
+  // Children, from either Children() or the provider, creating those that
+  // haven't been yet.
+  size_t NumChildren();
+  TreeGridNode* GetChild(size_t index);
+  // Like GetChild(), but NULL instead of creating the child.
+  TreeGridNode* GetChildIfCreated(size_t index);
+  // Index of |child| in this node's children, or -1 if it isn't one.
+  int IndexOfChild(const TreeGridNode* child);
+
+  // The parent, or for top-level nodes the grid's root.
+  TreeGridNode* ParentOrRoot();
+  // What this node's children have as their Parent().
+  TreeGridNode* ParentForChildren();
+
+  TreeGridNode* CreateLazyChild(size_t index);
+
+  // Identifies the node among its siblings for UpdateNodes(): the value in
+  // column 0, i.e. the name or expression.
+  std::string Key() const;
+  void MarkChanged(int column);
+  // Replaces the pending value in |column| with |text|, which is marked as
+  // changed if it differs from what the pending value replaced.
+  void SetFormattedValue(int column, const std::string& text);
+  // Moves focus here if it's on |child| or inside it, as it's about to be
+  // deleted.
+  void TakeFocusFrom(const TreeGridNode* child);
+  // Makes this node and its descendants part of |tree_grid|, under |parent|.
+  void Adopt(TreeGrid* tree_grid, TreeGridNode* parent);
+
+  // Updates this node's values and children to match |fresh|, reusing the
+  // existing children with the same Key(). Leaves |fresh| empty.
+  void MergeFrom(TreeGridNode* fresh);
+  void MergeChildrenFrom(TreeGridNode* fresh);
+  // Repopulates only the children that have been created, with |provider|.
+  void MergeLazyChildrenFrom(TreeGridNodeProvider* provider);
+
+  // Marks this node as needing UpdateVisibleRows(), and the ancestors whose
+  // row counts depend on it. |count_changed| is whether this node's own row
+  // count is affected, rather than only its children's.
+  void InvalidateVisibleRows(bool count_changed);
+  // Returns the number of rows this node and its visible descendants take,
+  // recalculating only the subtrees that have changed.
+  int UpdateVisibleRows();
+  // After UpdateVisibleRows(), the index of the child whose subtree takes
+  // |row|, counting from the first child's row, and in |*child_row| the row
+  // of the child itself. Expanded only.
+  size_t ChildAtRow(int row, int* child_row) const;
+  // The row of the |index|th child, counting from the first child's row.
+  int RowOfChild(size_t index) const;
+
   TreeGrid* tree_grid_;
   TreeGridNode* parent_;
   bool expanded_;
   bool selected_;
   std::vector<TreeGridNode*> nodes_;
-  std::map<int, TreeGridNodeValue*> items_;
+  // Not owned. Only set on the grid's root.
+  const std::vector<TreeGridNode*>* view_;
+  TreeGridNodeValue* values_[kMaxColumns];
+  // Bit per column, for the update in |changed_generation_|.
+  uint32_t changed_columns_;
+  uint32_t changed_generation_;
+  // Only for nodes with a provider.
+  std::unique_ptr<LazyChildren> lazy_;
+  // Index in the parent's Children(). For children in Nodes(), they're
+  // renumbered on the next IndexOfChild() after Nodes() is called.
+  size_t index_in_parent_;
+  bool child_indices_dirty_;
+
+  bool visible_rows_dirty_;
+  int visible_rows_;
+  // When expanded, the row just past each child's subtree, counting from the
+  // first child's row. Used to find the node on a given row by binary search.
+  // Not used for nodes with a provider.
+  std::vector<int> child_row_ends_;
 };
 
 class TreeGridColumn {
@@ -105,15 +293,52 @@ class TreeGridEditObserver {
   virtual void NodeInserted(TreeGridNode* node) = 0;
 };
 
-// Hierarchical view, with columns.
-class TreeGrid : public Widget {
+// Hierarchical view, with columns. Only the rows that are scrolled into view
+// are laid out, so the cost of a frame doesn't depend on the number of nodes.
+class TreeGrid : public Widget, public ScrollHelperDataProvider {
  public:
   TreeGrid();
   virtual ~TreeGrid();
 
+  // Top-level nodes. See TreeGridNode::Nodes().
   std::vector<TreeGridNode*>* Nodes();
+  // Like Nodes(), assumes the columns are about to be modified.
   std::vector<TreeGridColumn*>* Columns();
 
+  // Number of rows if the whole tree were in view.
+  int VisibleRowCount();
+
+  // Replaces the top-level nodes with |nodes|, e.g. the locals after the
+  // debugger stops again, reusing the existing nodes that have the same path
+  // of names. Those keep their expansion and focus, and only the values that
+  // differ are replaced, and highlighted until the next update. Children
+  // created by a provider are repopulated from it only if they've been
+  // created already. Takes ownership of the nodes, which are best created
+  // with a NULL TreeGrid so that building them doesn't touch this one.
+  void UpdateNodes(std::vector<TreeGridNode*>* nodes);
+
+  // Sorts the top-level nodes by their text in |column|, comparing as numbers
+  // where both are, or shows them in the order of Nodes() if |column| is -1.
+  // Clicking a column's header sorts by it, or reverses the order if it's
+  // already sorted by that column.
+  void SetSortColumn(int column, bool ascending);
+  int GetSortColumn() const { return sort_column_; }
+  bool SortAscending() const { return sort_ascending_; }
+
+  // Shows only the top-level nodes that have |filter| in one of their values,
+  // ignoring ASCII case. Typing while the grid has focus edits the filter,
+  // and Esc clears it.
+  void SetFilter(const std::string& filter);
+  const std::string& GetFilter() const { return filter_; }
+
+  // Sorting and filtering are done by a worker over a copy of the top-level
+  // values, and the result is shown from the first Render() after it's
+  // ready. Until then, the previous order is shown. The view is recalculated
+  // when the top-level nodes change, including by UpdateNodes().
+  bool IsViewPending() const { return view_stale_ || view_job_; }
+  // Blocks until the pending sort or filter is shown.
+  void WaitForViewForTesting();
+
   void Render() override;
 
   bool CouldStartDrag(DragSetup* drag_setup) override;
@@ -121,14 +346,48 @@ class TreeGrid : public Widget {
   bool WantMouseEvents() override { return true; }
   bool WantKeyEvents() override { return true; }
   bool NotifyKey(Key::Enum key, bool down, uint8_t modifiers) override;
+  bool NotifyChar(int character) override;
+  bool NotifyMouseWheel(int x, int y, float delta, uint8_t modifiers) override;
   bool NotifyMouseButton(int x,
                          int y,
                          MouseButton::Enum button,
                          bool down,
                          uint8_t modifiers) override;
 
+  // ScrollHelperDataProvider:
+  int GetContentSize() override;
+  const Rect& GetScreenRect() const override;
+
   std::vector<float> GetColumnWidths(float layout_in_width) const;
 
+  // Fits the |column|th column to its values, taking the width from or
+  // giving it to the column on its right, as double-clicking the splitter
+  // on its right does. Widths are estimated on a worker from a sample of the
+  // rows, starting with those in view, that grows over the next few frames,
+  // so the column may widen as wider values are found. Does nothing for the
+  // last column. Any fit that's still in progress is cancelled, so -1 just
+  // cancels.
+  void AutoSizeColumn(int column);
+  bool IsAutoSizePending() const { return !!auto_size_job_; }
+  // Blocks until every round of sampling has been applied.
+  void WaitForAutoSizeForTesting();
+
+  // Formats the pending values as they come into view, on workers. The text
+  // is cached by key until InvalidateFormattedValues(), so values with the
+  // same key are only formatted once. Formatting is abandoned for values
+  // that are scrolled out of view before it finishes. Not owned, and must
+  // outlive the grid. NULL leaves values pending.
+  void SetValueFormatter(TreeGridValueFormatter* formatter);
+  // Forgets the text of every key, e.g. when the debuggee has run and its
+  // memory may have changed, and cancels formatting that's in progress.
+  // Values that have already been formatted are shown until they're
+  // replaced, e.g. by UpdateNodes().
+  void InvalidateFormattedValues();
+  // Whether any values in view are being formatted.
+  bool IsFormatPending() const { return !format_requests_.empty(); }
+  // Blocks until the pending values in view are formatted, and shows them.
+  void WaitForFormattingForTesting();
+
   // Unset is read-only.
   void SetEditObserver(std::unique_ptr<TreeGridEditObserver> observer);
 
@@ -137,6 +396,10 @@ class TreeGrid : public Widget {
     kFocusDown,
     kFocusLeft,
     kFocusRight,
+    kFocusPageUp,
+    kFocusPageDown,
+    kFocusHome,
+    kFocusEnd,
   };
   void MoveFocusByDirection(FocusDirection direction);
 
@@ -147,6 +410,22 @@ class TreeGrid : public Widget {
   TreeGridNode* GetFocusedNode() { return focused_node_; }
 
  private:
+  friend class TreeGridColumn;
+  friend class TreeGridNode;
+
+  struct ViewSnapshot;
+  struct ViewJob;
+  struct AutoSizeJob;
+  struct FormatRequest;
+
+  // A visible row: |parent|'s |index|th child.
+  struct RowPosition {
+    RowPosition(TreeGridNode* parent, size_t index)
+        : parent(parent), index(index) {}
+    TreeGridNode* parent;
+    size_t index;
+  };
+
   struct LayoutData {
     struct RectAndNode {
       RectAndNode(const Rect& rect, TreeGridNode* node)
@@ -163,8 +442,13 @@ class TreeGrid : public Widget {
       int index;
     };
 
+    // Each visible row has one cell per column, in order, and the rows are
+    // |kRowHeight| apart from |first_row_y|. |row_expansion_boxes| is the
+    // index of each row's expansion box, or -1 if it has none.
     std::vector<RectNodeAndIndex> cells;
     std::vector<RectAndNode> expansion_boxes;
+    std::vector<int> row_expansion_boxes;
+    float first_row_y;
     std::vector<float> column_splitters;
     std::vector<float> column_widths;
     std::vector<Rect> header_columns;
@@ -172,6 +456,11 @@ class TreeGrid : public Widget {
     Rect header;
     Rect body;
     Rect focus;
+
+    // What the layout was calculated for.
+    Rect client_rect;
+    int scroll_offset;
+    const TreeGridNode* focused_node;
   };
 
   TreeGridNode* focused_node_;
@@ -180,21 +469,116 @@ class TreeGrid : public Widget {
   // TODO(scottmg): This should eventually be a pluggable thing.
   std::unique_ptr<TextEdit> inline_edit_;
 
-  LayoutData CalculateLayout(const Rect& client_rect);
-  void CalculateLayoutNodes(const std::vector<TreeGridNode*>& nodes,
-                            const std::vector<float>& column_widths,
-                            const float depth_per_indent,
-                            float current_indent,
-                            float* y_position,
-                            TreeGrid::LayoutData* layout_data);
+  // Returns the last layout if nothing it depends on has changed since.
+  const LayoutData& GetLayout();
+  // Called when the tree or the columns change.
+  void InvalidateLayout();
+  void CalculateLayout(const Rect& client_rect, LayoutData* layout_data);
+  void AddRowToLayout(TreeGridNode* node,
+                      int depth,
+                      float y_position,
+                      TreeGrid::LayoutData* layout_data);
+
+  // Starts calculating the sort and filter for the current top-level nodes,
+  // cancelling any that's in progress.
+  void StartViewJob();
+  static void RunViewJob(void* user_data);
+  // Shows the result of the view job if it's finished.
+  void ApplyFinishedViewJob();
+  // Starts a new view job if the nodes have changed, and shows the last one's
+  // result if it's ready.
+  void UpdateView();
+  // Called before the top-level nodes change.
+  void NodesWillChange();
+  // After the top-level nodes change, shows those that were shown before
+  // and any new ones, in the previous order, until the view job finishes.
+  void ShowProvisionalView();
+  void SetView(const std::vector<TreeGridNode*>* view);
+  void NotifyHeaderClicked(int column);
+
+  // Samples the rows for the |round|th round of fitting |column|, after
+  // earlier rounds sampled |rows_sampled| rows and found |width|.
+  void StartAutoSizeJob(int column, int round, int rows_sampled, float width);
+  static void RunAutoSizeJob(void* user_data);
+  // Resizes the column if the job is finished, and starts the next round.
+  void ApplyFinishedAutoSizeJob();
+
+  // Replaces the pending values in view with their text if it's ready,
+  // starts formatting those that aren't, and cancels formatting for values
+  // that are no longer in view.
+  void UpdateFormattedValues();
+  static void RunFormatRequest(void* user_data);
+  // Cancels all formatting that's in progress.
+  void CancelFormatRequests();
+
+  // Hit tests against |layout_data|, in client coordinates. Return NULL or -1
+  // if nothing was hit.
+  TreeGridNode* ExpansionBoxAtPoint(const LayoutData& layout_data,
+                                    const Point& point);
+  TreeGridNode* NodeAtPoint(const LayoutData& layout_data, const Point& point);
+  int ColumnSplitterAtPoint(const LayoutData& layout_data, const Point& point);
+
+  // Row of |node| counting from the first top-level node, or -1 if it's
+  // inside a collapsed node.
+  int GetRowOfNode(TreeGridNode* node);
+  // Fills |path| with the position of the node on |row| and each of its
+  // ancestors, from the top level down. |row| must be less than
+  // VisibleRowCount().
+  void GetPathToRow(int row, std::vector<RowPosition>* path);
+  TreeGridNode* GetNodeAtRow(int row);
+  // How many rows Page Up and Page Down move by.
+  int GetRowsPerPage();
+  void ScrollToShowFocusedNode();
 
   TreeGridNode* GetLastVisibleChild(TreeGridNode* root);
   TreeGridNode* GetNextVisibleInDirection(TreeGridNode* node,
                                           FocusDirection direction);
   TreeGridNode* GetSibling(TreeGridNode* node, int direction);
 
-  std::vector<TreeGridNode*> nodes_;
+  // Always expanded, and not drawn. Its children are the top-level nodes,
+  // though their Parent() is NULL.
+  TreeGridNode root_;
   std::vector<TreeGridColumn*> columns_;
+  ScrollHelper scroll_;
+
+  LayoutData layout_;
+  bool layout_valid_;
+
+  // Incremented by UpdateNodes(), so that the previous update's changed
+  // values stop being highlighted without visiting them.
+  uint32_t update_generation_;
+
+  int sort_column_;
+  bool sort_ascending_;
+  std::string filter_;
+  // The top-level nodes in the order they're shown, when sorted or filtered.
+  std::vector<TreeGridNode*> view_nodes_;
+  // Incremented whenever the top-level nodes might change, so that a view
+  // job's result is only used for the nodes it was calculated from.
+  uint32_t nodes_generation_;
+  // Whether the top-level nodes have changed since the view was calculated.
+  bool view_stale_;
+  // The values the view is calculated from, shared by the jobs until the
+  // nodes change.
+  std::shared_ptr<const ViewSnapshot> view_snapshot_;
+  // What |view_nodes_| was calculated from.
+  std::shared_ptr<const ViewSnapshot> shown_snapshot_;
+  std::shared_ptr<ViewJob> view_job_;
+  std::shared_ptr<AutoSizeJob> auto_size_job_;
+  // For noticing double clicks on a splitter.
+  int last_splitter_pressed_;
+  double last_splitter_press_time_;
+
+  TreeGridValueFormatter* formatter_;
+  // The text of each key that's been formatted, until the values are
+  // invalidated.
+  std::unordered_map<std::string, std::string> format_cache_;
+  // Formatting in progress for the values in view, by key.
+  std::unordered_map<std::string, std::shared_ptr<FormatRequest>>
+      format_requests_;
+
+  // Waited for on destruction, as the jobs refer to the grid.
+  std::unique_ptr<TaskGroup> tasks_;
 
   DISALLOW_COPY_AND_ASSIGN(TreeGrid);
 };
@@ -0,0 +1,55 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+
+#include "bench.h"
+#include "tree_grid.h"
+
+// Building and tearing down a watch of a large array, per element.
+BENCHMARK(TreeGrid_BuildAndDestroy) {
+  TreeGrid tree_grid;
+  TreeGridNode* array = new TreeGridNode(&tree_grid, NULL);
+  tree_grid.Nodes()->push_back(array);
+  std::vector<TreeGridNode*>* elements = array->Nodes();
+  elements->reserve(iterations);
+  char name[32];
+  for (int i = 0; i < iterations; ++i) {
+    TreeGridNode* element = new TreeGridNode(&tree_grid, array);
+    elements->push_back(element);
+    snprintf(name, sizeof(name), "[%d]", i);
+    element->SetValue(0, new TreeGridNodeValueString(name));
+    element->SetValue(1, new TreeGridNodeValueString("0"));
+    element->SetValue(2, new TreeGridNodeValueString("int"));
+  }
+  array->SetExpanded(true);
+  CHECK(tree_grid.VisibleRowCount() == iterations + 1);
+}
+
+// Sorting and filtering 100k top-level nodes in the background, per
+// keystroke.
+BENCHMARK(TreeGrid_SortAndFilter) {
+  const int kNumNodes = 100000;
+  static TreeGrid* tree_grid;
+  if (!tree_grid) {
+    tree_grid = new TreeGrid;
+    tree_grid->Columns()->push_back(new TreeGridColumn(tree_grid, "Name"));
+    tree_grid->Columns()->push_back(new TreeGridColumn(tree_grid, "Value"));
+    char text[32];
+    for (int i = 0; i < kNumNodes; ++i) {
+      TreeGridNode* node = new TreeGridNode(tree_grid, NULL);
+      tree_grid->Nodes()->push_back(node);
+      snprintf(text, sizeof(text), "local_%d", i);
+      node->SetValue(0, new TreeGridNodeValueString(text));
+      snprintf(text, sizeof(text), "%d", (i * 7919) % kNumNodes);
+      node->SetValue(1, new TreeGridNodeValueString(text));
+    }
+    tree_grid->SetSortColumn(1, true);
+  }
+  const char* kFilters[] = {"l", "lo", "local_1", "local_12", "local_1"};
+  for (int i = 0; i < iterations; ++i) {
+    tree_grid->SetFilter(kFilters[i % (sizeof(kFilters) / sizeof(*kFilters))]);
+    tree_grid->WaitForViewForTesting();
+  }
+}
@@ -6,6 +6,12 @@
 
 #include <gtest/gtest.h>
 
+#include "display_list.h"
+#include "draggable.h"
+#include "frame_scheduler.h"
+#include "text_width.h"
+#include "threading.h"
+
 TEST(TreeGridTest, ColumnLayout) {
   TreeGrid tg;
 
@@ -354,3 +360,852 @@ TEST(TreeGridTest, RemoveNode) {
 */
 
 // TODO(scottmg): Leakiness test.
+
+TEST(TreeGridTest, VisibleRowCountFollowsExpansion) {
+  TreeGrid tg;
+  FillWatchWithSampleData(&tg);
+  EXPECT_EQ(2, tg.VisibleRowCount());
+
+  tg.Nodes()->at(0)->SetExpanded(true);
+  EXPECT_EQ(6, tg.VisibleRowCount());
+
+  tg.Nodes()->at(0)->Nodes()->at(2)->SetExpanded(true);
+  EXPECT_EQ(8, tg.VisibleRowCount());
+
+  // Collapsing a parent hides expanded descendants too.
+  tg.Nodes()->at(0)->SetExpanded(false);
+  EXPECT_EQ(2, tg.VisibleRowCount());
+  tg.Nodes()->at(0)->SetExpanded(true);
+  EXPECT_EQ(8, tg.VisibleRowCount());
+
+  // Adding a child through Nodes() is picked up.
+  TreeGridNode* mouse_position = tg.Nodes()->at(0)->Nodes()->at(2);
+  TreeGridNode* z = new TreeGridNode(&tg, mouse_position);
+  mouse_position->Nodes()->push_back(z);
+  FillColumns(z, "z", "0", "int");
+  EXPECT_EQ(9, tg.VisibleRowCount());
+}
+
+TEST(TreeGridTest, ClickSelectsRowInLargeTree) {
+  TreeGrid tg;
+  TreeGridColumn* column = new TreeGridColumn(&tg, "Name");
+  tg.Columns()->push_back(column);
+  column->SetWidthPercentage(1.f);
+
+  TreeGridNode* array = new TreeGridNode(&tg, NULL);
+  tg.Nodes()->push_back(array);
+  array->SetValue(0, new TreeGridNodeValueString("array"));
+  const int kNumElements = 100000;
+  for (int i = 0; i < kNumElements; ++i) {
+    TreeGridNode* element = new TreeGridNode(&tg, array);
+    array->Nodes()->push_back(element);
+    element->SetValue(0, new TreeGridNodeValueString(std::to_string(i)));
+  }
+  array->SetExpanded(true);
+  EXPECT_EQ(kNumElements + 1, tg.VisibleRowCount());
+
+  tg.SetScreenRect(Rect(0, 0, 400, 300));
+  // The header and each row are 22 high, and the first row is |array|.
+  EXPECT_TRUE(
+      tg.NotifyMouseButton(200, 22 * 3 + 5, MouseButton::Left, true, 0));
+  ASSERT_TRUE(tg.GetFocusedNode());
+  EXPECT_EQ("1", tg.GetFocusedNode()->GetValue(0)->AsString());
+}
+
+TEST(TreeGridTest, HitTestsAfterLayoutChanges) {
+  TreeGrid tg;
+  FillWatchWithSampleData(&tg);
+  tg.SetScreenRect(Rect(0, 0, 400, 300));
+
+  // Clicking the expansion box of the first row expands it.
+  EXPECT_TRUE(tg.NotifyMouseButton(32, 22 + 11, MouseButton::Left, true, 0));
+  EXPECT_TRUE(tg.Nodes()->at(0)->Expanded());
+  EXPECT_EQ("this", tg.GetFocusedNode()->GetValue(0)->AsString());
+
+  // The layout has to be recalculated for the children to be hit.
+  EXPECT_TRUE(
+      tg.NotifyMouseButton(200, 22 * 3 + 5, MouseButton::Left, true, 0));
+  EXPECT_EQ("root_", tg.GetFocusedNode()->GetValue(0)->AsString());
+
+  // Likewise after a child is removed.
+  std::vector<TreeGridNode*>* children = tg.Nodes()->at(0)->Nodes();
+  delete children->front();
+  children->erase(children->begin());
+  EXPECT_TRUE(
+      tg.NotifyMouseButton(200, 22 * 3 + 5, MouseButton::Left, true, 0));
+  EXPECT_EQ("mouse_position_", tg.GetFocusedNode()->GetValue(0)->AsString());
+
+  // Nothing below the last row.
+  EXPECT_FALSE(
+      tg.NotifyMouseButton(200, 22 * 10 + 5, MouseButton::Left, true, 0));
+}
+
+TEST(TreeGridTest, ColumnSplitterStartsDrag) {
+  TreeGrid tg;
+  FillWatchWithSampleData(&tg);
+  tg.SetScreenRect(Rect(0, 0, 422, 300));
+
+  // The body is 400 wide after the margin, and the columns are 0.3, 0.7 and
+  // 0.4 of 1.4 of that.
+  float first_splitter = 22 + 400 * 0.3f / 1.4f;
+  DragSetup on_splitter(Point(first_splitter, 100), NULL);
+  EXPECT_TRUE(tg.CouldStartDrag(&on_splitter));
+  EXPECT_EQ(kDragDirectionLeftRight, on_splitter.drag_direction);
+
+  DragSetup between_splitters(Point(first_splitter + 20, 100), NULL);
+  EXPECT_FALSE(tg.CouldStartDrag(&between_splitters));
+
+  // Moving the splitter is picked up.
+  tg.Columns()->at(0)->SetWidthPercentage(0.7f);
+  EXPECT_FALSE(tg.CouldStartDrag(&on_splitter));
+  DragSetup on_moved_splitter(Point(22 + 400 * 0.7f / 1.8f, 100), NULL);
+  EXPECT_TRUE(tg.CouldStartDrag(&on_moved_splitter));
+}
+
+namespace {
+
+// Children are named by their index, and every child has |count| children of
+// its own.
+class CountingProvider : public TreeGridNodeProvider {
+ public:
+  explicit CountingProvider(int count) : count_(count), populated_(0) {}
+
+  int GetChildCount(const TreeGridNode* /*node*/) override { return count_; }
+
+  void PopulateChild(const TreeGridNode* /*node*/,
+                     int index,
+                     TreeGridNode* child) override {
+    ++populated_;
+    child->SetValue(0, new TreeGridNodeValueString(std::to_string(index)));
+    child->SetProvider(this);
+  }
+
+  int populated() const { return populated_; }
+
+ private:
+  int count_;
+  int populated_;
+};
+
+}  // namespace
+
+TEST(TreeGridTest, ProviderCreatesOnlyVisibleChildren) {
+  TreeGrid tg;
+  TreeGridColumn* column = new TreeGridColumn(&tg, "Name");
+  tg.Columns()->push_back(column);
+  column->SetWidthPercentage(1.f);
+
+  const int kNumElements = 10000000;
+  CountingProvider provider(kNumElements);
+  TreeGridNode* array = new TreeGridNode(&tg, NULL);
+  tg.Nodes()->push_back(array);
+  array->SetValue(0, new TreeGridNodeValueString("array"));
+  array->SetProvider(&provider);
+
+  array->SetExpanded(true);
+  EXPECT_EQ(kNumElements + 1, tg.VisibleRowCount());
+  EXPECT_EQ(0, provider.populated());
+
+  tg.SetScreenRect(Rect(0, 0, 400, 300));
+  EXPECT_TRUE(
+      tg.NotifyMouseButton(200, 22 * 3 + 5, MouseButton::Left, true, 0));
+  EXPECT_EQ("1", tg.GetFocusedNode()->GetValue(0)->AsString());
+  // Only the first page.
+  EXPECT_LE(provider.populated(), 256);
+
+  // Expanding a child, which itself has 10M children, shifts the ones after
+  // it down.
+  tg.GetFocusedNode()->SetExpanded(true);
+  EXPECT_EQ(2 * kNumElements + 1, tg.VisibleRowCount());
+  EXPECT_TRUE(
+      tg.NotifyMouseButton(200, 22 * 4 + 5, MouseButton::Left, true, 0));
+  EXPECT_EQ("0", tg.GetFocusedNode()->GetValue(0)->AsString());
+  EXPECT_EQ("1", tg.GetFocusedNode()->Parent()->GetValue(0)->AsString());
+
+  // Focus movement past the end of the page creates the next one.
+  for (int i = 0; i < 300; ++i)
+    tg.MoveFocusByDirection(TreeGrid::kFocusDown);
+  EXPECT_EQ("300", tg.GetFocusedNode()->GetValue(0)->AsString());
+  EXPECT_LE(provider.populated(), 256 * 3);
+
+  // Moving up from the first grandchild gets back to its parent, and then
+  // the child before that.
+  for (int i = 0; i < 301; ++i)
+    tg.MoveFocusByDirection(TreeGrid::kFocusUp);
+  EXPECT_EQ("1", tg.GetFocusedNode()->GetValue(0)->AsString());
+  tg.MoveFocusByDirection(TreeGrid::kFocusUp);
+  EXPECT_EQ("0", tg.GetFocusedNode()->GetValue(0)->AsString());
+  EXPECT_EQ(array, tg.GetFocusedNode()->Parent());
+
+  // Refreshing the children moves focus off the deleted ones.
+  array->SetProvider(&provider);
+  EXPECT_EQ(array, tg.GetFocusedNode());
+  EXPECT_EQ(kNumElements + 1, tg.VisibleRowCount());
+}
+
+TEST(TreeGridTest, FocusMovementHomeEndAndPages) {
+  TreeGrid tg;
+  FillWatchWithSampleData(&tg);
+  tg.Nodes()->at(0)->SetExpanded(true);
+  tg.Nodes()->at(0)->Nodes()->at(2)->SetExpanded(true);
+  // Room for a header and four rows, so pages are three rows.
+  tg.SetScreenRect(Rect(0, 0, 400, 22 * 5));
+
+  tg.MoveFocusByDirection(TreeGrid::kFocusEnd);
+  EXPECT_EQ("target", tg.GetFocusedNode()->GetValue(0)->AsString());
+  tg.MoveFocusByDirection(TreeGrid::kFocusHome);
+  EXPECT_EQ("this", tg.GetFocusedNode()->GetValue(0)->AsString());
+
+  tg.MoveFocusByDirection(TreeGrid::kFocusPageDown);
+  EXPECT_EQ("mouse_position_", tg.GetFocusedNode()->GetValue(0)->AsString());
+  tg.MoveFocusByDirection(TreeGrid::kFocusPageDown);
+  EXPECT_EQ("draggable_", tg.GetFocusedNode()->GetValue(0)->AsString());
+  tg.MoveFocusByDirection(TreeGrid::kFocusPageDown);
+  EXPECT_EQ("target", tg.GetFocusedNode()->GetValue(0)->AsString());
+
+  tg.MoveFocusByDirection(TreeGrid::kFocusPageUp);
+  EXPECT_EQ("x", tg.GetFocusedNode()->GetValue(0)->AsString());
+  tg.MoveFocusByDirection(TreeGrid::kFocusPageUp);
+  EXPECT_EQ("InputHandler", tg.GetFocusedNode()->GetValue(0)->AsString());
+  tg.MoveFocusByDirection(TreeGrid::kFocusPageUp);
+  EXPECT_EQ("this", tg.GetFocusedNode()->GetValue(0)->AsString());
+}
+
+TEST(TreeGridTest, FocusMovementThroughWideTree) {
+  TreeGrid tg;
+  const int kNumNodes = 100000;
+  for (int i = 0; i < kNumNodes; ++i) {
+    TreeGridNode* node = new TreeGridNode(&tg, NULL);
+    tg.Nodes()->push_back(node);
+    node->SetValue(0, new TreeGridNodeValueString(std::to_string(i)));
+  }
+
+  // Each step finds the focused node's index directly, so this is linear.
+  for (int i = 0; i < kNumNodes; ++i)
+    tg.MoveFocusByDirection(TreeGrid::kFocusDown);
+  EXPECT_EQ("99999", tg.GetFocusedNode()->GetValue(0)->AsString());
+  for (int i = 0; i < kNumNodes / 2; ++i)
+    tg.MoveFocusByDirection(TreeGrid::kFocusUp);
+  EXPECT_EQ("49999", tg.GetFocusedNode()->GetValue(0)->AsString());
+
+  // Indices are kept right after the children change.
+  std::vector<TreeGridNode*>* nodes = tg.Nodes();
+  delete nodes->front();
+  nodes->erase(nodes->begin());
+  tg.MoveFocusByDirection(TreeGrid::kFocusUp);
+  EXPECT_EQ("49998", tg.GetFocusedNode()->GetValue(0)->AsString());
+}
+
+namespace {
+
+// Every character is 5 wide.
+float FakeMeasure(Font /*font*/, StringPiece str) {
+  return 5.f * str.size();
+}
+
+// There's no graphics device in tests, so text is measured by FakeMeasure()
+// while this is in scope, e.g. by cells that are drawn, or by fitting columns.
+class ScopedFakeTextWidths {
+ public:
+  ScopedFakeTextWidths() { SetMeasureTextWidthFnForTesting(FakeMeasure); }
+  ~ScopedFakeTextWidths() { SetMeasureTextWidthFnForTesting(NULL); }
+};
+
+void AddNameAndValueColumns(TreeGrid* tg) {
+  tg->Columns()->push_back(new TreeGridColumn(tg, "Name"));
+  tg->Columns()->push_back(new TreeGridColumn(tg, "Value"));
+  tg->Columns()->at(0)->SetWidthPercentage(0.5f);
+  tg->Columns()->at(1)->SetWidthPercentage(0.5f);
+}
+
+// Likewise, drawing is recorded instead. Needs a ScopedFakeTextWidths.
+void RecordRender(TreeGrid* tg) {
+  DisplayList list;
+  ScopedDisplayListRecorder recorder(&list);
+  tg->Render();
+}
+
+// A node for TreeGrid::UpdateNodes(), built outside the grid.
+TreeGridNode* NewWatchNode(TreeGridNode* parent,
+                           const char* name,
+                           const char* value) {
+  TreeGridNode* node = new TreeGridNode(NULL, parent);
+  if (parent)
+    parent->Nodes()->push_back(node);
+  node->SetValue(0, new TreeGridNodeValueString(name));
+  node->SetValue(1, new TreeGridNodeValueString(value));
+  return node;
+}
+
+}  // namespace
+
+TEST(TreeGridTest, UpdateNodesKeepsStateAndMarksChanges) {
+  TreeGrid tg;
+  FillWatchWithSampleData(&tg);
+  TreeGridNode* this_node = tg.Nodes()->at(0);
+  TreeGridNode* mouse_position = this_node->Nodes()->at(2);
+  TreeGridNode* x = mouse_position->Nodes()->at(0);
+  this_node->SetExpanded(true);
+  mouse_position->SetExpanded(true);
+  for (int i = 0; i < 5; ++i)
+    tg.MoveFocusByDirection(TreeGrid::kFocusDown);
+  ASSERT_EQ(x, tg.GetFocusedNode());
+  EXPECT_EQ(8, tg.VisibleRowCount());
+
+  // The next stop: x changed, |target| went out of scope, and there's a new
+  // local at the top.
+  std::vector<TreeGridNode*> nodes;
+  nodes.push_back(NewWatchNode(NULL, "i", "0"));
+  TreeGridNode* fresh_this = NewWatchNode(NULL, "this", "{...}");
+  nodes.push_back(fresh_this);
+  NewWatchNode(fresh_this, "InputHandler", "{...}");
+  NewWatchNode(fresh_this, "root_", "unique_ptr {...}");
+  TreeGridNode* fresh_mouse_position =
+      NewWatchNode(fresh_this, "mouse_position_", "{x=1925 y=440 }");
+  NewWatchNode(fresh_mouse_position, "x", "1925");
+  NewWatchNode(fresh_mouse_position, "y", "440");
+  NewWatchNode(fresh_this, "draggable_", "empty");
+  tg.UpdateNodes(&nodes);
+
+  ASSERT_EQ(2u, tg.Nodes()->size());
+  EXPECT_EQ("i", tg.Nodes()->at(0)->GetValue(0)->AsString());
+  EXPECT_EQ(this_node, tg.Nodes()->at(1));
+  EXPECT_EQ(NULL, this_node->Parent());
+  EXPECT_TRUE(this_node->Expanded());
+  EXPECT_TRUE(mouse_position->Expanded());
+  EXPECT_EQ(x, tg.GetFocusedNode());
+  EXPECT_EQ(8, tg.VisibleRowCount());
+
+  EXPECT_EQ("1925", x->GetValue(1)->AsString());
+  EXPECT_TRUE(x->ValueChanged(1));
+  EXPECT_FALSE(x->ValueChanged(0));
+  EXPECT_TRUE(mouse_position->ValueChanged(1));
+  EXPECT_FALSE(mouse_position->Nodes()->at(1)->ValueChanged(1));
+  EXPECT_FALSE(tg.Nodes()->at(0)->ValueChanged(1));
+  // The type column wasn't given, so it's cleared.
+  EXPECT_EQ(NULL, x->GetValue(2));
+
+  // Focus moves by the new order.
+  tg.MoveFocusByDirection(TreeGrid::kFocusHome);
+  EXPECT_EQ("i", tg.GetFocusedNode()->GetValue(0)->AsString());
+  tg.MoveFocusByDirection(TreeGrid::kFocusDown);
+  EXPECT_EQ(this_node, tg.GetFocusedNode());
+
+  // Nothing changes on the next stop, so nothing's highlighted.
+  nodes.push_back(NewWatchNode(NULL, "i", "0"));
+  fresh_this = NewWatchNode(NULL, "this", "{...}");
+  nodes.push_back(fresh_this);
+  NewWatchNode(fresh_this, "InputHandler", "{...}");
+  NewWatchNode(fresh_this, "root_", "unique_ptr {...}");
+  fresh_mouse_position =
+      NewWatchNode(fresh_this, "mouse_position_", "{x=1925 y=440 }");
+  NewWatchNode(fresh_mouse_position, "x", "1925");
+  NewWatchNode(fresh_mouse_position, "y", "440");
+  NewWatchNode(fresh_this, "draggable_", "empty");
+  tg.UpdateNodes(&nodes);
+  EXPECT_EQ(x, mouse_position->Nodes()->at(0));
+  EXPECT_FALSE(x->ValueChanged(1));
+  EXPECT_FALSE(mouse_position->ValueChanged(1));
+}
+
+TEST(TreeGridTest, UpdateNodesMatchesByName) {
+  TreeGrid tg;
+  std::vector<TreeGridNode*> nodes;
+  for (const char* name : {"a", "b", "c", "b"})
+    nodes.push_back(NewWatchNode(NULL, name, "1"));
+  tg.UpdateNodes(&nodes);
+  EXPECT_TRUE(nodes.empty());
+  std::vector<TreeGridNode*> old_nodes = *tg.Nodes();
+  tg.MoveFocusByDirection(TreeGrid::kFocusEnd);
+  EXPECT_EQ(old_nodes[3], tg.GetFocusedNode());
+
+  // Reordered, with repeated names matched in order.
+  for (const char* name : {"c", "b", "a"})
+    nodes.push_back(NewWatchNode(NULL, name, "1"));
+  tg.UpdateNodes(&nodes);
+  ASSERT_EQ(3u, tg.Nodes()->size());
+  EXPECT_EQ(old_nodes[2], tg.Nodes()->at(0));
+  EXPECT_EQ(old_nodes[1], tg.Nodes()->at(1));
+  EXPECT_EQ(old_nodes[0], tg.Nodes()->at(2));
+  EXPECT_FALSE(tg.Nodes()->at(1)->ValueChanged(1));
+  // The second "b" had focus, and is gone.
+  EXPECT_EQ(NULL, tg.GetFocusedNode());
+  tg.MoveFocusByDirection(TreeGrid::kFocusDown);
+  tg.MoveFocusByDirection(TreeGrid::kFocusDown);
+  EXPECT_EQ(old_nodes[1], tg.GetFocusedNode());
+  EXPECT_EQ(3, tg.VisibleRowCount());
+}
+
+TEST(TreeGridTest, UpdateNodesRepopulatesOnlyCreatedChildren) {
+  ScopedFakeTextWidths fake_text_widths;
+  TreeGrid tg;
+  TreeGridColumn* column = new TreeGridColumn(&tg, "Name");
+  tg.Columns()->push_back(column);
+  column->SetWidthPercentage(1.f);
+  tg.SetScreenRect(Rect(0, 0, 400, 300));
+
+  const int kNumElements = 10000000;
+  CountingProvider provider(kNumElements);
+  std::vector<TreeGridNode*> nodes;
+  nodes.push_back(NewWatchNode(NULL, "array", "{...}"));
+  nodes.back()->SetProvider(&provider);
+  tg.UpdateNodes(&nodes);
+  TreeGridNode* array = tg.Nodes()->at(0);
+  array->SetExpanded(true);
+  EXPECT_TRUE(
+      tg.NotifyMouseButton(200, 22 * 3 + 5, MouseButton::Left, true, 0));
+  TreeGridNode* one = tg.GetFocusedNode();
+  ASSERT_EQ("1", one->GetValue(0)->AsString());
+  one->SetExpanded(true);
+  RecordRender(&tg);
+  EXPECT_EQ(2 * kNumElements + 1, tg.VisibleRowCount());
+
+  // Only the children that were created are looked at again.
+  CountingProvider smaller_provider(1000);
+  nodes.push_back(NewWatchNode(NULL, "array", "{...}"));
+  nodes.back()->SetProvider(&smaller_provider);
+  tg.UpdateNodes(&nodes);
+  EXPECT_EQ(array, tg.Nodes()->at(0));
+  EXPECT_EQ(one, tg.GetFocusedNode());
+  EXPECT_TRUE(one->Expanded());
+  EXPECT_EQ(2 * 1000 + 1, tg.VisibleRowCount());
+  EXPECT_LE(smaller_provider.populated(), 256 * 2);
+
+  // Shrinking below the focused child deletes it.
+  CountingProvider tiny_provider(1);
+  nodes.push_back(NewWatchNode(NULL, "array", "{...}"));
+  nodes.back()->SetProvider(&tiny_provider);
+  tg.UpdateNodes(&nodes);
+  EXPECT_EQ(array, tg.GetFocusedNode());
+  EXPECT_EQ(2, tg.VisibleRowCount());
+  RecordRender(&tg);
+}
+
+namespace {
+
+std::vector<std::string> TopLevelNames(TreeGrid* tg, size_t count) {
+  std::vector<std::string> names;
+  for (int row = 0; row < tg->VisibleRowCount() && names.size() < count;
+       ++row) {
+    tg->MoveFocusByDirection(row == 0 ? TreeGrid::kFocusHome
+                                      : TreeGrid::kFocusDown);
+    names.push_back(tg->GetFocusedNode()->GetValue(0)->AsString());
+  }
+  return names;
+}
+
+}  // namespace
+
+TEST(TreeGridTest, SortAndFilterLargeTree) {
+  TreeGrid tg;
+  tg.Columns()->push_back(new TreeGridColumn(&tg, "Name"));
+  tg.Columns()->push_back(new TreeGridColumn(&tg, "Value"));
+  const int kNumNodes = 20000;
+  for (int i = 0; i < kNumNodes; ++i) {
+    TreeGridNode* node = new TreeGridNode(&tg, NULL);
+    tg.Nodes()->push_back(node);
+    node->SetValue(0, new TreeGridNodeValueString("Item" + std::to_string(i)));
+    // Numbers sort numerically, not by their text.
+    node->SetValue(1, new TreeGridNodeValueString(std::to_string(i % 1000)));
+  }
+
+  tg.SetSortColumn(1, false);
+  EXPECT_TRUE(tg.IsViewPending());
+  tg.WaitForViewForTesting();
+  EXPECT_FALSE(tg.IsViewPending());
+  EXPECT_EQ(kNumNodes, tg.VisibleRowCount());
+  // Equal values stay in their original order.
+  std::vector<std::string> expected = {"Item999", "Item1999", "Item2999"};
+  EXPECT_EQ(expected, TopLevelNames(&tg, 3));
+
+  // Filtering keeps the sort, and ignores case.
+  tg.SetFilter("ITEM1234");
+  tg.WaitForViewForTesting();
+  expected = {"Item12349", "Item12348", "Item12347"};
+  EXPECT_EQ(expected, TopLevelNames(&tg, 3));
+  EXPECT_EQ(11, tg.VisibleRowCount());
+
+  // Focus doesn't stay on a node that's filtered out.
+  tg.SetFilter("item12340");
+  tg.WaitForViewForTesting();
+  EXPECT_EQ(1, tg.VisibleRowCount());
+  EXPECT_EQ(NULL, tg.GetFocusedNode());
+
+  tg.SetFilter(std::string());
+  tg.SetSortColumn(-1, true);
+  EXPECT_EQ(kNumNodes, tg.VisibleRowCount());
+  expected = {"Item0", "Item1"};
+  EXPECT_EQ(expected, TopLevelNames(&tg, 2));
+}
+
+TEST(TreeGridTest, HeaderClickSortsAndTypingFilters) {
+  TreeGrid tg;
+  FillWatchWithSampleData(&tg);
+  tg.SetScreenRect(Rect(0, 0, 400, 300));
+
+  EXPECT_TRUE(tg.NotifyMouseButton(30, 5, MouseButton::Left, true, 0));
+  EXPECT_EQ(0, tg.GetSortColumn());
+  EXPECT_TRUE(tg.SortAscending());
+  tg.WaitForViewForTesting();
+  std::vector<std::string> expected = {"target", "this"};
+  EXPECT_EQ(expected, TopLevelNames(&tg, 2));
+
+  EXPECT_TRUE(tg.NotifyMouseButton(30, 5, MouseButton::Left, true, 0));
+  EXPECT_FALSE(tg.SortAscending());
+  tg.WaitForViewForTesting();
+  expected = {"this", "target"};
+  EXPECT_EQ(expected, TopLevelNames(&tg, 2));
+
+  EXPECT_TRUE(tg.NotifyChar('T'));
+  EXPECT_TRUE(tg.NotifyChar('h'));
+  EXPECT_EQ("Th", tg.GetFilter());
+  tg.WaitForViewForTesting();
+  EXPECT_EQ(1, tg.VisibleRowCount());
+  EXPECT_TRUE(tg.NotifyKey(Key::Backspace, true, 0));
+  tg.WaitForViewForTesting();
+  EXPECT_EQ(2, tg.VisibleRowCount());
+  tg.NotifyChar('x');
+  EXPECT_TRUE(tg.NotifyKey(Key::Esc, true, 0));
+  EXPECT_EQ("", tg.GetFilter());
+  EXPECT_FALSE(tg.NotifyKey(Key::Esc, true, 0));
+}
+
+TEST(TreeGridTest, ViewFollowsUpdatedNodes) {
+  TreeGrid tg;
+  tg.Columns()->push_back(new TreeGridColumn(&tg, "Name"));
+  tg.Columns()->push_back(new TreeGridColumn(&tg, "Value"));
+  std::vector<TreeGridNode*> nodes;
+  for (const char* name : {"b", "a", "c"})
+    nodes.push_back(NewWatchNode(NULL, name, "1"));
+  tg.UpdateNodes(&nodes);
+  tg.SetSortColumn(0, true);
+  tg.WaitForViewForTesting();
+  std::vector<std::string> expected = {"a", "b", "c"};
+  EXPECT_EQ(expected, TopLevelNames(&tg, 3));
+
+  // Until the view's recalculated, the nodes are shown unsorted.
+  for (const char* name : {"d", "c", "a"})
+    nodes.push_back(NewWatchNode(NULL, name, "1"));
+  tg.UpdateNodes(&nodes);
+  EXPECT_TRUE(tg.IsViewPending());
+  expected = {"d", "c", "a"};
+  EXPECT_EQ(expected, TopLevelNames(&tg, 3));
+  tg.WaitForViewForTesting();
+  expected = {"a", "c", "d"};
+  EXPECT_EQ(expected, TopLevelNames(&tg, 3));
+
+  TreeGridNode* b = new TreeGridNode(&tg, NULL);
+  tg.Nodes()->push_back(b);
+  b->SetValue(0, new TreeGridNodeValueString("b"));
+  tg.WaitForViewForTesting();
+  expected = {"a", "b", "c", "d"};
+  EXPECT_EQ(expected, TopLevelNames(&tg, 4));
+}
+
+TEST(TreeGridTest, FilteringWhileScrolledToEndShowsRows) {
+  ScopedFakeTextWidths fake_text_widths;
+  TreeGrid tg;
+  AddNameAndValueColumns(&tg);
+  const int kNumNodes = 1000;
+  for (int i = 0; i < kNumNodes; ++i) {
+    TreeGridNode* node = new TreeGridNode(&tg, NULL);
+    tg.Nodes()->push_back(node);
+    node->SetValue(0, new TreeGridNodeValueString("node_" + std::to_string(i)));
+  }
+  tg.SetScreenRect(Rect(0, 0, 400, 300));
+
+  // Let the scroll to the end finish.
+  EXPECT_TRUE(tg.NotifyKey(Key::End, true, 0));
+  for (int frame = 0; frame < 300; ++frame) {
+    SetFrameTime(frame / 60.0);
+    RecordRender(&tg);
+  }
+  SetFrameTime(0.0);
+  EXPECT_EQ("node_999", tg.GetFocusedNode()->GetValue(0)->AsString());
+
+  // Far fewer rows match than the offset was past. The offset is pulled
+  // back as far as it can scroll, which leaves the last row at the top.
+  tg.SetFilter("node_99");
+  tg.WaitForViewForTesting();
+  EXPECT_EQ(11, tg.VisibleRowCount());
+  EXPECT_TRUE(tg.NotifyMouseButton(200, 22 + 5, MouseButton::Left, true, 0));
+  ASSERT_TRUE(tg.GetFocusedNode());
+  EXPECT_EQ("node_999", tg.GetFocusedNode()->GetValue(0)->AsString());
+
+  // Collapsing down to a single row works too.
+  tg.SetFilter("node_998");
+  tg.WaitForViewForTesting();
+  EXPECT_TRUE(tg.NotifyMouseButton(200, 22 + 5, MouseButton::Left, true, 0));
+  ASSERT_TRUE(tg.GetFocusedNode());
+  EXPECT_EQ("node_998", tg.GetFocusedNode()->GetValue(0)->AsString());
+
+  // And to nothing at all, then scrolling the wheel anyway.
+  tg.SetFilter("nothing");
+  tg.WaitForViewForTesting();
+  EXPECT_EQ(0, tg.VisibleRowCount());
+  EXPECT_TRUE(tg.NotifyMouseWheel(200, 100, -1.f, 0));
+  for (int frame = 0; frame < 60; ++frame) {
+    SetFrameTime(frame / 60.0);
+    RecordRender(&tg);
+  }
+  SetFrameTime(0.0);
+}
+
+TEST(TreeGridTest, WheelOnEmptyTreeStaysAtTop) {
+  ScopedFakeTextWidths fake_text_widths;
+  TreeGrid tg;
+  AddNameAndValueColumns(&tg);
+  tg.SetScreenRect(Rect(0, 0, 400, 300));
+
+  EXPECT_TRUE(tg.NotifyMouseWheel(200, 100, -1.f, 0));
+  for (int frame = 0; frame < 60; ++frame) {
+    SetFrameTime(frame / 60.0);
+    RecordRender(&tg);
+  }
+  SetFrameTime(0.0);
+  EXPECT_EQ(0, tg.VisibleRowCount());
+}
+
+TEST(TreeGridTest, AutoSizeColumnFitsValues) {
+  ScopedFakeTextWidths fake_text_widths;
+  TreeGrid tg;
+  FillWatchWithSampleData(&tg);
+  tg.SetScreenRect(Rect(0, 0, 422, 300));
+  tg.Nodes()->at(0)->SetExpanded(true);
+
+  // The widest name is "mouse_position_", one level in: the padding, the
+  // separator, the indent and the expansion box, and 15 characters.
+  tg.AutoSizeColumn(0);
+  EXPECT_TRUE(tg.IsAutoSizePending());
+  tg.WaitForAutoSizeForTesting();
+  EXPECT_FALSE(tg.IsAutoSizePending());
+  float expected = 3 + 3 + 1 + 22 + 22 + 15 * 5;
+  std::vector<float> widths = tg.GetColumnWidths(400);
+  EXPECT_FLOAT_EQ(expected, widths[0]);
+
+  // Wider than the two columns it's between, so it's limited.
+  tg.AutoSizeColumn(1);
+  tg.WaitForAutoSizeForTesting();
+  std::vector<float> new_widths = tg.GetColumnWidths(400);
+  EXPECT_FLOAT_EQ(expected, new_widths[0]);
+  EXPECT_FLOAT_EQ(widths[1] + widths[2] - 3.f, new_widths[1]);
+
+  // Not the last column.
+  tg.AutoSizeColumn(2);
+  EXPECT_FALSE(tg.IsAutoSizePending());
+}
+
+TEST(TreeGridTest, AutoSizeColumnSamplesLargeTree) {
+  ScopedFakeTextWidths fake_text_widths;
+  TreeGrid tg;
+  tg.Columns()->push_back(new TreeGridColumn(&tg, "Name"));
+  tg.Columns()->push_back(new TreeGridColumn(&tg, "Value"));
+  tg.Columns()->at(0)->SetWidthPercentage(0.2f);
+  tg.Columns()->at(1)->SetWidthPercentage(0.8f);
+  tg.SetScreenRect(Rect(0, 0, 422, 300));
+
+  const int kNumElements = 10000000;
+  CountingProvider provider(kNumElements);
+  TreeGridNode* array = new TreeGridNode(&tg, NULL);
+  tg.Nodes()->push_back(array);
+  array->SetValue(0, new TreeGridNodeValueString("array"));
+  array->SetProvider(&provider);
+  array->SetExpanded(true);
+  RecordRender(&tg);
+  int populated = provider.populated();
+
+  // Only the rows in view have been created, and sampling doesn't create
+  // more.
+  tg.AutoSizeColumn(0);
+  tg.WaitForAutoSizeForTesting();
+  EXPECT_EQ(populated, provider.populated());
+  // The widest in view is "array", or a two digit index a level in.
+  float expected = 3 + 3 + 1 + 22 + 22 + 2 * 5;
+  EXPECT_FLOAT_EQ(expected, tg.GetColumnWidths(400)[0]);
+}
+
+TEST(TreeGridTest, DoubleClickOnSplitterFitsColumn) {
+  ScopedFakeTextWidths fake_text_widths;
+  TreeGrid tg;
+  FillWatchWithSampleData(&tg);
+  tg.SetScreenRect(Rect(0, 0, 422, 300));
+
+  std::unique_ptr<Draggable> draggable;
+  float first_splitter = 22 + 400 * 0.3f / 1.4f;
+  DragSetup press(Point(first_splitter, 100), NULL);
+  press.draggable = &draggable;
+  EXPECT_TRUE(tg.CouldStartDrag(&press));
+  EXPECT_TRUE(draggable.get() != NULL);
+  EXPECT_FALSE(tg.IsAutoSizePending());
+
+  draggable.reset();
+  EXPECT_TRUE(tg.CouldStartDrag(&press));
+  EXPECT_FALSE(draggable.get() != NULL);
+  EXPECT_TRUE(tg.IsAutoSizePending());
+
+  // Starting a drag cancels it.
+  EXPECT_TRUE(tg.CouldStartDrag(&press));
+  EXPECT_TRUE(draggable.get() != NULL);
+  EXPECT_FALSE(tg.IsAutoSizePending());
+}
+
+namespace {
+
+// Formats "key" as "key!", or whatever suffix is set, as reading the value
+// from the debuggee would. While held, it waits until it's cancelled, like
+// a slow read.
+class FakeFormatter : public TreeGridValueFormatter {
+ public:
+  FakeFormatter()
+      : suffix_("!"), held_(false), started_(0), formatted_(0), cancelled_(0) {}
+
+  std::string Format(const std::string& key,
+                     const std::atomic<bool>& cancelled) override {
+    ++started_;
+    while (held_.load() && !cancelled.load())
+      YieldThread();
+    if (cancelled.load()) {
+      ++cancelled_;
+      return std::string();
+    }
+    ++formatted_;
+    return key + suffix_;
+  }
+
+  void set_suffix(const std::string& suffix) { suffix_ = suffix; }
+  void set_held(bool held) { held_.store(held); }
+  int started() const { return started_.load(); }
+  int formatted() const { return formatted_.load(); }
+  int cancelled() const { return cancelled_.load(); }
+
+ private:
+  std::string suffix_;
+  std::atomic<bool> held_;
+  std::atomic<int> started_;
+  std::atomic<int> formatted_;
+  std::atomic<int> cancelled_;
+};
+
+// A node named |name|, whose value is formatted from |key|.
+TreeGridNode* NewPendingNode(TreeGrid* tree_grid,
+                             const std::string& name,
+                             const std::string& key) {
+  TreeGridNode* node = new TreeGridNode(tree_grid, NULL);
+  node->SetValue(0, new TreeGridNodeValueString(name));
+  node->SetValue(1, new TreeGridNodeValuePending(key));
+  return node;
+}
+
+}  // namespace
+
+TEST(TreeGridTest, FormatsPendingValuesInView) {
+  ScopedFakeTextWidths fake_text_widths;
+  FakeFormatter formatter;
+  TreeGrid tg;
+  AddNameAndValueColumns(&tg);
+  // Pairs of rows show the same value.
+  const int kNumNodes = 1000;
+  for (int i = 0; i < kNumNodes; ++i) {
+    tg.Nodes()->push_back(NewPendingNode(
+        &tg, "n" + std::to_string(i), "k" + std::to_string(i / 2)));
+  }
+  tg.SetScreenRect(Rect(0, 0, 400, 300));
+
+  // Nothing happens without a formatter.
+  RecordRender(&tg);
+  EXPECT_FALSE(tg.IsFormatPending());
+  EXPECT_EQ("", tg.Nodes()->at(0)->GetValue(1)->AsString());
+
+  tg.SetValueFormatter(&formatter);
+  RecordRender(&tg);
+  tg.WaitForFormattingForTesting();
+  EXPECT_FALSE(tg.IsFormatPending());
+
+  // The header and 13 rows, partly, fit. Only those are formatted, and only
+  // once for each value.
+  for (int i = 0; i < 13; ++i) {
+    EXPECT_EQ("k" + std::to_string(i / 2) + "!",
+              tg.Nodes()->at(i)->GetValue(1)->AsString());
+    EXPECT_FALSE(tg.Nodes()->at(i)->ValueChanged(1));
+  }
+  EXPECT_EQ("", tg.Nodes()->at(13)->GetValue(1)->AsString());
+  EXPECT_EQ(7, formatter.formatted());
+}
+
+TEST(TreeGridTest, FormattedValuesAreCachedUntilInvalidated) {
+  ScopedFakeTextWidths fake_text_widths;
+  FakeFormatter formatter;
+  TreeGrid tg;
+  AddNameAndValueColumns(&tg);
+  tg.SetValueFormatter(&formatter);
+  tg.SetScreenRect(Rect(0, 0, 400, 300));
+  std::vector<TreeGridNode*> nodes;
+  nodes.push_back(NewPendingNode(NULL, "a", "x"));
+  tg.UpdateNodes(&nodes);
+  RecordRender(&tg);
+  tg.WaitForFormattingForTesting();
+  TreeGridNode* a = tg.Nodes()->at(0);
+  EXPECT_EQ("x!", a->GetValue(1)->AsString());
+  EXPECT_EQ(1, formatter.formatted());
+
+  // Stepping without invalidating: the cached text is shown right away, and
+  // it's the same as before.
+  nodes.push_back(NewPendingNode(NULL, "a", "x"));
+  tg.UpdateNodes(&nodes);
+  EXPECT_EQ(a, tg.Nodes()->at(0));
+  EXPECT_EQ("x!", a->GetValue(1)->AsString());
+  RecordRender(&tg);
+  EXPECT_FALSE(tg.IsFormatPending());
+  EXPECT_EQ("x!", a->GetValue(1)->AsString());
+  EXPECT_FALSE(a->ValueChanged(1));
+  EXPECT_EQ(1, formatter.formatted());
+
+  // The debuggee ran, and the value changed.
+  formatter.set_suffix("?");
+  tg.InvalidateFormattedValues();
+  nodes.push_back(NewPendingNode(NULL, "a", "x"));
+  tg.UpdateNodes(&nodes);
+  RecordRender(&tg);
+  tg.WaitForFormattingForTesting();
+  EXPECT_EQ("x?", a->GetValue(1)->AsString());
+  EXPECT_TRUE(a->ValueChanged(1));
+  EXPECT_EQ(2, formatter.formatted());
+}
+
+TEST(TreeGridTest, ScrollingAwayCancelsFormatting) {
+  ScopedFakeTextWidths fake_text_widths;
+  FakeFormatter formatter;
+  formatter.set_held(true);
+  TreeGrid tg;
+  AddNameAndValueColumns(&tg);
+  tg.SetValueFormatter(&formatter);
+  const int kNumNodes = 1000;
+  for (int i = 0; i < kNumNodes; ++i) {
+    tg.Nodes()->push_back(NewPendingNode(
+        &tg, "n" + std::to_string(i), "k" + std::to_string(i)));
+  }
+  tg.SetScreenRect(Rect(0, 0, 400, 300));
+  RecordRender(&tg);
+  EXPECT_TRUE(tg.IsFormatPending());
+  while (formatter.started() == 0)
+    YieldThread();
+
+  // The scroll is animated, but the first frame already moves well past
+  // the first rows.
+  EXPECT_TRUE(tg.NotifyKey(Key::End, true, 0));
+  RecordRender(&tg);
+  formatter.set_held(false);
+  tg.WaitForFormattingForTesting();
+
+  int shown = 0;
+  for (TreeGridNode* node : *tg.Nodes()) {
+    if (!node->GetValue(1)->AsString().empty())
+      ++shown;
+  }
+  EXPECT_EQ("", tg.Nodes()->at(0)->GetValue(1)->AsString());
+  EXPECT_GT(shown, 0);
+  // Nothing was formatted that isn't shown, and the reads that had started
+  // for the first rows were abandoned.
+  EXPECT_EQ(shown, formatter.formatted());
+  EXPECT_GT(formatter.cancelled(), 0);
+}
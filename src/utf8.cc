@@ -0,0 +1,199 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "utf8.h"
+
+#include <string.h>
+
+#if CPU_X86
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Length of the run of ASCII bytes at the start of |data| (up to |size|),
+// rounded down to a multiple of the block size. The tail is left to the
+// scalar loop.
+size_t AsciiPrefixLength(const char* data, size_t size) {
+  size_t i = 0;
+#if CPU_X86
+  for (; i + 16 <= size; i += 16) {
+    __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    if (_mm_movemask_epi8(chunk) != 0)
+      break;
+  }
+#else
+  for (; i + 8 <= size; i += 8) {
+    uint64_t chunk;
+    memcpy(&chunk, data + i, sizeof(chunk));
+    if (chunk & UINT64_C(0x8080808080808080))
+      break;
+  }
+#endif
+  return i;
+}
+
+// Widens |size| bytes of ASCII, which must be a multiple of the block size
+// used by AsciiPrefixLength().
+void WidenAscii(const char* data, size_t size, uint16_t* out) {
+#if CPU_X86
+  const __m128i zero = _mm_setzero_si128();
+  for (size_t i = 0; i < size; i += 16) {
+    __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_unpacklo_epi8(chunk, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8),
+                     _mm_unpackhi_epi8(chunk, zero));
+  }
+#else
+  for (size_t i = 0; i < size; ++i)
+    out[i] = static_cast<uint8_t>(data[i]);
+#endif
+}
+
+bool IsContinuation(uint8_t byte) {
+  return (byte & 0xc0) == 0x80;
+}
+
+// Decodes a multi-byte sequence starting at |*index| (whose lead byte is not
+// ASCII). Returns false and sets |*index| past the maximal ill-formed
+// subsequence if the input is malformed.
+bool DecodeMultiByte(const uint8_t* data,
+                     size_t size,
+                     size_t* index,
+                     uint32_t* code_point) {
+  uint8_t lead = data[*index];
+  size_t length;
+  // Valid range for the second byte, which rules out overlongs, surrogates,
+  // and values past U+10FFFF.
+  uint8_t second_min = 0x80;
+  uint8_t second_max = 0xbf;
+  uint32_t value;
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    length = 2;
+    value = lead & 0x1f;
+  } else if (lead >= 0xe0 && lead <= 0xef) {
+    length = 3;
+    value = lead & 0x0f;
+    if (lead == 0xe0)
+      second_min = 0xa0;
+    else if (lead == 0xed)
+      second_max = 0x9f;
+  } else if (lead >= 0xf0 && lead <= 0xf4) {
+    length = 4;
+    value = lead & 0x07;
+    if (lead == 0xf0)
+      second_min = 0x90;
+    else if (lead == 0xf4)
+      second_max = 0x8f;
+  } else {
+    // Stray continuation byte, or a lead byte that can't start a valid
+    // sequence.
+    ++*index;
+    return false;
+  }
+
+  size_t i = *index + 1;
+  for (size_t j = 1; j < length; ++j, ++i) {
+    if (i >= size)
+      break;
+    uint8_t byte = data[i];
+    bool ok = j == 1 ? (byte >= second_min && byte <= second_max)
+                     : IsContinuation(byte);
+    if (!ok)
+      break;
+    value = (value << 6) | (byte & 0x3f);
+  }
+  bool complete = i - *index == length;
+  *index = i;
+  if (!complete)
+    return false;
+  *code_point = value;
+  return true;
+}
+
+THREAD uint16_t* g_scratch;
+THREAD size_t g_scratch_capacity;
+
+}  // namespace
+
+bool IsValidUTF8(StringPiece str) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(str.data());
+  size_t size = str.size();
+  size_t i = 0;
+  while (i < size) {
+    i += AsciiPrefixLength(str.data() + i, size - i);
+    if (i >= size)
+      break;
+    if (data[i] < 0x80) {
+      ++i;
+      continue;
+    }
+    uint32_t code_point;
+    if (!DecodeMultiByte(data, size, &i, &code_point))
+      return false;
+  }
+  return true;
+}
+
+uint32_t DecodeUTF8(StringPiece str, size_t* index) {
+  DCHECK(*index < str.size(), "index out of range");
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(str.data());
+  if (data[*index] < 0x80)
+    return data[(*index)++];
+  uint32_t code_point;
+  if (!DecodeMultiByte(data, str.size(), index, &code_point))
+    return kUnicodeReplacementCharacter;
+  return code_point;
+}
+
+size_t UTF8ToUTF16(StringPiece str, uint16_t* out) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(str.data());
+  size_t size = str.size();
+  size_t i = 0;
+  uint16_t* start = out;
+  while (i < size) {
+    size_t ascii = AsciiPrefixLength(str.data() + i, size - i);
+    if (ascii) {
+      WidenAscii(str.data() + i, ascii, out);
+      i += ascii;
+      out += ascii;
+      continue;
+    }
+    if (data[i] < 0x80) {
+      *out++ = data[i++];
+      continue;
+    }
+    uint32_t code_point;
+    if (!DecodeMultiByte(data, size, &i, &code_point))
+      code_point = kUnicodeReplacementCharacter;
+    if (code_point >= 0x10000) {
+      code_point -= 0x10000;
+      *out++ = static_cast<uint16_t>(0xd800 + (code_point >> 10));
+      *out++ = static_cast<uint16_t>(0xdc00 + (code_point & 0x3ff));
+    } else {
+      *out++ = static_cast<uint16_t>(code_point);
+    }
+  }
+  return out - start;
+}
+
+const uint16_t* UTF8ToUTF16Scratch(StringPiece str, size_t* length) {
+  // +1 for the terminator.
+  size_t required = str.size() + 1;
+  if (required > g_scratch_capacity) {
+    size_t capacity = g_scratch_capacity ? g_scratch_capacity : 256;
+    while (capacity < required)
+      capacity *= 2;
+    g_scratch =
+        static_cast<uint16_t*>(realloc(g_scratch, capacity * sizeof(uint16_t)));
+    CHECK(g_scratch, "out of memory");
+    g_scratch_capacity = capacity;
+  }
+  *length = UTF8ToUTF16(str, g_scratch);
+  g_scratch[*length] = 0;
+  return g_scratch;
+}
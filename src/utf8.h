@@ -0,0 +1,35 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef UTF8_H_
+#define UTF8_H_
+
+#include "core.h"
+#include "string_piece.h"
+
+// Substituted for each maximal ill-formed subsequence when decoding.
+const uint32_t kUnicodeReplacementCharacter = 0xfffd;
+
+// Returns whether |str| is entirely well-formed UTF-8 (no overlongs,
+// surrogates, or code points past U+10FFFF).
+bool IsValidUTF8(StringPiece str);
+
+// Decodes the code point starting at |*index| in |str| and advances |*index|
+// past it. Ill-formed input decodes as kUnicodeReplacementCharacter. |*index|
+// must be less than str.size().
+uint32_t DecodeUTF8(StringPiece str, size_t* index);
+
+// The number of UTF-16 code units needed for |str| is never more than the
+// number of UTF-8 bytes, so |out| must have room for str.size() units.
+// Returns the number of units written. Runs of ASCII are widened 16 bytes at
+// a time.
+size_t UTF8ToUTF16(StringPiece str, uint16_t* out);
+
+// As UTF8ToUTF16, but into a buffer owned by the calling thread that's reused
+// across calls, so that converting text for each draw doesn't allocate. The
+// result is valid until the next call on the same thread, and is always
+// nul-terminated.
+const uint16_t* UTF8ToUTF16Scratch(StringPiece str, size_t* length);
+
+#endif  // UTF8_H_
@@ -0,0 +1,87 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "utf8.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<uint16_t> ToUTF16(StringPiece str) {
+  std::vector<uint16_t> out(str.size());
+  out.resize(UTF8ToUTF16(str, out.data()));
+  return out;
+}
+
+}  // namespace
+
+TEST(UTF8Test, Ascii) {
+  // Long enough to take the vectorized path, with a scalar tail.
+  std::string str = "void DockingWorkspace::Render() { root_->Render(); }";
+  std::vector<uint16_t> wide = ToUTF16(str);
+  ASSERT_EQ(str.size(), wide.size());
+  for (size_t i = 0; i < str.size(); ++i)
+    EXPECT_EQ(static_cast<uint16_t>(str[i]), wide[i]);
+  EXPECT_TRUE(IsValidUTF8(str));
+  EXPECT_TRUE(ToUTF16("").empty());
+}
+
+TEST(UTF8Test, MultiByte) {
+  // UPWARDS ARROW, e with acute, and a non-BMP code point (U+1F600) between
+  // runs of ASCII.
+  std::string str =
+      "Frame \xe2\x86\x91 caf\xc3\xa9 \xf0\x9f\x98\x80 and some more ascii";
+  EXPECT_TRUE(IsValidUTF8(str));
+  std::vector<uint16_t> wide = ToUTF16(str);
+  ASSERT_EQ(str.size() - 2 - 1 - 2, wide.size());
+  EXPECT_EQ(0x2191, wide[6]);
+  EXPECT_EQ(0xe9, wide[11]);
+  EXPECT_EQ(0xd83d, wide[13]);
+  EXPECT_EQ(0xde00, wide[14]);
+  EXPECT_EQ('a', wide[16]);
+}
+
+TEST(UTF8Test, Invalid) {
+  // Overlong, surrogate, past U+10FFFF, stray continuation, truncated.
+  const char* bad[] = {
+      "\xc0\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\x80", "abc\xe2\x86",
+  };
+  for (const char* str : bad)
+    EXPECT_FALSE(IsValidUTF8(str)) << str;
+
+  // A truncated sequence is replaced as a whole, and the following ASCII is
+  // preserved.
+  std::vector<uint16_t> wide = ToUTF16("a\xe2\x86z");
+  ASSERT_EQ(3u, wide.size());
+  EXPECT_EQ('a', wide[0]);
+  EXPECT_EQ(kUnicodeReplacementCharacter, wide[1]);
+  EXPECT_EQ('z', wide[2]);
+}
+
+TEST(UTF8Test, Decode) {
+  StringPiece str("x\xc3\xa9\xf0\x9f\x98\x80\xff");
+  size_t index = 0;
+  EXPECT_EQ('x', DecodeUTF8(str, &index));
+  EXPECT_EQ(0xe9u, DecodeUTF8(str, &index));
+  EXPECT_EQ(0x1f600u, DecodeUTF8(str, &index));
+  EXPECT_EQ(kUnicodeReplacementCharacter, DecodeUTF8(str, &index));
+  EXPECT_EQ(str.size(), index);
+}
+
+TEST(UTF8Test, Scratch) {
+  size_t length;
+  const uint16_t* wide = UTF8ToUTF16Scratch("hi", &length);
+  EXPECT_EQ(2u, length);
+  EXPECT_EQ('h', wide[0]);
+  EXPECT_EQ(0, wide[2]);
+
+  std::string big(100000, 'q');
+  wide = UTF8ToUTF16Scratch(big, &length);
+  EXPECT_EQ(big.size(), length);
+  EXPECT_EQ('q', wide[length - 1]);
+  EXPECT_EQ(0, wide[length]);
+}
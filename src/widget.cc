@@ -6,12 +6,16 @@
 
 #include "core.h"
 #include "docking_split_container.h"
+#include "focus.h"
+#include "frame_scheduler.h"
 // #include "sg/workspace.h"
 
-Widget::Widget() : parent_(NULL) {
+Widget::Widget() : parent_(NULL), needs_paint_(true) {
 }
 
 Widget::~Widget() {
+  ReleaseFocus(this);
+  CancelScheduledInvalidate(this);
 }
 
 DockingSplitContainer* Widget::AsDockingSplitContainer() {
@@ -36,8 +40,13 @@ Rect Widget::ClientToScreen(const Rect& rect) {
 }
 
 void Widget::Invalidate() {
-#pragma message("todo!")
-  // Workspace::Invalidate();
+  needs_paint_ = true;
+  if (parent_)
+    parent_->Invalidate();
+}
+
+void Widget::InvalidateAt(double time) {
+  ScheduleInvalidate(this, time);
 }
 
 Widget* Widget::FindTopMostUnderPoint(const Point& point) {
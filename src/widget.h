@@ -5,6 +5,8 @@
 #ifndef WIDGET_H_
 #define WIDGET_H_
 
+#include <atomic>
+
 #include "core.h"
 #include "drag_setup.h"
 #include "entry.h"
@@ -27,7 +29,16 @@ class Widget : public InputHandler {
   Widget* parent() { return parent_; }
 
   virtual void Render() {}
+
+  // Marks this widget and all its ancestors as needing to be repainted. May
+  // be called from Render() on a recording thread, e.g. by an animation that
+  // wants another frame.
   virtual void Invalidate();
+  // Invalidates once |time| (see GetFrameTime()) is reached, for animations
+  // that next change at a known time.
+  void InvalidateAt(double time);
+  bool NeedsPaint() const { return needs_paint_; }
+  void ClearNeedsPaint() { needs_paint_ = false; }
   virtual bool CouldStartDrag(DragSetup* drag_setup) {
     UNUSED(drag_setup);
     return false;
@@ -83,6 +94,7 @@ class Widget : public InputHandler {
  private:
   Widget* parent_;
   Rect rect_;
+  std::atomic<bool> needs_paint_;
 
   DISALLOW_COPY_AND_ASSIGN(Widget);
 };